@@ -0,0 +1,118 @@
+/*
+ * The arena of a slice of cal_set_slice_pipeline.cpp: a bump allocator over chunks of ARENA_CHUNK bytes, backed by
+ * explicit huge pages (MAP_HUGETLB) when some are reserved, or else by transparent huge pages (MADV_HUGEPAGE), or else
+ * by normal pages, and bound to a NUMA node (preferred, by mbind). The freed blocks of 16~256 bytes are kept in free
+ * lists of their sizes. Arena_allocator allocates from the arena of the calling thread (current_arena), so the
+ * Cache_slice of cache_slice.h keeps its nodes and unordered_maps there; oracle.cpp checks it the same way.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <utility>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define ARENA_CHUNK (4<<20)    // bytes mapped at a time, a multiple of the 2MB huge page
+#define FREE_CLASSES 16        // free lists of the blocks of 16~256 bytes
+
+class Arena    // a bump allocator over huge pages, bound to a NUMA node
+{
+public:
+    int node;    // -1 for any
+    int huge;    // 2: explicit huge pages, 1: transparent huge pages, 0: normal pages, the least of the chunks
+
+    void Init(int n)
+    {
+        node = n;
+        huge = 2;
+        cur = NULL;
+        left = 0;
+        for(int i = 0; i<FREE_CLASSES; i++)
+            free_list[i] = NULL;
+    }
+    void *Alloc(size_t size)
+    {
+        size = (size + 15) & ~(size_t)15;
+        int c = size/16 - 1;
+        if(c < FREE_CLASSES && free_list[c] != NULL)
+        {
+            void *p = free_list[c];
+            free_list[c] = *(void **)p;
+            return p;
+        }
+        if(size > left)
+            Map(size);
+        void *p = cur;
+        cur += size;
+        left -= size;
+        return p;
+    }
+    void Free(void *p, size_t size)    // the blocks larger than 256 bytes are kept until Release()
+    {
+        size = (size + 15) & ~(size_t)15;
+        int c = size/16 - 1;
+        if(c < FREE_CLASSES)
+        {
+            *(void **)p = free_list[c];
+            free_list[c] = p;
+        }
+    }
+    void Release()
+    {
+        for(unsigned long long i = 0; i<chunks.size(); i++)
+            munmap(chunks[i].first, chunks[i].second);
+        chunks.clear();
+    }
+
+private:
+    std::vector<std::pair<char *, size_t> > chunks;
+    char *cur;
+    size_t left;
+    void *free_list[FREE_CLASSES];
+
+    void Map(size_t size)
+    {
+        size = (size + ARENA_CHUNK - 1) / ARENA_CHUNK * ARENA_CHUNK;
+        void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p == MAP_FAILED)    // no huge pages reserved
+        {
+            p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(p == MAP_FAILED)
+            {
+                printf("cannot map %llu bytes\n", (unsigned long long)size);
+                exit(1);
+            }
+            int h = madvise(p, size, MADV_HUGEPAGE) == 0? 1:0;
+            huge = h < huge? h:huge;
+        }
+        if(node >= 0)    // MPOL_PREFERRED, falls back to the other nodes when this one is full
+        {
+            unsigned long mask = 1UL << node;
+            syscall(SYS_mbind, p, size, 1, &mask, sizeof(mask)*8, 0);
+        }
+        chunks.push_back(std::make_pair((char *)p, size));
+        cur = (char *)p;
+        left = size;
+    }
+};
+
+thread_local Arena *current_arena;    // the arena of the slice owned by the thread
+
+template<class T>
+struct Arena_allocator    // for the unordered_maps, from the arena of the thread
+{
+    typedef T value_type;
+    Arena_allocator() {}
+    template<class U> Arena_allocator(const Arena_allocator<U> &) {}
+    T *allocate(size_t n) { return (T *)current_arena->Alloc(n*sizeof(T)); }
+    void deallocate(T *p, size_t n) { current_arena->Free(p, n*sizeof(T)); }
+};
+template<class T, class U> bool operator==(const Arena_allocator<T> &, const Arena_allocator<U> &) { return true; }
+template<class T, class U> bool operator!=(const Arena_allocator<T> &, const Arena_allocator<U> &) { return false; }
+
+#endif
@@ -0,0 +1,276 @@
+/*
+ * The LRU engine of cal_set_slice.cpp and cal_set_slice_pipeline.cpp, which oracle.cpp checks against the reference.
+ * Cache_slice keeps every set of a slice as a linked list of ways from the MRU to the LRU, a map from the tags to the
+ * lines and a map from the lines to the nodes, all from Allocator (std::allocator, or Arena_allocator of arena.h in
+ * the pipeline). While a set is not full, the line size() is filled; a hit on the MRU line changes nothing.
+ * The batched driver of cal_set_slice.cpp: Hash_batch calculates the slices, sets and tags of a batch of accesses and
+ * keeps only those of the sets of the shard, then Simulate_batch simulates them in order and counts them, prefetching
+ * the state of the sets ahead.
+ */
+
+#ifndef CACHE_SLICE_H
+#define CACHE_SLICE_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include "lru_node.h"
+#include "slice_map.h"
+
+template<template<class> class Allocator = std::allocator>
+class Cache_slice
+{
+public:
+    typedef std::unordered_map<unsigned long long, int, std::hash<unsigned long long>, std::equal_to<unsigned long long>,
+                               Allocator<std::pair<const unsigned long long, int> > > Tag_map;
+    typedef std::unordered_map<int, Node*, std::hash<int>, std::equal_to<int>, Allocator<std::pair<const int, Node*> > > Line_map;
+
+    int sets, ways;
+    Node **head, **tail;
+    Tag_map *tag_line_no;
+    Line_map *line_no_ptr;
+
+    void Init(int s, int w);
+    void Free();
+    void Refresh(unsigned long long set_no, unsigned long long tag);
+    void Replace(unsigned long long set_no, unsigned long long newtag);
+    bool Access(unsigned long long set_no, unsigned long long tag);
+    int Save(unsigned long long set_no, unsigned long long *tags);
+    void Load(unsigned long long set_no, const unsigned long long *tags, int used);
+    int State(unsigned long long set_no, int *line, unsigned long long *tags);
+};
+
+template<template<class> class Allocator>
+void Cache_slice<Allocator>::Init(int s, int w)
+{
+    sets = s;
+    ways = w;
+    head = Allocator<Node*>().allocate(sets);
+    tail = Allocator<Node*>().allocate(sets);
+    tag_line_no = Allocator<Tag_map>().allocate(sets);
+    line_no_ptr = Allocator<Line_map>().allocate(sets);
+    for(int k = 0; k<sets; k++)
+    {
+        new (&tag_line_no[k]) Tag_map;
+        new (&line_no_ptr[k]) Line_map;
+        Node *tmp_pre = NULL, *tmp_next = NULL;
+        head[k] = new (Allocator<Node>().allocate(1)) Node(0);
+        tmp_pre = head[k];
+        for(int i = 1; i<ways; i++)
+        {
+            tmp_next = new (Allocator<Node>().allocate(1)) Node(i);
+            tmp_pre->next = tmp_next;
+            tmp_next->pre = tmp_pre;
+            tmp_pre = tmp_next;
+        }
+        tail[k] = tmp_pre;
+
+        Node *tmp = head[k];
+        for(int i = 0; i<ways; i++)
+        {
+            line_no_ptr[k].insert(std::make_pair(i, tmp));
+            tmp = tmp->next;
+        }
+    }
+}
+
+template<template<class> class Allocator>
+void Cache_slice<Allocator>::Free()
+{
+    for(int k = 0; k<sets; k++)
+    {
+        for(Node *p = head[k]; p != NULL; )
+        {
+            Node *next = p->next;
+            Allocator<Node>().deallocate(p, 1);
+            p = next;
+        }
+        tag_line_no[k].~Tag_map();
+        line_no_ptr[k].~Line_map();
+    }
+    Allocator<Node*>().deallocate(head, sets);
+    Allocator<Node*>().deallocate(tail, sets);
+    Allocator<Tag_map>().deallocate(tag_line_no, sets);
+    Allocator<Line_map>().deallocate(line_no_ptr, sets);
+}
+
+template<template<class> class Allocator>
+void Cache_slice<Allocator>::Refresh(unsigned long long set_no, unsigned long long tag)
+{
+    int line_no_tmp = tag_line_no[set_no][tag];
+    if(line_no_tmp >= ways || line_no_tmp < 0)
+    {
+        printf("line_no_tmp >= ways || line_no_tmp < 0\n");
+        exit(1);
+    }
+    Node *tmp = line_no_ptr[set_no][line_no_tmp];
+    if(head[set_no] != tmp)
+    {
+        if(tmp->pre != NULL)
+            tmp->pre->next = tmp->next;
+        if(tmp->next != NULL)
+            tmp->next->pre = tmp->pre;
+        if(tail[set_no] == tmp)
+            tail[set_no] = tmp->pre;
+        tmp->next = head[set_no];
+        head[set_no]->pre = tmp;
+        tmp->pre = NULL;
+        head[set_no] = tmp;
+    }
+    return;
+}
+
+template<template<class> class Allocator>
+void Cache_slice<Allocator>::Replace(unsigned long long set_no, unsigned long long newtag)
+{
+    int line_no_tmp = tail[set_no]->line_no;
+    unsigned long long oldtag = tail[set_no]->tag;
+    tag_line_no[set_no].erase(oldtag);
+    tag_line_no[set_no][newtag] = line_no_tmp;
+    tail[set_no]->tag = newtag;
+    Refresh(set_no, newtag);
+    return;
+}
+
+template<template<class> class Allocator>
+bool Cache_slice<Allocator>::Access(unsigned long long set_no, unsigned long long tag)    // true when hit
+{
+    if(tag_line_no[set_no].size() > 0 && head[set_no]->tag == tag)    // a hit on the MRU line changes nothing
+        return true;
+    if(tag_line_no[set_no].find(tag) != tag_line_no[set_no].end()) // found
+    {
+        Refresh(set_no, tag);
+        return true;
+    }
+    // not found
+    if((int)tag_line_no[set_no].size() < ways)   // not full
+    {
+        int allocated_line_no = tag_line_no[set_no].size();
+        tag_line_no[set_no][tag] = allocated_line_no;
+        Node* tmp = line_no_ptr[set_no][allocated_line_no];
+        tmp->tag = tag;
+        Refresh(set_no, tag);
+    }
+    else // full
+    {
+        Replace(set_no, tag);
+    }
+    return false;
+}
+
+template<template<class> class Allocator>
+int Cache_slice<Allocator>::Save(unsigned long long set_no, unsigned long long *tags)    // the valid tags from the MRU to the LRU
+{
+    int used = tag_line_no[set_no].size();    // the valid lines are always in front of the empty ones
+    Node *tmp = head[set_no];
+    for(int i = 0; i<used; i++)
+    {
+        tags[i] = tmp->tag;
+        tmp = tmp->next;
+    }
+    return used;
+}
+
+template<template<class> class Allocator>
+void Cache_slice<Allocator>::Load(unsigned long long set_no, const unsigned long long *tags, int used)    // into an empty set
+{
+    for(int i = used-1; i>=0; i--)    // from the LRU, so the MRU ends at the head
+    {
+        int allocated_line_no = tag_line_no[set_no].size();
+        tag_line_no[set_no][tags[i]] = allocated_line_no;
+        line_no_ptr[set_no][allocated_line_no]->tag = tags[i];
+        Refresh(set_no, tags[i]);
+    }
+}
+
+template<template<class> class Allocator>
+int Cache_slice<Allocator>::State(unsigned long long set_no, int *line, unsigned long long *tags)    // the valid lines from the MRU
+{
+    int used = tag_line_no[set_no].size(), n = 0;
+    for(Node *p = head[set_no]; p != NULL && n < used; p = p->next, n++)
+    {
+        line[n] = p->line_no;
+        tags[n] = p->tag;
+    }
+    return n;
+}
+
+struct Slice_access    // an access of a batch, after Hash_batch
+{
+    int slice;
+    bool measure;    // counted, see the sampling of cal_set_slice.cpp
+    unsigned long long set_no, tag, n;    // n accesses to the line in a row
+};
+
+// the slices (Map_slice), sets and tags of the accesses addr[0~len-1], keeping in out only those of the sets whose
+// slice*sets+set_no mod shards is shard; returns the accesses kept
+int Hash_batch(const unsigned long long *addr, const unsigned long long *n, const bool *measure, int len,
+               int set_bits, int block_bits, int shards, int shard, Slice_access *out)
+{
+    unsigned long long sets = 1ULL << set_bits;
+    int kept = 0;
+    for(int i = 0; i<len; i++)
+    {
+        Slice_access &a = out[kept];
+        a.tag = addr[i] >> (set_bits+block_bits);
+        a.set_no = (addr[i] >> block_bits) & (sets-1);
+        a.slice = Map_slice(addr[i]);
+        a.n = n[i];
+        a.measure = measure[i];
+        if(shards == 1 || (int)((a.slice*sets + a.set_no) % shards) == shard)
+            kept++;
+    }
+    return kept;
+}
+
+// simulates the accesses a[0~len-1] in order, and counts the measured ones in count and miss_count ([slices][sets])
+// and measured; all but the first of a run are hits on the MRU line. The state of the set (its unordered_map and the
+// pointer to its head) of the access [distance] accesses ahead is prefetched (0 for none), and half the distance
+// ahead the node at the head and the first node of the bucket of the tag, where find() begins (the bucket array is
+// read on the way, it cannot be reached by the interface of unordered_map without loading it)
+template<template<class> class Allocator>
+void Simulate_batch(Cache_slice<Allocator> *cache, const Slice_access *a, int len, int distance,
+                    unsigned long long *count, unsigned long long *miss_count, unsigned long long &measured)
+{
+    int d = distance, half = distance/2;
+    for(int i = 0; i<d && i<len; i++)
+    {
+        __builtin_prefetch(&cache[a[i].slice].tag_line_no[a[i].set_no]);
+        __builtin_prefetch(&cache[a[i].slice].head[a[i].set_no]);
+    }
+    for(int i = 0; i<len; i++)
+    {
+        if(d > 0 && i+d < len)
+        {
+            __builtin_prefetch(&cache[a[i+d].slice].tag_line_no[a[i+d].set_no]);
+            __builtin_prefetch(&cache[a[i+d].slice].head[a[i+d].set_no]);
+        }
+        if(half > 0 && i+half < len)    // its pointer and the unordered_map have been prefetched
+        {
+            const Slice_access &b = a[i+half];
+            typename Cache_slice<Allocator>::Tag_map &map = cache[b.slice].tag_line_no[b.set_no];
+            __builtin_prefetch(cache[b.slice].head[b.set_no]);
+            if(!map.empty())    // the first node of the bucket of the tag, where find() begins
+            {
+                size_t bucket = map.bucket(b.tag);
+                auto node = map.begin(bucket);
+                if(node != map.end(bucket))
+                    __builtin_prefetch(&*node);
+            }
+        }
+        Cache_slice<Allocator> &slice = cache[a[i].slice];
+        bool hit = slice.Access(a[i].set_no, a[i].tag);
+        if(a[i].measure)
+        {
+            unsigned long long k = a[i].slice*slice.sets + a[i].set_no;
+            count[k] += a[i].n;
+            measured += a[i].n;
+            if(!hit)
+                miss_count[k]++;
+        }
+    }
+}
+
+#endif
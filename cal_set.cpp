@@ -3,7 +3,11 @@
  * The target is to count the misses of all the sets.
  * Precondition: The .out file including all the traces of the two benchmarks.
  * Usage: g++ -std=c++11 cal_set.cpp -o cal_set
- *        ./cal_set [benmark1] [benchmark2]
+ *        ./cal_set [benmark1] [benchmark2] [-p distance]
+ * When [benchmark].out does not exist, [benchmark].rle collapsed by collapse.cpp is read, and the repeats of a line
+ * are credited as MRU hits in bulk.
+ * The accesses are simulated in batches, prefetching the state of the set [distance] (8 by default) accesses ahead,
+ * as cal_set_slice.cpp does.
  * Input: follow the hints
  * Output: the misses of all the sets, saved as [benchmark1]_[benchmark2]
  * Author: Jack Wang
@@ -18,12 +22,17 @@
 
 using namespace std;
 char benchname1[20], benchname2[20];
-char filename1[30], filename2[30], outfilename[100];
-FILE *file1, *file2, *outfile;
+char outfilename[100];
+FILE *outfile;
 int set_bits = 11, block_bits = 6, ways = 11;
 unsigned long long addr1, addr2;
 int ratio;    // benchmark1:benchmark2
 #define SETS 2048    // 2^set_bits
+unsigned long long miss_count[SETS];
+#define BATCH 256    // accesses simulated as a batch
+int prefetch_distance = 8;    // in accesses, 0 for none
+unsigned long long batch_addr[BATCH];
+int batch_len = 0;
 
 struct Node
 {
@@ -112,12 +121,60 @@ void Replace(unsigned long long set_no, unsigned long long newtag)
     return;
 }
 
+class Trace_reader    // [benchmark].out, or [benchmark].rle collapsed by collapse.cpp when the .out is absent
+{
+public:
+    FILE *file;
+    bool rle;
+    unsigned long long addr, left;    // the current run of the same line
+
+    bool Open(const char *benchname);
+    bool Next(unsigned long long &a, unsigned long long &n, unsigned long long max);
+};
+
+bool Trace_reader::Open(const char *benchname)
+{
+    char filename[200];
+    sprintf(filename, "%s.out", benchname);
+    rle = false;
+    left = 0;
+    file = fopen(filename, "r");
+    if(file == NULL)
+    {
+        sprintf(filename, "%s.rle", benchname);
+        file = fopen(filename, "r");
+        rle = true;
+    }
+    return file != NULL;
+}
+
+// the next n (1~max) accesses, which are all to the line of address a
+bool Trace_reader::Next(unsigned long long &a, unsigned long long &n, unsigned long long max)
+{
+    if(left == 0)
+    {
+        char tmp[100], *p;
+        if(fgets(tmp, 99, file) == NULL)
+            return false;
+        addr = strtoull(tmp, &p, 10);
+        left = rle? strtoull(p, NULL, 10):1;
+        if(left == 0)
+            left = 1;
+    }
+    a = addr;
+    n = left < max? left:max;
+    left -= n;
+    return true;
+}
+
+Trace_reader reader1, reader2;
+
 void Start()
 {
-    file1 = fopen(filename1, "r");
-    file2 = fopen(filename2, "r");
+    bool open1 = reader1.Open(benchname1);
+    bool open2 = reader2.Open(benchname2);
     outfile = fopen(outfilename, "w");
-    if(file1 == NULL || file2 == NULL || outfile == NULL)
+    if(!open1 || !open2 || outfile == NULL)
     {
         printf("cannot open files\n");
         exit(1);
@@ -130,118 +187,109 @@ void Start()
 
 void Finish()
 {
-    fclose(file1);
-    fclose(file2);
+    fclose(reader1.file);
+    fclose(reader2.file);
     fclose(outfile);
     return;
 }
 
+void Update(unsigned long long set_no, unsigned long long tag)
+{
+    if(tag_line_no[set_no].size() > 0 && head[set_no]->tag == tag)    // a hit on the MRU line changes nothing
+        return;
+    if(tag_line_no[set_no].find(tag) != tag_line_no[set_no].end()) // found
+        Refresh(set_no, tag);
+    else    // not found
+    {
+        miss_count[set_no]++;
+        if(tag_line_no[set_no].size() < ways)   // not full
+        {
+            int allocated_line_no = tag_line_no[set_no].size();
+            tag_line_no[set_no][tag] = allocated_line_no;
+            Node* tmp = line_no_ptr[set_no][allocated_line_no];
+            tmp->tag = tag;
+            Refresh(set_no, tag);
+        }
+        else // full
+        {
+            Replace(set_no, tag);
+        }
+    }
+}
+
+void Run_batch()    // simulate the accesses of the batch in order, prefetching the state of the sets ahead
+{
+    unsigned long long set_no[BATCH], tag[BATCH];
+    for(int i = 0; i<batch_len; i++)
+    {
+        tag[i] = batch_addr[i] >> (set_bits+block_bits);
+        set_no[i] = (batch_addr[i] >> block_bits) & 0B11111111111;    // set_bits
+    }
+    int d = prefetch_distance, half = prefetch_distance/2;
+    for(int i = 0; i<d && i<batch_len; i++)
+    {
+        __builtin_prefetch(&tag_line_no[set_no[i]]);
+        __builtin_prefetch(&head[set_no[i]]);
+    }
+    for(int i = 0; i<batch_len; i++)
+    {
+        if(d > 0 && i+d < batch_len)
+        {
+            __builtin_prefetch(&tag_line_no[set_no[i+d]]);
+            __builtin_prefetch(&head[set_no[i+d]]);
+        }
+        if(half > 0 && i+half < batch_len)    // its pointer has been prefetched
+            __builtin_prefetch(head[set_no[i+half]]);
+        Update(set_no[i], tag[i]);
+    }
+    batch_len = 0;
+}
+
+void Access(unsigned long long addr)
+{
+    batch_addr[batch_len++] = addr;
+    if(batch_len == BATCH)
+        Run_batch();
+}
+
 int main(int argc, char *argv[])
 {
-    unsigned long long miss_count[SETS];
     for(int i = 0; i<SETS; i++)
         miss_count[i] = 0;
     printf("please input ratio: ");
     scanf("%d", &ratio);
     strcpy(benchname1, argv[1]);
     strcpy(benchname2, argv[2]);
-    strcpy(filename1, benchname1);
-    strcpy(filename2, benchname2);
-    strcat(filename1, ".out");
-    strcat(filename2, ".out");
+    if(argc > 4 && strcmp(argv[3], "-p") == 0)
+        prefetch_distance = atoi(argv[4]);
     strcpy(outfilename, benchname1);
     strcat(outfilename, "_");
     strcat(outfilename, benchname2);
 
     Start();
     
-    char tmp1[100], tmp2[100];
-    while(fgets(tmp1, 99, file1) != NULL && fgets(tmp2, 99, file2) != NULL)   // end with either file finished
+    unsigned long long n1, n2;
+    while(reader1.Next(addr1, n1, 1) && reader2.Next(addr2, n2, 1))   // end with either file finished
     {
-        addr1 = strtoull(tmp1, NULL, 10);
-        addr2 = strtoull(tmp2, NULL, 10);
         addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark 
-        unsigned long long tag1 = addr1 >> (set_bits+block_bits);
-        unsigned long long tag2 = addr2 >> (set_bits+block_bits);
-        unsigned long long set_no1 = (addr1 >> block_bits) & 0B11111111111;    // set_bits
-        unsigned long long set_no2 = (addr2 >> block_bits) & 0B11111111111;
-        // printf("addr1: %llu\n", addr1);
-        // printf("addr2: %llu\n", addr2);
-        // printf("set_no1: %llu\n", set_no1);
-        // printf("set_no2: %llu\n\n", set_no2);
-
-        if(tag_line_no[set_no1].find(tag1) != tag_line_no[set_no1].end()) // found
-            Refresh(set_no1, tag1);
-        else    // not found
-        {
-            miss_count[set_no1]++;
-            if(tag_line_no[set_no1].size() < ways)   // not full
-            {
-                int allocated_line_no = tag_line_no[set_no1].size();
-                tag_line_no[set_no1][tag1] = allocated_line_no;
-                Node* tmp = line_no_ptr[set_no1][allocated_line_no];
-                tmp->tag = tag1;
-                Refresh(set_no1, tag1);
-            }
-            else // full
-            {
-                Replace(set_no1, tag1);
-            }
-        }
-
+        Access(addr1);
 
         int counter = ratio - 1;
-        while(counter--)
+        while(counter > 0)
         {
-            if(fgets(tmp1, 99, file1) != NULL)
+            if(reader1.Next(addr1, n1, counter))    // the repeats of a run are MRU hits, only the first one matters
             {
-                addr1 = strtoull(tmp1, NULL, 10);
                 addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
-                tag1 = addr1 >> (set_bits+block_bits);
-                set_no1 = (addr1 >> block_bits) & 0B011111111111;    // set_bits
-
-                if(tag_line_no[set_no1].find(tag1) != tag_line_no[set_no1].end()) // found
-                    Refresh(set_no1, tag1);
-                else    // not found
-                {
-                    miss_count[set_no1]++;
-                    if(tag_line_no[set_no1].size() < ways)   // not full
-                    {
-                        int allocated_line_no = tag_line_no[set_no1].size();
-                        tag_line_no[set_no1][tag1] = allocated_line_no;
-                        Node* tmp = line_no_ptr[set_no1][allocated_line_no];
-                        tmp->tag = tag1;
-                        Refresh(set_no1, tag1);
-                    }
-                    else // full
-                    {
-                        Replace(set_no1, tag1);
-                    }
-                }
+                Access(addr1);
+                counter -= n1;
             }
             else
                 break;
         }
 
-        if(tag_line_no[set_no2].find(tag2) != tag_line_no[set_no2].end()) // found
-            Refresh(set_no2, tag2);
-        else    // not found
-        {
-            miss_count[set_no2]++;
-            if(tag_line_no[set_no2].size() < ways)   // not full
-            {
-                int allocated_line_no = tag_line_no[set_no2].size();
-                tag_line_no[set_no2][tag2] = allocated_line_no;
-                Node* tmp = line_no_ptr[set_no2][allocated_line_no];
-                tmp->tag = tag2;
-                Refresh(set_no2, tag2);
-            }
-            else // full
-            {
-                Replace(set_no2, tag2);
-            }
-        }
+        Access(addr2);
     }
+    Run_batch();
 
     for(int i = 0; i<SETS; i++)
         fprintf(outfile, "%llu\n", miss_count[i]);
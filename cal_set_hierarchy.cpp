@@ -0,0 +1,312 @@
+/*
+ * This program simulates private L1D and L2 caches for every benchmark in front of the LRU-based sliced LLC,
+ * based on cal_set_slice_compact.cpp, so raw per-core traces can be used without filtering them first.
+ * Every level is a Flat_cache (flat_cache.h): the line addresses of a set in one array and the recency as a
+ * permutation of the ways, 4 bits for every position (see compact_set.h). Only the misses of L1D go to L2, and only the
+ * misses of L2 go to the LLC, in the same process.
+ * Two modes of inclusion:
+ *   0: non-inclusive, the lines are filled into every level on a miss, an eviction does not touch the other levels;
+ *   1: inclusive, an eviction from L2 back-invalidates the line in L1D, and an eviction from the LLC back-invalidates
+ *      the line in the L2 and L1D of its owner, so the LLC always holds the lines of the private caches.
+ * The traces have no loads or stores, so the write-backs of dirty lines are not simulated.
+ * A level of 0 sets is disabled.
+ * Precondition: the .out files including all the raw traces of the benchmarks, or the .rle/.bin as cal_set_slice.cpp.
+ * Usage: g++ -std=c++11 -O2 cal_set_hierarchy.cpp -o cal_set_hierarchy
+ *        ./cal_set_hierarchy [benchmark1] [benchmark2]
+ *        ./cal_set_hierarchy [merged]    (a trace merged by merge.cpp)
+ * Input: follow the hints
+ * Output: the accesses and misses of all the sets of the LLC, saved as text as cal_set_slice.cpp -T does,
+ *         [benchmark1]_[benchmark2]_access and [benchmark1]_[benchmark2]_miss ([merged]_access and [merged]_miss),
+ *         and the accesses and misses of every level for every benchmark are printed
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include "flat_cache.h"
+#include "slice_map.h"
+using namespace std;
+
+char benchname1[20], benchname2[20];
+char outfilename1[100], outfilename2[100];
+FILE *outfile1, *outfile2;
+int slices = 8, set_bits = 11, block_bits = 6, ways = 11;
+unsigned long long addr1, addr2;
+int ratio;    // benchmark1:benchmark2
+int inclusive;
+int l1_sets, l1_ways, l2_sets, l2_ways;
+#define SETS 2048    // 2^set_bits
+#define MAX_WAYS 15  // so that the order fits in 64 bits
+#define MAX_OWNER 64 // benchmarks, as merge.cpp
+unsigned long long (*count)[SETS], (*miss_count)[SETS];
+
+struct Private_cache
+{
+    Flat_cache l1, l2;
+    unsigned long long back_invalidations;
+};
+
+Private_cache *Private[MAX_OWNER];
+Flat_cache *Cache;    // the slices of the LLC
+
+class Trace_reader    // [benchmark].out, or [benchmark].rle collapsed by collapse.cpp, or [benchmark].bin
+{
+public:
+    FILE *file;
+    int kind;                         // 0: .out, 1: .rle, 2: .bin
+    unsigned long long addr, left;    // the current run of the same line
+
+    bool Open(const char *benchname);
+    bool Next(unsigned long long &a, unsigned long long &n, unsigned long long max);
+};
+
+bool Trace_reader::Open(const char *benchname)
+{
+    char filename[200];
+    sprintf(filename, "%s.out", benchname);
+    kind = 0;
+    left = 0;
+    file = fopen(filename, "r");
+    if(file == NULL)
+    {
+        sprintf(filename, "%s.rle", benchname);
+        file = fopen(filename, "r");
+        kind = 1;
+    }
+    if(file == NULL)
+    {
+        sprintf(filename, "%s.bin", benchname);
+        file = fopen(filename, "rb");
+        kind = 2;
+    }
+    return file != NULL;
+}
+
+// the next n (1~max) accesses, which are all to the line of address a
+bool Trace_reader::Next(unsigned long long &a, unsigned long long &n, unsigned long long max)
+{
+    if(left == 0 && kind == 2)
+    {
+        if(fread(&addr, sizeof(unsigned long long), 1, file) != 1)
+            return false;
+        left = 1;
+    }
+    else if(left == 0)
+    {
+        char tmp[100], *p;
+        if(fgets(tmp, 99, file) == NULL)
+            return false;
+        addr = strtoull(tmp, &p, 10);
+        left = kind == 1? strtoull(p, NULL, 10):1;
+        if(left == 0)
+            left = 1;
+    }
+    a = addr;
+    n = left < max? left:max;
+    left -= n;
+    return true;
+}
+
+Trace_reader reader1, reader2;
+
+void Start()
+{
+    bool open1 = reader1.Open(benchname1);
+    bool open2 = benchname2[0] != 0? reader2.Open(benchname2):true;
+    outfile1 = fopen(outfilename1, "w");
+    outfile2 = fopen(outfilename2, "w");
+    if(!open1 || !open2 || outfile1 == NULL || outfile2 == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+
+    Cache = new Flat_cache[slices];
+    for(int i = 0; i<slices; i++)
+        Cache[i].Init(SETS, ways);
+    count = new unsigned long long[slices][SETS]();
+    miss_count = new unsigned long long[slices][SETS]();
+
+    return;
+}
+
+void Finish()
+{
+    for(int i = 0; i<slices; i++)
+        Cache[i].Free();
+    delete []Cache;
+    for(int i = 0; i<MAX_OWNER; i++)
+        if(Private[i] != NULL)
+        {
+            Private[i]->l1.Free();
+            Private[i]->l2.Free();
+            delete Private[i];
+        }
+    delete []count;
+    delete []miss_count;
+
+    fclose(reader1.file);
+    if(benchname2[0] != 0)
+        fclose(reader2.file);
+    fclose(outfile1);
+    fclose(outfile2);
+
+    return;
+}
+
+Private_cache *Get_private(unsigned long long owner)
+{
+    if(owner >= MAX_OWNER)
+    {
+        printf("too many benchmarks, at most %d\n", MAX_OWNER);
+        exit(1);
+    }
+    if(Private[owner] == NULL)
+    {
+        Private[owner] = new Private_cache;
+        Private[owner]->l1.Init(l1_sets, l1_ways);
+        Private[owner]->l2.Init(l2_sets, l2_ways);
+        Private[owner]->back_invalidations = 0;
+    }
+    return Private[owner];
+}
+
+void Access(unsigned long long addr, unsigned long long n)    // n accesses to the same line in a row
+{
+    unsigned long long l = addr >> block_bits, victim;
+    Private_cache *p = Get_private(addr >> 53);
+
+    // L1D, the repeats of a line are hits on its MRU line
+    if(p->l1.sets > 0)
+    {
+        bool hit = p->l1.Access(l, victim);
+        p->l1.accesses += n-1;
+        if(hit)
+            return;
+    }
+    // L2
+    if(p->l2.sets > 0)
+    {
+        bool hit = p->l2.Access(l, victim);
+        if(p->l1.sets == 0)
+            p->l2.accesses += n-1;
+        if(hit)
+            return;
+        if(inclusive && victim != ~0ULL && p->l1.sets > 0 && p->l1.Invalidate(victim))
+            p->back_invalidations++;
+    }
+    // LLC
+    unsigned long long set_no = (addr >> block_bits) & 0B11111111111;    // set_bits
+    int slice = Cal_slice(addr);
+    Flat_cache &llc = Cache[slice];
+    unsigned long long repeats = p->l1.sets == 0 && p->l2.sets == 0? n-1:0;
+    count[slice][set_no] += 1 + repeats;
+    llc.accesses += repeats;
+    if(llc.Access(l, victim))    // the set of a slice is the lowest set_bits of the line, as set_no
+        return;
+    miss_count[slice][set_no]++;
+    if(inclusive && victim != ~0ULL)    // back-invalidate the private caches of the owner of the victim
+    {
+        Private_cache *q = Get_private(victim >> (53-block_bits));
+        bool done = false;
+        if(q->l2.sets > 0)
+            done |= q->l2.Invalidate(victim);
+        if(q->l1.sets > 0)
+            done |= q->l1.Invalidate(victim);
+        if(done)
+            q->back_invalidations++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc == 2)    // a merged trace
+    {
+        strcpy(benchname1, argv[1]);
+        benchname2[0] = 0;
+        strcpy(outfilename1, benchname1);
+        strcat(outfilename1, "_access");
+        strcpy(outfilename2, benchname1);
+        strcat(outfilename2, "_miss");
+    }
+    else
+    {
+        printf("please input ratio: ");
+        scanf("%d", &ratio);
+        strcpy(benchname1, argv[1]);
+        strcpy(benchname2, argv[2]);
+        strcpy(outfilename1, benchname1);
+        strcat(outfilename1, "_");
+        strcat(outfilename1, benchname2);
+        strcat(outfilename1, "_access");
+        strcpy(outfilename2, benchname1);
+        strcat(outfilename2, "_");
+        strcat(outfilename2, benchname2);
+        strcat(outfilename2, "_miss");
+    }
+    printf("please input the sets and ways of L1D(0 0: none): ");
+    scanf("%d %d", &l1_sets, &l1_ways);
+    printf("please input the sets and ways of L2(0 0: none): ");
+    scanf("%d %d", &l2_sets, &l2_ways);
+    printf("please input the inclusion(0: non-inclusive, 1: inclusive): ");
+    scanf("%d", &inclusive);
+    if((l1_sets & (l1_sets-1)) != 0 || (l2_sets & (l2_sets-1)) != 0 || l1_ways > MAX_WAYS || l2_ways > MAX_WAYS ||
+       (l1_sets > 0 && l1_ways < 1) || (l2_sets > 0 && l2_ways < 1))
+    {
+        printf("the sets must be a power of 2 and the ways 1~%d\n", MAX_WAYS);
+        exit(1);
+    }
+
+    Start();
+
+    unsigned long long n1, n2;
+    if(benchname2[0] == 0)
+    {
+        while(reader1.Next(addr1, n1, ~0ULL))
+            Access(addr1, n1);
+    }
+    else
+    while(reader1.Next(addr1, n1, 1) && reader2.Next(addr2, n2, 1))   // end with either file finished
+    {
+        addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
+        Access(addr1, 1);
+
+        int counter = ratio - 1;
+        while(counter > 0)
+        {
+            if(reader1.Next(addr1, n1, counter))    // a run is cut at the end of the turn of benchmark1
+            {
+                addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
+                Access(addr1, n1);
+                counter -= n1;
+            }
+            else
+                break;
+        }
+
+        Access(addr2, 1);
+    }
+
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
+        {
+            fprintf(outfile1, "%llu\n", count[i][j]);
+            fprintf(outfile2, "%llu\n", miss_count[i][j]);
+        }
+    unsigned long long llc_accesses = 0, llc_misses = 0;
+    for(int i = 0; i<slices; i++)
+    {
+        llc_accesses += Cache[i].accesses;
+        llc_misses += Cache[i].misses;
+    }
+    for(int i = MAX_OWNER-1; i>=0; i--)    // benchmark1 is marked by the largest owner
+        if(Private[i] != NULL)
+            printf("owner %d: L1D %llu/%llu misses, L2 %llu/%llu misses, %llu back-invalidations\n", i,
+                   Private[i]->l1.misses, Private[i]->l1.accesses, Private[i]->l2.misses, Private[i]->l2.accesses,
+                   Private[i]->back_invalidations);
+    printf("LLC: %llu/%llu misses\n", llc_misses, llc_accesses);
+
+    Finish();
+
+    return 0;
+}
@@ -4,9 +4,14 @@
  * Precondition: same as cal_set.cpp.
  * Usage: g++ -std=c++11 cal_set_slice.cpp -o cal_set_slice
  *        ./cal_set_slice [benchmark1] [benchmark2]
+ *        ./cal_set_slice [merged]    (a trace merged by merge.cpp, whose addresses are already marked)
+ *        with the options [-f/-w/-d/-s accesses] [-c accesses] [-r snapshot] [-p distance] [-B] [-P] [-i accesses]
+ *        [-I lengths] [-m slice_map] [-k shards -j shard] [-C store] [-T] [-L live_page] after the benchmarks,
+ *        each described where it is implemented
  * Input: follow the hints
- * Output: the accesses and misses of all the sets, saved as [benchmark1]_[benchmark2]_access and
- *         [benchmark1]_[benchmark2]_miss
+ * Output: the accesses and misses of all the sets, saved as [benchmark1]_[benchmark2]_access.npy and
+ *         [benchmark1]_[benchmark2]_miss.npy ([merged]_access.npy and [merged]_miss.npy), uint64 arrays of
+ *         [slices][SETS]; with "-T", as text, a line for every set; with -i or -I, also the series
  * Author: Jack Wang
  * Date: 2019.10.16
  */
@@ -16,281 +21,1087 @@
 #include <cstdlib>
 #include <cmath>
 #include <unordered_map>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "live.h"
+#include "slice_map.h"
+#include "cache_slice.h"
+#include "profiler.h"
 using namespace std;
 
 char benchname1[20], benchname2[20];
-char filename1[30], filename2[30], outfilename1[100], outfilename2[100];
-FILE *file1, *file2, *outfile1, *outfile2;
+char outfilename1[100], outfilename2[100];
+FILE *outfile1, *outfile2;
+bool text = false;    // "-T", the outputs as text instead of .npy
 int slices = 8, set_bits = 11, block_bits = 6, ways = 11;
 unsigned long long addr1, addr2;
 int ratio;    // benchmark1:benchmark2
 #define SETS 2048    // 2^set_bits
+unsigned long long (*count)[SETS], (*miss_count)[SETS];
+unsigned long long accesses = 0, checkpoint = 0, next_checkpoint;    // checkpoint: 0 for none
+unsigned long long fast_forward = 0, warm_up = 0, detail = 0, skip = 0, measured = 0;    // see Segment
+bool measure = true;    // the accesses of the current segment are counted
+#define BATCH 256    // accesses simulated as a batch
+int prefetch_distance = 8;    // in accesses, 0 for none
+unsigned long long batch_addr[BATCH], batch_n[BATCH];
+bool batch_measure[BATCH];
+int batch_len = 0;
+bool benchmark = false;    // keep all the accesses for the benchmark of the prefetch distance
+char snapshot_filename[200], resume_filename[200];
+// Shards: with "-k [shards] -j [shard]", the process simulates only the sets whose slice*SETS+set_no mod shards is
+// shard, so the shards may run as independent processes, on one machine or several, each reading the whole trace
+// (the other sets cost only their hash). The partial counters are saved as [benchmark1]_[benchmark2]_shard_[shard]_of_
+// [shards], the snapshot and series with the same name; shard_merge.cpp merges the shards, and launches them locally.
+int shards = 1, shard = 0;    // "-k", "-j": this process simulates the sets of (slice*SETS+set) % shards == shard
+unsigned long long series_interval = 0;    // "-i", the accesses of an interval of the series, 0 for none
+char lengths_filename[200];                // "-I", the accesses of every interval, a line each
+char series_filename[200];
+FILE *series_file, *lengths_file;
+unsigned long long next_interval = ~0ULL, last_interval = 0;    // the ends of the current and the last interval
+// the access and miss counters at the end of the last interval, and the counts of the last interval,
+// for every slice*SETS+set
+unsigned long long *series_total[2], *series_prev[2];
+// Profile: with "-P", the time of every phase (read/parse, hash of Cal_slice, lookup/update of the sets, checkpoint
+// and output) and, where perf_event_open is permitted, the cycles, instructions, LLC misses and dTLB misses of this
+// thread are counted, switched at the boundaries of the batches, and printed at the end (see profiler.h).
+bool profiling = false;    // "-P"
 
-struct Node
+Profiler profiler;
+
+inline void Profile(int phase)    // only a branch when not profiling
 {
-    Node *pre;
-    Node *next;
-    int line_no;
-    unsigned long long tag;
-    Node(int a) 
-    {
-        line_no = a;
-        pre = NULL;
-        next = NULL;
-    }
-};
+    if(profiling)
+        profiler.Switch(phase);
+}
 
-class Cache_slice
+Cache_slice<> *Cache;
+
+// a .rle is read when the .out does not exist, and the repeats of a line are credited as MRU hits in bulk; when
+// neither exists, the binary trace of index.cpp
+class Trace_reader    // [benchmark].out, or [benchmark].rle collapsed by collapse.cpp, or [benchmark].bin
 {
 public:
-    Node *head[SETS], *tail[SETS];
-    unordered_map<unsigned long long, int> tag_line_no[SETS];
-    unordered_map<int, Node*> line_no_ptr[SETS];
+    FILE *file;
+    int kind;                         // 0: .out, 1: .rle, 2: .bin
+    unsigned long long addr, left;    // the current run of the same line
 
-    Cache_slice();
-    // ~Cache_slice();
-    void Refresh(unsigned long long set_no, unsigned long long tag);
-    void Replace(unsigned long long set_no, unsigned long long newtag);
+    bool Open(const char *benchname);
+    bool Next(unsigned long long &a, unsigned long long &n, unsigned long long max);
+    unsigned long long Skip(unsigned long long n);
+};
 
+struct Reader_state
+{
+    unsigned long long offset, addr, left;
 };
 
-Cache_slice::Cache_slice()
+bool Trace_reader::Open(const char *benchname)
 {
-    for(int k = 0; k<SETS; k++)
+    char filename[200];
+    sprintf(filename, "%s.out", benchname);
+    kind = 0;
+    left = 0;
+    file = fopen(filename, "r");
+    if(file == NULL)
     {
-        Node *tmp_pre = NULL, *tmp_next = NULL;
-        head[k] = new Node(0);
-        tmp_pre = head[k];
-        for(int i = 1; i<ways; i++)
-        {
-            tmp_next = new Node(i);
-            tmp_pre->next = tmp_next;
-            tmp_next->pre = tmp_pre;
-            tmp_pre = tmp_next;
-        }
-        tail[k] = tmp_pre;
-
-        Node *tmp = head[k];
-        for(int i = 0; i<ways; i++)
-        {
-            line_no_ptr[k].insert(make_pair(i, tmp));
-            tmp = tmp->next;
-        }
+        sprintf(filename, "%s.rle", benchname);
+        file = fopen(filename, "r");
+        kind = 1;
     }
+    if(file == NULL)
+    {
+        sprintf(filename, "%s.bin", benchname);
+        file = fopen(filename, "rb");
+        kind = 2;
+    }
+    return file != NULL;
 }
 
-void Cache_slice::Refresh(unsigned long long set_no, unsigned long long tag)
+// the next n (1~max) accesses, which are all to the line of address a
+bool Trace_reader::Next(unsigned long long &a, unsigned long long &n, unsigned long long max)
 {
-    int line_no_tmp = tag_line_no[set_no][tag];
-    if(line_no_tmp >= ways || line_no_tmp < 0)
+    if(left == 0 && kind == 2)
     {
-        printf("line_no_tmp >= ways || line_no_tmp < 0\n");
-        exit(1);
+        if(fread(&addr, sizeof(unsigned long long), 1, file) != 1)
+            return false;
+        left = 1;
     }
-    Node *tmp = line_no_ptr[set_no][line_no_tmp];
-    if(head[set_no] != tmp)
+    else if(left == 0)
     {
-        if(tmp->pre != NULL)
-            tmp->pre->next = tmp->next;
-        if(tmp->next != NULL)
-            tmp->next->pre = tmp->pre;
-        if(tail[set_no] == tmp)
-            tail[set_no] = tmp->pre;
-        tmp->next = head[set_no];
-        head[set_no]->pre = tmp;
-        tmp->pre = NULL;
-        head[set_no] = tmp;
+        char tmp[100], *p;
+        if(fgets(tmp, 99, file) == NULL)
+            return false;
+        addr = strtoull(tmp, &p, 10);
+        left = kind == 1? strtoull(p, NULL, 10):1;
+        if(left == 0)
+            left = 1;
     }
-    return;
+    a = addr;
+    n = left < max? left:max;
+    left -= n;
+    return true;
 }
 
-void Cache_slice::Replace(unsigned long long set_no, unsigned long long newtag)
+unsigned long long Trace_reader::Skip(unsigned long long n)    // pass over n accesses, returns those really skipped
 {
-    int line_no_tmp = tail[set_no]->line_no;
-    unsigned long long oldtag = tail[set_no]->tag;
-    tag_line_no[set_no].erase(oldtag);
-    tag_line_no[set_no][newtag] = line_no_tmp;
-    tail[set_no]->tag = newtag;
-    Refresh(set_no, newtag);
-    return;
+    unsigned long long skipped = left < n? left:n;    // the rest of the current run
+    left -= skipped;
+    if(kind == 2)
+    {
+        long pos = ftell(file);
+        fseek(file, 0, SEEK_END);
+        unsigned long long rest = (ftell(file) - pos) / sizeof(unsigned long long);
+        unsigned long long k = rest < n-skipped? rest:n-skipped;
+        fseek(file, pos + k*sizeof(unsigned long long), SEEK_SET);
+        return skipped + k;
+    }
+    char tmp[100], *p;
+    while(skipped < n && fgets(tmp, 99, file) != NULL)
+    {
+        if(kind == 0)
+        {
+            skipped++;
+            continue;
+        }
+        unsigned long long a = strtoull(tmp, &p, 10), run = strtoull(p, NULL, 10);
+        if(run == 0)
+            run = 1;
+        if(run > n-skipped)    // the run goes on after the skip
+        {
+            addr = a;
+            left = run - (n-skipped);
+            run = n-skipped;
+        }
+        skipped += run;
+    }
+    return skipped;
 }
 
-Cache_slice *Cache;
+Trace_reader reader1, reader2;
 
 void Start()
 {
-    file1 = fopen(filename1, "r");
-    file2 = fopen(filename2, "r");
+    bool open1 = reader1.Open(benchname1);
+    bool open2 = benchname2[0] != 0? reader2.Open(benchname2):true;
     outfile1 = fopen(outfilename1, "w");
-    outfile2 = fopen(outfilename2, "w");
-    if(file1 == NULL || file2 == NULL || outfile1 == NULL || outfile2 == NULL)
+    outfile2 = shards == 1? fopen(outfilename2, "w"):NULL;    // a shard writes its partial counters to outfile1
+    if(!open1 || !open2 || outfile1 == NULL || (shards == 1 && outfile2 == NULL))
     {
         printf("cannot open files\n");
         exit(1);
     }
 
-    Cache = new Cache_slice[slices];
+    Cache = new Cache_slice<>[slices];
+    for(int i = 0; i<slices; i++)
+        Cache[i].Init(SETS, ways);
+    count = new unsigned long long[slices][SETS]();
+    miss_count = new unsigned long long[slices][SETS]();
 
     return;
 }
 
 void Finish()
 {
+    for(int i = 0; i<slices; i++)
+        Cache[i].Free();
     delete []Cache;
+    delete []count;
+    delete []miss_count;
 
-    fclose(file1);
-    fclose(file2);
+    fclose(reader1.file);
+    if(benchname2[0] != 0)
+        fclose(reader2.file);
     fclose(outfile1);
-    fclose(outfile2);
+    if(outfile2 != NULL)
+        fclose(outfile2);
 
     return;
 }
 
-int Cal_slice(unsigned long long addr)
+unsigned long long Hash_bytes(const unsigned char *p, size_t n, unsigned long long h)
 {
-    unsigned long long result = 0;
-    result += ((addr>>37)&1) ^ ((addr>>36)&1) ^ ((addr>>35)&1) ^ ((addr>>34)&1) ^ ((addr>>31)&1) ^ ((addr>>30)&1)
-              ^ ((addr>>27)&1) ^ ((addr>>26)&1) ^ ((addr>>23)&1) ^ ((addr>>22)&1) ^ ((addr>>19)&1) ^ ((addr>>16)&1)
-              ^ ((addr>>13)&1) ^ ((addr>>12)&1) ^ ((addr>>8)&1);
-    result = result << 1;
-    result += ((addr>>37)&1) ^ ((addr>>35)&1) ^ ((addr>>34)&1) ^ ((addr>>33)&1) ^ ((addr>>31)&1) ^ ((addr>>29)&1)
-              ^ ((addr>>28)&1) ^ ((addr>>26)&1) ^ ((addr>>24)&1) ^ ((addr>>23)&1) ^ ((addr>>22)&1) ^ ((addr>>21)&1)
-              ^ ((addr>>20)&1) ^ ((addr>>19)&1) ^ ((addr>>17)&1) ^ ((addr>>15)&1) ^ ((addr>>13)&1) ^ ((addr>>11)&1)
-              ^ ((addr>>7)&1);
-    result = result << 1;
-    result += ((addr>>36)&1) ^ ((addr>>35)&1) ^ ((addr>>33)&1) ^ ((addr>>32)&1) ^ ((addr>>30)&1) ^ ((addr>>28)&1)
-              ^ ((addr>>27)&1) ^ ((addr>>26)&1) ^ ((addr>>25)&1) ^ ((addr>>24)&1) ^ ((addr>>22)&1) ^ ((addr>>20)&1)
-              ^ ((addr>>18)&1) ^ ((addr>>17)&1) ^ ((addr>>16)&1) ^ ((addr>>14)&1) ^ ((addr>>12)&1) ^ ((addr>>10)&1)
-              ^ ((addr>>6)&1);
-    return result;
+    size_t i = 0;
+    for(; i+8<=n; i += 8)
+    {
+        unsigned long long w;
+        memcpy(&w, p+i, 8);
+        h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 32;
+    }
+    for(; i<n; i++)
+        h = (h ^ p[i]) * 0x100000001B3ULL;
+    h ^= h >> 30;    // the finalizer of splitmix64
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
 }
 
-int main(int argc, char *argv[])
+// Slices: the 8 slices of Cal_slice by default; with "-m [slice_map]", the slices and the hash of the file (see
+// Load_slice_map of slice_map.h), for a number of slices not a power of 2 (e.g. 18, 24 or 28 of Skylake-SP and
+// Ice Lake servers) with a table from the index to the slice. slice_map.cpp checks a map.
+unsigned long long Map_hash()    // of the slice map, the same for every run of Cal_slice
 {
-    unsigned long long count[slices][SETS];
-    unsigned long long miss_count[slices][SETS];
-    for(int i = 0; i<slices; i++)
-        for(int j = 0; j<SETS; j++)
+    unsigned long long hash = Hash_bytes((const unsigned char *)hash_mask, hash_bits*sizeof(unsigned long long),
+                                         hash_bits);
+    if(slice_table != NULL)
+        hash = Hash_bytes((const unsigned char *)slice_table, (1<<hash_bits)*sizeof(unsigned short), hash);
+    return hash;
+}
+
+// Checkpoint: with "-c [accesses]", the complete state (the tags of every set in LRU order, the counters and the
+// offsets of the traces) is saved to [benchmark1]_[benchmark2].ckpt ([merged].ckpt) about every [accesses] accesses,
+// between two turns. It is built in memory and written to a temporary file which then replaces the old one, so a
+// crash never leaves a broken snapshot. With "-r [snapshot]", the run resumes from it (mmaped), or forks from it with
+// another ratio, on the same traces and with the same slice map.
+struct Snapshot_header
+{
+    char magic[8];    // "CKPT2"
+    unsigned int slices, sets, ways, merged;
+    unsigned long long map_hash;    // see Map_hash
+    unsigned long long accesses, measured;
+    Reader_state reader[2];
+};
+// followed by count[slices][SETS], miss_count[slices][SETS], tags[slices][SETS][ways] and used[slices][SETS] (bytes)
+
+void Save_snapshot()
+{
+    size_t lists = (size_t)slices*SETS;
+    size_t size = sizeof(Snapshot_header) + lists*(2+ways)*sizeof(unsigned long long) + lists;
+    char *buf = new char[size]();
+    Snapshot_header *header = (Snapshot_header *)buf;
+    strcpy(header->magic, "CKPT2");
+    header->slices = slices;
+    header->sets = SETS;
+    header->ways = ways;
+    header->merged = benchname2[0] == 0;
+    header->map_hash = Map_hash();
+    header->accesses = accesses;
+    header->measured = measured;
+    Trace_reader *readers[2] = {&reader1, &reader2};
+    for(int r = 0; r<2; r++)
+        if(r == 0 || !header->merged)
         {
-            count[i][j] = 0;
-            miss_count[i][j] = 0;
+            header->reader[r].offset = ftell(readers[r]->file);
+            header->reader[r].addr = readers[r]->addr;
+            header->reader[r].left = readers[r]->left;
         }
-        
-    printf("please input ratio: ");
-    scanf("%d", &ratio);
-    strcpy(benchname1, argv[1]);
-    strcpy(benchname2, argv[2]);
-    strcpy(filename1, benchname1);
-    strcpy(filename2, benchname2);
-    strcat(filename1, ".out");
-    strcat(filename2, ".out");
-    strcpy(outfilename1, benchname1);
-    strcat(outfilename1, "_");
-    strcat(outfilename1, benchname2);
-    strcat(outfilename1, "_access");
-    strcpy(outfilename2, benchname1);
-    strcat(outfilename2, "_");
-    strcat(outfilename2, benchname2);
-    strcat(outfilename2, "_miss");
+    unsigned long long *p = (unsigned long long *)(header+1);
+    memcpy(p, count, lists*sizeof(unsigned long long));
+    memcpy(p+lists, miss_count, lists*sizeof(unsigned long long));
+    unsigned long long *tags = p + 2*lists;
+    unsigned char *used = (unsigned char *)(tags + lists*ways);
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
+            used[i*SETS+j] = Cache[i].Save(j, tags + ((size_t)i*SETS+j)*ways);
 
-    Start();
+    char tmp[220];
+    sprintf(tmp, "%s.tmp", snapshot_filename);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 || write(fd, buf, size) != (ssize_t)size || fsync(fd) != 0 || close(fd) != 0 ||
+       rename(tmp, snapshot_filename) != 0)
+    {
+        printf("cannot save the snapshot %s\n", snapshot_filename);
+        exit(1);
+    }
+    delete []buf;
+}
 
-    char tmp1[100], tmp2[100];
-    while(fgets(tmp1, 99, file1) != NULL && fgets(tmp2, 99, file2) != NULL)   // end with either file finished
+void Load_snapshot()
+{
+    int fd = open(resume_filename, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0)
     {
-        addr1 = strtoull(tmp1, NULL, 10);
-        addr2 = strtoull(tmp2, NULL, 10);
-        addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
-        unsigned long long tag1 = addr1 >> (set_bits+block_bits);
-        unsigned long long tag2 = addr2 >> (set_bits+block_bits);
-        unsigned long long set_no1 = (addr1 >> block_bits) & 0B11111111111;    // set_bits
-        unsigned long long set_no2 = (addr2 >> block_bits) & 0B11111111111;
-        int slice1 = Cal_slice(addr1);
-        int slice2 = Cal_slice(addr2);
-
-        count[slice1][set_no1]++;
-        if(Cache[slice1].tag_line_no[set_no1].find(tag1) != Cache[slice1].tag_line_no[set_no1].end()) // found
-            Cache[slice1].Refresh(set_no1, tag1);
-        else    // not found
+        printf("cannot open %s\n", resume_filename);
+        exit(1);
+    }
+    size_t lists = (size_t)slices*SETS;
+    size_t size = sizeof(Snapshot_header) + lists*(2+ways)*sizeof(unsigned long long) + lists;
+    const Snapshot_header *header = (const Snapshot_header *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if((size_t)st.st_size != size || header == MAP_FAILED || strcmp(header->magic, "CKPT2") != 0 ||
+       (int)header->slices != slices || header->sets != SETS || (int)header->ways != ways ||
+       header->merged != (benchname2[0] == 0) || header->map_hash != Map_hash())
+    {
+        printf("%s does not match the cache, the slice map or the input\n", resume_filename);
+        exit(1);
+    }
+    accesses = header->accesses;
+    measured = header->measured;
+    Trace_reader *readers[2] = {&reader1, &reader2};
+    for(int r = 0; r<2; r++)
+        if(r == 0 || !header->merged)
         {
-            miss_count[slice1][set_no1]++;
-            if(Cache[slice1].tag_line_no[set_no1].size() < ways)   // not full
-            {
-                int allocated_line_no = Cache[slice1].tag_line_no[set_no1].size();
-                Cache[slice1].tag_line_no[set_no1][tag1] = allocated_line_no;
-                Node* tmp = Cache[slice1].line_no_ptr[set_no1][allocated_line_no];
-                tmp->tag = tag1;
-                Cache[slice1].Refresh(set_no1, tag1);
-            }
-            else // full
-            {
-                Cache[slice1].Replace(set_no1, tag1);
-            }
+            fseek(readers[r]->file, header->reader[r].offset, SEEK_SET);
+            readers[r]->addr = header->reader[r].addr;
+            readers[r]->left = header->reader[r].left;
         }
+    const unsigned long long *p = (const unsigned long long *)(header+1);
+    memcpy(count, p, lists*sizeof(unsigned long long));
+    memcpy(miss_count, p+lists, lists*sizeof(unsigned long long));
+    const unsigned long long *tags = p + 2*lists;
+    const unsigned char *used = (const unsigned char *)(tags + lists*ways);
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
+            Cache[i].Load(j, tags + ((size_t)i*SETS+j)*ways, used[i*SETS+j]);
+    munmap((void *)header, size);
+    printf("resumed from %s after %llu accesses\n", resume_filename, accesses);
+}
 
+// Sampling, over the interleaved accesses: "-f F" skips the first F accesses, then "-w W" updates the cache without
+// counting, "-d D" counts (all the rest when 0), and "-s S" skips, warm-up, detail and skip repeating as SMARTS does.
+// A skip passes over the lines of a .out without parsing, the runs of a .rle as a whole, and seeks a .bin. The
+// segments change only between two turns, so one is rounded down to whole turns and the rest of a skip is warm-up.
+// the segment of the access at position pos, and the accesses left in the segment; 0: skip, 1: warm-up, 2: detail
+int Segment(unsigned long long pos, unsigned long long &left)
+{
+    if(pos < fast_forward)
+    {
+        left = fast_forward - pos;
+        return 0;
+    }
+    pos -= fast_forward;
+    if(detail == 0)
+    {
+        left = pos < warm_up? warm_up - pos:~0ULL;
+        return pos < warm_up? 1:2;
+    }
+    unsigned long long period = warm_up + detail + skip;
+    pos %= period;
+    if(pos < warm_up)
+    {
+        left = warm_up - pos;
+        return 1;
+    }
+    if(pos < warm_up + detail)
+    {
+        left = warm_up + detail - pos;
+        return 2;
+    }
+    left = period - pos;
+    return 0;
+}
 
-        int counter = ratio - 1;
-        while(counter--)
+void Next_segment()    // between two turns, passes over the skipped segments and decides if the next turn is counted
+{
+    while(true)
+    {
+        unsigned long long left;
+        int segment = Segment(accesses, left);
+        if(segment == 0)
         {
-            if(fgets(tmp1, 99, file1) != NULL)
+            unsigned long long skipped;
+            if(benchname2[0] == 0)
+                skipped = reader1.Skip(left);
+            else    // whole turns only, so the interleaving goes on as it is
             {
-                addr1 = strtoull(tmp1, NULL, 10);
-                addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
-                tag1 = addr1 >> (set_bits+block_bits);
-                set_no1 = (addr1 >> block_bits) & 0B011111111111;    // set_bits
-                slice1 = Cal_slice(addr1);
-
-                count[slice1][set_no1]++;
-                if(Cache[slice1].tag_line_no[set_no1].find(tag1) != Cache[slice1].tag_line_no[set_no1].end()) // found
-                    Cache[slice1].Refresh(set_no1, tag1);
-                else    // not found
-                {
-                    miss_count[slice1][set_no1]++;
-                    if(Cache[slice1].tag_line_no[set_no1].size() < ways)   // not full
-                    {
-                        int allocated_line_no = Cache[slice1].tag_line_no[set_no1].size();
-                        Cache[slice1].tag_line_no[set_no1][tag1] = allocated_line_no;
-                        Node* tmp = Cache[slice1].line_no_ptr[set_no1][allocated_line_no];
-                        tmp->tag = tag1;
-                        Cache[slice1].Refresh(set_no1, tag1);
-                    }
-                    else // full
-                    {
-                        Cache[slice1].Replace(set_no1, tag1);
-                    }
-                }
+                unsigned long long turns = left / (ratio+1);
+                skipped = reader1.Skip(turns * ratio);
+                skipped += reader2.Skip(skipped < turns * ratio? 0:turns);
             }
-            else
-                break;
+            accesses += skipped;
+            if(skipped > 0 && skipped == left)
+                continue;
         }
+        measure = segment == 2;
+        return;
+    }
+}
+
+void Run_batch();
+
+// Series: with "-i [accesses]", the accesses and misses of every set are also saved for every interval of [accesses],
+// or with "-I [lengths]" of the lengths in the file, a line each (e.g. a _formalized perf file); the rest of the trace
+// is the last interval, and a run of a .rle is cut at the end of an interval. Every interval has an access and a miss
+// column, each count the LEB128 varint of its zigzagged difference from the same set in the last interval, and is
+// sparse, an index column of the gaps between the sets accessed and only their counts, when smaller. series.cpp
+// decodes it. Not with -r or -B.
+struct Series_header
+{
+    char magic[8];    // "SERIES1"
+    unsigned int slices, sets;
+    unsigned long long interval;    // 0: the lengths were given by a file
+};
+// followed by the intervals till the end of the file, each an Interval_header and its columns
+
+struct Interval_header
+{
+    unsigned long long end;       // the accesses at the end of the interval
+    unsigned int active;          // the sets accessed in the interval
+    unsigned int sparse;          // 0: every set is in the columns, 1: only the active ones, listed in the index column
+    unsigned long long bytes[3];  // of the index (0 when dense), access and miss columns
+};
 
-        count[slice2][set_no2]++;
-        if(Cache[slice2].tag_line_no[set_no2].find(tag2) != Cache[slice2].tag_line_no[set_no2].end()) // found
-            Cache[slice2].Refresh(set_no2, tag2);
-        else    // not found
+void Put_varint(vector<unsigned char> &column, unsigned long long v)    // LEB128
+{
+    while(v >= 0x80)
+    {
+        column.push_back((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    column.push_back(v);
+}
+
+unsigned long long Zigzag(unsigned long long value, unsigned long long prev)    // the delta as an unsigned number
+{
+    long long delta = (long long)(value - prev);
+    return ((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63);
+}
+
+void Next_interval()
+{
+    last_interval = next_interval;
+    if(series_interval > 0)
+    {
+        next_interval += series_interval;
+        return;
+    }
+    char tmp[100];
+    if(fgets(tmp, 99, lengths_file) != NULL)
+        next_interval += strtoull(tmp, NULL, 10);
+    else
+        next_interval = ~0ULL;    // the rest of the trace is the last interval
+}
+
+void Start_series()
+{
+    series_file = fopen(series_filename, "wb");
+    if(series_file == NULL || (lengths_filename[0] != 0 && (lengths_file = fopen(lengths_filename, "r")) == NULL))
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    Series_header header;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, "SERIES1");
+    header.slices = slices;
+    header.sets = SETS;
+    header.interval = series_interval;
+    fwrite(&header, sizeof(header), 1, series_file);
+    for(int c = 0; c<2; c++)
+    {
+        series_total[c] = new unsigned long long[slices*SETS]();
+        series_prev[c] = new unsigned long long[slices*SETS]();
+    }
+    next_interval = 0;
+    Next_interval();
+}
+
+// the counts of every set since the last interval, each column delta-encoded against the last interval,
+// as the dense or the sparse layout, whichever is smaller
+void Write_interval(unsigned long long end)
+{
+    vector<unsigned char> dense[2], sparse[3];
+    Interval_header header;
+    header.end = end;
+    header.active = 0;
+    unsigned long long last_active = ~0ULL;
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
         {
-            miss_count[slice2][set_no2]++;
-            if(Cache[slice2].tag_line_no[set_no2].size() < ways)   // not full
+            unsigned long long k = (unsigned long long)i*SETS+j;
+            unsigned long long value[2] = {count[i][j] - series_total[0][k], miss_count[i][j] - series_total[1][k]};
+            if(value[0] > 0)
             {
-                int allocated_line_no = Cache[slice2].tag_line_no[set_no2].size();
-                Cache[slice2].tag_line_no[set_no2][tag2] = allocated_line_no;
-                Node* tmp = Cache[slice2].line_no_ptr[set_no2][allocated_line_no];
-                tmp->tag = tag2;
-                Cache[slice2].Refresh(set_no2, tag2);
+                Put_varint(sparse[0], k - last_active - 1);    // the gap from the last active set
+                last_active = k;
+                header.active++;
             }
-            else // full
+            for(int c = 0; c<2; c++)
             {
-                Cache[slice2].Replace(set_no2, tag2);
+                unsigned long long z = Zigzag(value[c], series_prev[c][k]);
+                Put_varint(dense[c], z);
+                if(value[0] > 0)
+                    Put_varint(sparse[1+c], z);
+                series_prev[c][k] = value[c];
             }
+            series_total[0][k] = count[i][j];
+            series_total[1][k] = miss_count[i][j];
         }
+    header.sparse = sparse[0].size() + sparse[1].size() + sparse[2].size() < dense[0].size() + dense[1].size();
+    vector<unsigned char> none;    // dense has no index column
+    vector<unsigned char> *columns[3] = {&sparse[0], &sparse[1], &sparse[2]};
+    if(!header.sparse)
+    {
+        columns[0] = &none;
+        columns[1] = &dense[0];
+        columns[2] = &dense[1];
+    }
+    for(int c = 0; c<3; c++)
+        header.bytes[c] = columns[c]->size();
+    fwrite(&header, sizeof(header), 1, series_file);
+    for(int c = 0; c<3; c++)
+        fwrite(columns[c]->data(), 1, columns[c]->size(), series_file);
+}
+
+void Close_intervals()    // the intervals ended by now
+{
+    Run_batch();    // the counters must be up to date
+    while(accesses >= next_interval)
+    {
+        Write_interval(next_interval);
+        Next_interval();
     }
+}
 
+void Finish_series()
+{
+    Close_intervals();    // passed over by a skipped segment at the end of the trace, as Access does
+    if(accesses > last_interval || last_interval == 0)    // the last interval, cut by the end of the trace
+        Write_interval(accesses);
+    fclose(series_file);
+    if(lengths_file != NULL)
+        fclose(lengths_file);
+    for(int c = 0; c<2; c++)
+    {
+        delete []series_total[c];
+        delete []series_prev[c];
+    }
+}
+
+void Checkpoint()    // between two turns
+{
+    if(checkpoint == 0 || accesses < next_checkpoint)
+        return;
+    Run_batch();    // the state must be up to date
+    Profile(PHASE_CHECKPOINT);
+    Save_snapshot();
+    Profile(PHASE_READ);
+    next_checkpoint = accesses + checkpoint;
+}
+
+// Live page: with "-L [name]", the progress, the hits and misses of the first LIVE_SLICES slices and the accesses/s
+// are published in the shared memory object [name] (see Live_page of live.h) under a seqlock, which live.cpp prints
+// while the run goes on; it is removed at the end. A shard adds _shard_[shard]_of_[shards] to the name.
+#define LIVE_ACCESSES (1ULL<<20)   // accesses between two updates of the live page
+
+char live_name[200];    // "-L", the shared memory object, none when empty
+Live_page *live;
+unsigned long long next_live = 0, last_live_accesses = 0;
+double live_start, last_live_time;
+
+double Now()
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+void Open_live(const char *name)
+{
+    int fd = shm_open(live_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if(fd < 0 || ftruncate(fd, sizeof(Live_page)) != 0 ||
+       (live = (Live_page *)mmap(NULL, sizeof(Live_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        printf("cannot create the live page %s\n", live_name);
+        exit(1);
+    }
+    close(fd);
+    live->kind = 0;
+    live->slices = slices < LIVE_SLICES? slices:LIVE_SLICES;
+    live->pid = getpid();
+    snprintf(live->name, sizeof(live->name), "%s", name);
+    struct stat st;
+    if(fstat(fileno(reader1.file), &st) == 0)
+        live->total_bytes += st.st_size;
+    if(benchname2[0] != 0 && fstat(fileno(reader2.file), &st) == 0)
+        live->total_bytes += st.st_size;
+    atomic_thread_fence(memory_order_release);
+    strcpy(live->magic, LIVE_MAGIC);    // the last, the viewer waits for it
+    live_start = last_live_time = Now();
+}
+
+void Update_live(bool done)
+{
+    double now = Now();
+    unsigned seq = live->seq.load(memory_order_relaxed);
+    live->seq.store(seq+1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    live->seconds = now - live_start;
+    if(accesses > last_live_accesses && now > last_live_time)    // kept when nothing is new, e.g. at the end
+    {
+        live->rate = (accesses - last_live_accesses)/(now - last_live_time);
+        last_live_time = now;
+        last_live_accesses = accesses;
+    }
+    live->accesses = accesses;
+    live->bytes = ftell(reader1.file) + (benchname2[0] != 0? ftell(reader2.file):0);
+    for(int i = 0; i<live->slices; i++)
+    {
+        unsigned long long access = 0, miss = 0;
+        for(int j = 0; j<SETS; j++)
+        {
+            access += count[i][j];
+            miss += miss_count[i][j];
+        }
+        live->hit[i] = access - miss;
+        live->miss[i] = miss;
+    }
+    live->done = done;
+    live->seq.store(seq+2, memory_order_release);
+    next_live = accesses + LIVE_ACCESSES;
+}
+
+inline void Publish_live()    // only a branch without "-L"
+{
+    if(live != NULL && accesses >= next_live)
+        Update_live(false);
+}
+
+void Close_live()
+{
+    Update_live(true);
+    munmap(live, sizeof(Live_page));
+    shm_unlink(live_name);    // the viewers keep their mappings
+}
+
+// Result store: with "-C [store]", the outputs are looked up in [store] before simulating and saved there after,
+// keyed by a hash of everything they depend on (see Result_config), where the content hash of a trace is kept in
+// [trace].hash with its size and modification time. An entry replaces a temporary file, and its first line, the
+// whole configuration, is checked on a hit. Not with -r, -B, -i, -I or -k, whose outputs are more than the counters.
+#define SIM_VERSION 1    // bump when the outputs of the same traces and configuration change
+char store_dirname[200];    // "-C", the result store, none when empty
+
+bool Replace_file(const char *filename, const char *text, size_t size)    // the readers never see a partial file
+{
+    char tmp[300];
+    sprintf(tmp, "%s.tmp.%d", filename, (int)getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 || write(fd, text, size) != (ssize_t)size || close(fd) != 0 || rename(tmp, filename) != 0)
+    {
+        unlink(tmp);
+        return false;
+    }
+    return true;
+}
+
+// the hash of the content of the trace which Trace_reader reads, cached in [trace].hash with the size and
+// the modification time of the trace, and computed again when either differs
+unsigned long long Trace_hash(const char *benchname)
+{
+    const char *suffix[3] = {".out", ".rle", ".bin"};
+    char filename[200], hash_filename[220];
+    struct stat st;
+    int k = 0;
+    for(; k<3; k++)
+    {
+        sprintf(filename, "%s%s", benchname, suffix[k]);
+        if(stat(filename, &st) == 0)
+            break;
+    }
+    if(k == 3)
+        return 0;
+    sprintf(hash_filename, "%s.hash", filename);
+    unsigned long long size, sec, nsec, hash;
+    FILE *file = fopen(hash_filename, "r");
+    if(file != NULL)
+    {
+        bool valid = fscanf(file, "%llu %llu %llu %llx", &size, &sec, &nsec, &hash) == 4 &&
+                     size == (unsigned long long)st.st_size && sec == (unsigned long long)st.st_mtim.tv_sec &&
+                     nsec == (unsigned long long)st.st_mtim.tv_nsec;
+        fclose(file);
+        if(valid)
+            return hash;
+    }
+
+    file = fopen(filename, "rb");
+    if(file == NULL)
+        return 0;
+    vector<unsigned char> buf(1<<20);
+    hash = st.st_size;
+    size_t n;
+    while((n = fread(buf.data(), 1, buf.size(), file)) > 0)
+        hash = Hash_bytes(buf.data(), n, hash);
+    fclose(file);
+    char text[100];
+    int len = sprintf(text, "%llu %llu %llu %016llx\n", (unsigned long long)st.st_size,
+                      (unsigned long long)st.st_mtim.tv_sec, (unsigned long long)st.st_mtim.tv_nsec, hash);
+    if(!Replace_file(hash_filename, text, len))
+        printf("cannot save %s\n", hash_filename);
+    return hash;
+}
+
+// everything the outputs depend on, on one line
+void Result_config(char *config)
+{
+    sprintf(config, "v%d lru slices %d sets %d ways %d set_bits %d block_bits %d map %016llx %s %016llx",
+            SIM_VERSION, slices, SETS, ways, set_bits, block_bits, Map_hash(), benchname1, Trace_hash(benchname1));
+    if(benchname2[0] != 0)
+        sprintf(config+strlen(config), " %s %016llx ratio %d", benchname2, Trace_hash(benchname2), ratio);
+    sprintf(config+strlen(config), " f %llu w %llu d %llu s %llu", fast_forward, warm_up, detail, skip);
+}
+
+// an entry of the store is [store]/[hash of the config], with the config on its first line (checked on a hit),
+// "accesses measured" on the second, and "access miss" of every set
+void Result_entry(const char *config, char *entry_filename)
+{
+    sprintf(entry_filename, "%s/%016llx", store_dirname,
+            Hash_bytes((const unsigned char *)config, strlen(config), SIM_VERSION));
+}
+
+bool Lookup_result()
+{
+    char config[500], entry_filename[300];
+    Result_config(config);
+    Result_entry(config, entry_filename);
+    FILE *file = fopen(entry_filename, "r");
+    if(file == NULL)
+        return false;
+    vector<char> line(strlen(config)+3);
+    bool hit = fgets(line.data(), line.size(), file) != NULL && strncmp(line.data(), config, strlen(config)) == 0 &&
+               line[strlen(config)] == '\n' && fscanf(file, "%llu %llu", &accesses, &measured) == 2;
+    for(int i = 0; hit && i<slices; i++)
+        for(int j = 0; hit && j<SETS; j++)
+            hit = fscanf(file, "%llu %llu", &count[i][j], &miss_count[i][j]) == 2;
+    fclose(file);
+    if(!hit)
+    {
+        memset(count, 0, sizeof(unsigned long long)*slices*SETS);
+        memset(miss_count, 0, sizeof(unsigned long long)*slices*SETS);
+        accesses = measured = 0;
+    }
+    return hit;
+}
+
+void Store_result()
+{
+    char config[500], entry_filename[300];
+    Result_config(config);
+    Result_entry(config, entry_filename);
+    string text = string(config) + "\n";
+    char line[50];
+    sprintf(line, "%llu %llu\n", accesses, measured);
+    text += line;
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
+        {
+            sprintf(line, "%llu %llu\n", count[i][j], miss_count[i][j]);
+            text += line;
+        }
+    mkdir(store_dirname, 0755);
+    if(!Replace_file(entry_filename, text.data(), text.size()))
+        printf("cannot save the result to %s\n", entry_filename);
+}
+
+// Batch: the slices, sets and tags of a batch of BATCH accesses are calculated first (Hash_batch of cache_slice.h),
+// then the state of the set "-p [distance]" accesses ahead is prefetched, and half the distance ahead the node at
+// the head and the bucket of the tag, while the accesses are simulated in order (Simulate_batch). oracle.cpp checks it.
+void Run_batch()    // simulate the accesses of the batch in order, prefetching the state of the sets ahead
+{
+    Slice_access a[BATCH];
+    Profile(PHASE_HASH);
+    int len = Hash_batch(batch_addr, batch_n, batch_measure, batch_len, set_bits, block_bits, shards, shard, a);
+    Profile(PHASE_UPDATE);
+    Simulate_batch(Cache, a, len, prefetch_distance, count[0], miss_count[0], measured);
+    batch_len = 0;
+    Profile(PHASE_READ);
+}
+
+vector<unsigned long long> kept_addr, kept_n;
+vector<bool> kept_measure;
+
+void Access(unsigned long long addr, unsigned long long n)    // n accesses to the same line in a row
+{
+    if(accesses >= next_interval)    // passed over by a skipped segment
+        Close_intervals();
+    if(accesses + n > next_interval)    // a run is cut at the end of the interval
+    {
+        unsigned long long first = next_interval - accesses;
+        Access(addr, first);
+        Access(addr, n - first);
+        return;
+    }
+    accesses += n;
+    if(benchmark)
+    {
+        kept_addr.push_back(addr);
+        kept_n.push_back(n);
+        kept_measure.push_back(measure);
+        return;
+    }
+    batch_addr[batch_len] = addr;
+    batch_n[batch_len] = n;
+    batch_measure[batch_len] = measure;
+    batch_len++;
+    if(batch_len == BATCH)
+        Run_batch();
+    if(accesses == next_interval)
+        Close_intervals();
+}
+
+// with "-B", the interleaved accesses are kept in memory and simulated once for every prefetch distance of 0~64,
+// and the ns/access of every distance is printed
+void Benchmark()    // simulate the kept accesses with every prefetch distance
+{
+    int distances[] = {0, 1, 2, 4, 8, 16, 32, 64};
+    for(int k = 0; k<(int)(sizeof(distances)/sizeof(int)); k++)
+    {
+        for(int i = 0; i<slices; i++)
+        {
+            Cache[i].Free();
+            Cache[i].Init(SETS, ways);
+        }
+        memset(count, 0, sizeof(unsigned long long)*slices*SETS);
+        memset(miss_count, 0, sizeof(unsigned long long)*slices*SETS);
+        measured = 0;
+        prefetch_distance = distances[k];
+
+        timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for(size_t i = 0; i<kept_addr.size(); i++)
+        {
+            batch_addr[batch_len] = kept_addr[i];
+            batch_n[batch_len] = kept_n[i];
+            batch_measure[batch_len] = kept_measure[i];
+            batch_len++;
+            if(batch_len == BATCH)
+                Run_batch();
+        }
+        Run_batch();
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double ns = (t1.tv_sec - t0.tv_sec)*1e9 + (t1.tv_nsec - t0.tv_nsec);
+        printf("prefetch distance %2d: %.2f ns/access\n", distances[k], kept_addr.size() > 0? ns/kept_addr.size():0);
+    }
+}
+
+// the header of a .npy file (format version 1.0) of little-endian [descr] values, 128 bytes, so that it can be
+// rewritten in place; columns 0 for a 1-D array
+void Write_npy_header(FILE *file, const char *descr, unsigned long long rows, int columns)
+{
+    char header[128];
+    memset(header, ' ', sizeof(header));
+    memcpy(header, "\x93NUMPY\x01\x00\x76\x00", 10);    // 118 bytes of the dict
+    int len;
+    if(columns > 0)
+        len = sprintf(header+10, "{'descr': '%s', 'fortran_order': False, 'shape': (%llu, %d), }", descr, rows,
+                      columns);
+    else
+        len = sprintf(header+10, "{'descr': '%s', 'fortran_order': False, 'shape': (%llu,), }", descr, rows);
+    header[10+len] = ' ';
+    header[127] = '\n';
+    fwrite(header, 1, sizeof(header), file);
+}
+
+void Output()
+{
+    if(shards > 1)    // merged by shard_merge.cpp
+    {
+        fprintf(outfile1, "shard %d %d %d %d %llu\n", shard, shards, slices, SETS, accesses);
+        for(int i = 0; i<slices; i++)
+            for(int j = 0; j<SETS; j++)
+                if((i*SETS + j) % shards == shard)
+                    fprintf(outfile1, "%d %d %llu %llu\n", i, j, count[i][j], miss_count[i][j]);
+    }
+    else if(text)
     for(int i = 0; i<slices; i++)
         for(int j = 0; j<SETS; j++)
         {
             fprintf(outfile1, "%llu\n", count[i][j]);
             fprintf(outfile2, "%llu\n", miss_count[i][j]);
         }
+    else    // [slices][SETS]
+    {
+        Write_npy_header(outfile1, "<u8", slices, SETS);
+        Write_npy_header(outfile2, "<u8", slices, SETS);
+        fwrite(count, sizeof(unsigned long long), (size_t)slices*SETS, outfile1);
+        fwrite(miss_count, sizeof(unsigned long long), (size_t)slices*SETS, outfile2);
+    }
+    if(fast_forward > 0 || warm_up > 0 || detail > 0)
+        printf("%llu of %llu accesses are counted (%.2f%%)\n", measured, accesses,
+               accesses > 0? 100.0*measured/accesses:0);
+}
+
+int main(int argc, char *argv[])
+{
+    char *names[2];
+    int name_num = 0;
+    for(int i = 1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "-c") == 0 && i+1 < argc)
+            checkpoint = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-r") == 0 && i+1 < argc)
+            strcpy(resume_filename, argv[++i]);
+        else if(strcmp(argv[i], "-f") == 0 && i+1 < argc)
+            fast_forward = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-w") == 0 && i+1 < argc)
+            warm_up = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-d") == 0 && i+1 < argc)
+            detail = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-s") == 0 && i+1 < argc)
+            skip = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-p") == 0 && i+1 < argc)
+            prefetch_distance = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-B") == 0)
+            benchmark = true;
+        else if(strcmp(argv[i], "-P") == 0)
+            profiling = true;
+        else if(strcmp(argv[i], "-i") == 0 && i+1 < argc)
+            series_interval = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-I") == 0 && i+1 < argc)
+            strcpy(lengths_filename, argv[++i]);
+        else if(strcmp(argv[i], "-m") == 0 && i+1 < argc)
+            slices = Load_slice_map(argv[++i]);
+        else if(strcmp(argv[i], "-C") == 0 && i+1 < argc)
+            strcpy(store_dirname, argv[++i]);
+        else if(strcmp(argv[i], "-T") == 0)
+            text = true;
+        else if(strcmp(argv[i], "-L") == 0 && i+1 < argc)
+        {
+            i++;
+            sprintf(live_name, argv[i][0] == '/'? "%s":"/%s", argv[i]);    // a name of shm_open
+        }
+        else if(strcmp(argv[i], "-k") == 0 && i+1 < argc)
+            shards = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-j") == 0 && i+1 < argc)
+            shard = atoi(argv[++i]);
+        else if(name_num < 2)
+            names[name_num++] = argv[i];
+    }
+    if(name_num == 0)
+    {
+        printf("Usage: ./cal_set_slice [benchmark1] [benchmark2] (or [merged]) [-f accesses] [-w accesses]"
+               " [-d accesses] [-s accesses]\n       [-c accesses] [-r snapshot] [-p distance] [-B] [-P] [-i accesses]"
+               " [-I lengths] [-m slice_map]\n       [-k shards -j shard] [-C store] [-T] [-L live_page]\n");
+        exit(1);
+    }
+    if(shards < 1 || shard < 0 || shard >= shards)
+    {
+        printf("the shard must be 0~shards-1\n");
+        exit(1);
+    }
+    if(shards > 1 && live_name[0] != 0)    // the shards of a run are given the same -L
+        sprintf(live_name+strlen(live_name), "_shard_%d_of_%d", shard, shards);
+
+    if(name_num == 1)    // a merged trace
+    {
+        strcpy(benchname1, names[0]);
+        benchname2[0] = 0;
+        strcpy(outfilename1, benchname1);
+        strcat(outfilename1, "_access");
+        strcpy(outfilename2, benchname1);
+        strcat(outfilename2, "_miss");
+    }
+    else
+    {
+        printf("please input ratio: ");
+        scanf("%d", &ratio);
+        strcpy(benchname1, names[0]);
+        strcpy(benchname2, names[1]);
+        strcpy(outfilename1, benchname1);
+        strcat(outfilename1, "_");
+        strcat(outfilename1, benchname2);
+        strcat(outfilename1, "_access");
+        strcpy(outfilename2, benchname1);
+        strcat(outfilename2, "_");
+        strcat(outfilename2, benchname2);
+        strcat(outfilename2, "_miss");
+    }
+
+    char basename[100];    // [benchmark1]_[benchmark2] or [merged], and _shard_[shard]_of_[shards] for a shard
+    strcpy(basename, outfilename1);
+    basename[strlen(basename)-strlen("_access")] = 0;
+    if(shards > 1)
+    {
+        sprintf(basename+strlen(basename), "_shard_%d_of_%d", shard, shards);
+        strcpy(outfilename1, basename);
+    }
+    sprintf(snapshot_filename, "%s.ckpt", basename);
+    sprintf(series_filename, "%s_series", basename);
+    if(!text && shards == 1)
+    {
+        strcat(outfilename1, ".npy");
+        strcat(outfilename2, ".npy");
+    }
+    if((series_interval > 0 || lengths_filename[0] != 0) && (resume_filename[0] != 0 || benchmark))
+    {
+        printf("the series starts from the first access, it cannot go with -r or -B\n");
+        exit(1);
+    }
+
+    Start();
+    bool stored = store_dirname[0] != 0 && resume_filename[0] == 0 && !benchmark && shards == 1 &&
+                  series_interval == 0 && lengths_filename[0] == 0;    // the outputs are the counters only
+    if(stored && Lookup_result())
+    {
+        printf("the result is found in %s\n", store_dirname);
+        Output();
+        Finish();
+        return 0;
+    }
+    if(series_interval > 0 || lengths_filename[0] != 0)
+        Start_series();
+    if(profiling)
+        profiler.Start(PHASE_READ);
+    if(resume_filename[0] != 0)
+        Load_snapshot();
+    next_checkpoint = accesses + checkpoint;
+    if(live_name[0] != 0)
+        Open_live(basename);
+    Next_segment();
+
+    unsigned long long n1, n2;
+    if(benchname2[0] == 0)
+    {
+        while(reader1.Next(addr1, n1, ~0ULL))
+        {
+            Access(addr1, n1);
+            Checkpoint();
+            Publish_live();
+            Next_segment();
+        }
+    }
+    else
+    while(reader1.Next(addr1, n1, 1) && reader2.Next(addr2, n2, 1))   // end with either file finished
+    {
+        addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
+        Access(addr1, 1);
+
+        int counter = ratio - 1;
+        while(counter > 0)
+        {
+            if(reader1.Next(addr1, n1, counter))    // a run is cut at the end of the turn of benchmark1
+            {
+                addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
+                Access(addr1, n1);
+                counter -= n1;
+            }
+            else
+                break;
+        }
+
+        Access(addr2, 1);
+        Checkpoint();
+        Publish_live();
+        Next_segment();
+    }
+
+    if(benchmark)
+        Benchmark();
+    Run_batch();
+    if(series_file != NULL)
+        Finish_series();
+    if(live != NULL)
+        Close_live();
+
+    Profile(PHASE_OUTPUT);
+    Output();
+    if(stored)
+        Store_result();
+    if(profiling)
+    {
+        fflush(outfile1);    // the output is written here, not at fclose
+        if(outfile2 != NULL)
+            fflush(outfile2);
+        profiler.Stop();
+        Print_profile(profiler.stat, accesses);
+    }
     
     Finish();
     
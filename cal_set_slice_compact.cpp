@@ -0,0 +1,211 @@
+/*
+ * This program simulates a LRU-based last level cache with several slices in a compact state, based on cal_set_slice.cpp.
+ * Instead of a linked list of 32-byte nodes and two unordered_maps for every set, a set is one Compact_set of 64 bytes
+ * (compact_set.h, which oracle.cpp checks):
+ *   tag:    the tags of the ways, TAG_BITS (32 by default) bits each, with the set bits, the block bits and
+ *           the benchmark marker removed;
+ *   owner:  the benchmark of every way, i.e. the marker (address >> 53);
+ *   order:  the recency as a permutation of the ways, 4 bits for every position, position 0 is the MRU
+ *           and position ways-1 is the LRU.
+ * So the whole LLC of 8 slices * 2048 sets takes 1MB and stays in L2, and the counters are the same as cal_set_slice.cpp.
+ * A trace whose tag does not fit in TAG_BITS bits is rejected, widen Tag and TAG_BITS for it.
+ * Precondition: same as cal_set.cpp.
+ * Usage: g++ -std=c++11 -O2 cal_set_slice_compact.cpp -o cal_set_slice_compact
+ *        ./cal_set_slice_compact [benchmark1] [benchmark2]
+ *        ./cal_set_slice_compact [merged]    (a trace merged by merge.cpp)
+ * Input: follow the hints
+ * Output: the accesses and misses of all the sets, saved as text as cal_set_slice.cpp -T does,
+ *         [benchmark1]_[benchmark2]_access and [benchmark1]_[benchmark2]_miss ([merged]_access and [merged]_miss)
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include "compact_set.h"
+#include "slice_map.h"
+using namespace std;
+
+char benchname1[20], benchname2[20];
+char outfilename1[100], outfilename2[100];
+FILE *outfile1, *outfile2;
+int slices = 8, set_bits = 11, block_bits = 6;
+unsigned long long addr1, addr2;
+int ratio;    // benchmark1:benchmark2
+#define SETS 2048    // 2^set_bits
+#define WAYS 11      // ways, at most 15 so that the order fits in 64 bits
+typedef unsigned int Tag;
+#define TAG_BITS 32  // at most 8*sizeof(Tag)
+unsigned long long (*count)[SETS], (*miss_count)[SETS];
+
+static_assert(TAG_BITS <= 8*sizeof(Tag), "the tag does not fit in Tag");
+
+Compact_set<Tag, WAYS> (*Cache)[SETS];
+
+class Trace_reader    // [benchmark].out, or [benchmark].rle collapsed by collapse.cpp when the .out is absent
+{
+public:
+    FILE *file;
+    bool rle;
+    unsigned long long addr, left;    // the current run of the same line
+
+    bool Open(const char *benchname);
+    bool Next(unsigned long long &a, unsigned long long &n, unsigned long long max);
+};
+
+bool Trace_reader::Open(const char *benchname)
+{
+    char filename[200];
+    sprintf(filename, "%s.out", benchname);
+    rle = false;
+    left = 0;
+    file = fopen(filename, "r");
+    if(file == NULL)
+    {
+        sprintf(filename, "%s.rle", benchname);
+        file = fopen(filename, "r");
+        rle = true;
+    }
+    return file != NULL;
+}
+
+// the next n (1~max) accesses, which are all to the line of address a
+bool Trace_reader::Next(unsigned long long &a, unsigned long long &n, unsigned long long max)
+{
+    if(left == 0)
+    {
+        char tmp[100], *p;
+        if(fgets(tmp, 99, file) == NULL)
+            return false;
+        addr = strtoull(tmp, &p, 10);
+        left = rle? strtoull(p, NULL, 10):1;
+        if(left == 0)
+            left = 1;
+    }
+    a = addr;
+    n = left < max? left:max;
+    left -= n;
+    return true;
+}
+
+Trace_reader reader1, reader2;
+
+void Start()
+{
+    bool open1 = reader1.Open(benchname1);
+    bool open2 = benchname2[0] != 0? reader2.Open(benchname2):true;
+    outfile1 = fopen(outfilename1, "w");
+    outfile2 = fopen(outfilename2, "w");
+    if(!open1 || !open2 || outfile1 == NULL || outfile2 == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+
+    Cache = new Compact_set<Tag, WAYS>[slices][SETS];
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
+            Init_set(Cache[i][j]);
+    count = new unsigned long long[slices][SETS]();
+    miss_count = new unsigned long long[slices][SETS]();
+
+    return;
+}
+
+void Finish()
+{
+    delete []Cache;
+    delete []count;
+    delete []miss_count;
+
+    fclose(reader1.file);
+    if(benchname2[0] != 0)
+        fclose(reader2.file);
+    fclose(outfile1);
+    fclose(outfile2);
+
+    return;
+}
+
+void Access(unsigned long long addr, unsigned long long n)    // n accesses to the same line in a row
+{
+    Tag tag;
+    unsigned char owner;
+    Split_tag(addr, set_bits+block_bits, TAG_BITS, tag, owner);
+    unsigned long long set_no = (addr >> block_bits) & 0B11111111111;    // set_bits
+    int slice = Cal_slice(addr);
+
+    count[slice][set_no] += n;    // all but the first one are hits on the MRU line
+    if(!Compact_access(Cache[slice][set_no], tag, owner))
+        miss_count[slice][set_no]++;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc == 2)    // a merged trace
+    {
+        strcpy(benchname1, argv[1]);
+        benchname2[0] = 0;
+        strcpy(outfilename1, benchname1);
+        strcat(outfilename1, "_access");
+        strcpy(outfilename2, benchname1);
+        strcat(outfilename2, "_miss");
+    }
+    else
+    {
+        printf("please input ratio: ");
+        scanf("%d", &ratio);
+        strcpy(benchname1, argv[1]);
+        strcpy(benchname2, argv[2]);
+        strcpy(outfilename1, benchname1);
+        strcat(outfilename1, "_");
+        strcat(outfilename1, benchname2);
+        strcat(outfilename1, "_access");
+        strcpy(outfilename2, benchname1);
+        strcat(outfilename2, "_");
+        strcat(outfilename2, benchname2);
+        strcat(outfilename2, "_miss");
+    }
+
+    Start();
+
+    unsigned long long n1, n2;
+    if(benchname2[0] == 0)
+    {
+        while(reader1.Next(addr1, n1, ~0ULL))
+            Access(addr1, n1);
+    }
+    else
+    while(reader1.Next(addr1, n1, 1) && reader2.Next(addr2, n2, 1))   // end with either file finished
+    {
+        addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
+        Access(addr1, 1);
+
+        int counter = ratio - 1;
+        while(counter > 0)
+        {
+            if(reader1.Next(addr1, n1, counter))    // a run is cut at the end of the turn of benchmark1
+            {
+                addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
+                Access(addr1, n1);
+                counter -= n1;
+            }
+            else
+                break;
+        }
+
+        Access(addr2, 1);
+    }
+
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
+        {
+            fprintf(outfile1, "%llu\n", count[i][j]);
+            fprintf(outfile2, "%llu\n", miss_count[i][j]);
+        }
+    printf("the state of the cache takes %.2fMB, %d bytes for every set\n",
+           (double)slices*SETS*sizeof(Compact_set<Tag, WAYS>)/(1<<20), (int)sizeof(Compact_set<Tag, WAYS>));
+
+    Finish();
+
+    return 0;
+}
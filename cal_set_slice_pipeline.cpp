@@ -0,0 +1,481 @@
+/*
+ * This program simulates a LRU-based last level cache with several slices as a pipeline, based on cal_set_slice.cpp.
+ * The stages run on their own threads, connected by lock-free single-producer single-consumer rings of batches:
+ *   parse:  reads and parses the traces, interleaves them with the ratio as cal_set_slice.cpp does;
+ *   hash:   calculates the slice, set and tag of every access and routes it to the ring of its slice;
+ *   slice:  one worker for every slice, owns the Cache_slice of the slice and its counters.
+ * Every slice sees its accesses in the trace order, so the counters are the same as cal_set_slice.cpp.
+ * The head and the tail of a ring are on separate cache lines, and the items move in batches of BATCH.
+ * At the end, the throughput of every stage and the time it waited for its neighbours are printed:
+ * the stage that hardly waits is the bottleneck.
+ * Profile: with "-P", every thread counts the time and, where perf_event_open is permitted, the cycles, instructions,
+ * LLC misses and dTLB misses of its stage (read/parse, hash, lookup/update, output) apart from the time it waits
+ * on a ring, and the counts of all the threads are summed into one breakdown printed at the end (see profiler.h).
+ * Memory: all the state of a slice (the sets of its Cache_slice of cache_slice.h, the nodes, the unordered_maps, the
+ * counters and the ring it consumes) comes from an Arena of its own (arena.h), mapped in chunks of 4MB backed by
+ * explicit huge pages (MAP_HUGETLB) when some are reserved, or else by transparent huge pages (MADV_HUGEPAGE), or else
+ * by normal pages. The freed blocks of the unordered_maps are kept in free lists of their sizes, so the arena does not
+ * grow with the misses. On a machine of several NUMA nodes (from /sys/devices/system/node), the worker of slice i is pinned
+ * to a cpu of node i % nodes, and the arena of the slice is bound to that node (preferred, by mbind).
+ * Precondition: same as cal_set_slice.cpp.
+ * Usage: g++ -std=c++11 -O2 -pthread cal_set_slice_pipeline.cpp -o cal_set_slice_pipeline
+ *        ./cal_set_slice_pipeline [benchmark1] [benchmark2]
+ *        ./cal_set_slice_pipeline [merged]    (a trace merged by merge.cpp)
+ *        with the options [-P] [-m slice_map] after the benchmarks
+ * Slices: the 8 slices of Cal_slice by default, or the slice map of a file given by "-m", as cal_set_slice.cpp.
+ * Input: follow the hints
+ * Output: the accesses and misses of all the sets, saved as text as cal_set_slice.cpp -T does,
+ *         [benchmark1]_[benchmark2]_access and [benchmark1]_[benchmark2]_miss ([merged]_access and [merged]_miss)
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <ctime>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <mutex>
+#include "profiler.h"
+#include "arena.h"
+#include "cache_slice.h"
+using namespace std;
+
+char benchname1[20], benchname2[20];
+char filename1[30], filename2[30], outfilename1[100], outfilename2[100];
+FILE *file1, *file2, *outfile1, *outfile2;
+int slices = 8, set_bits = 11, block_bits = 6, ways = 11;
+int ratio;    // benchmark1:benchmark2
+#define SETS 2048    // 2^set_bits
+#define BATCH 1024   // items of a batch
+#define RING 64      // batches of a ring, power of 2
+#define MAX_SLICES 64
+
+vector<vector<int> > numa_cpus;    // the cpus of every NUMA node
+
+void Read_numa()
+{
+    for(int node = 0; ; node++)
+    {
+        char filename[100], list[4096];
+        sprintf(filename, "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *file = fopen(filename, "r");
+        if(file == NULL)
+            break;
+        vector<int> cpus;
+        if(fgets(list, sizeof(list), file) != NULL)
+        {
+            char *p = list;
+            while(*p >= '0' && *p <= '9')    // e.g. "0-7,16-23"
+            {
+                int first = strtol(p, &p, 10), last = first;
+                if(*p == '-')
+                    last = strtol(p+1, &p, 10);
+                for(int c = first; c<=last; c++)
+                    cpus.push_back(c);
+                if(*p == ',')
+                    p++;
+            }
+        }
+        fclose(file);
+        if(!cpus.empty())
+            numa_cpus.push_back(cpus);
+    }
+}
+
+int Slice_node(int slice)    // -1 when there is only one node
+{
+    return numa_cpus.size() > 1? slice % numa_cpus.size():-1;
+}
+
+void Pin(int slice)    // pin the calling thread to a cpu of the node of the slice
+{
+    int node = Slice_node(slice);
+    if(node < 0)
+        return;
+    vector<int> &cpus = numa_cpus[node];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[(slice / numa_cpus.size()) % cpus.size()], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+Arena arena[MAX_SLICES];
+bool profiling = false;    // "-P"
+
+thread_local Profiler profiler;    // every stage counts its own thread
+Phase_stat profile_total[PHASES];
+mutex profile_lock;
+
+inline void Profile(int phase)    // only a branch when not profiling
+{
+    if(profiling)
+        profiler.Switch(phase);
+}
+
+void Profile_begin(int phase)
+{
+    if(profiling)
+        profiler.Start(phase);
+}
+
+void Profile_end()    // add the phases of the thread to the total
+{
+    if(!profiling)
+        return;
+    profiler.Stop();
+    lock_guard<mutex> guard(profile_lock);
+    Add_profile(profile_total, profiler.stat);
+}
+
+double Now()    // seconds
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+struct Stage_stat
+{
+    unsigned long long items;
+    double busy, wait;    // seconds
+};
+
+struct Batch
+{
+    int len;    // 0 marks the end of the stream
+    unsigned long long item[BATCH];
+};
+
+class Ring    // lock-free single-producer single-consumer ring of batches
+{
+public:
+    char pad0[64];
+    atomic<unsigned long long> head;    // the next batch to consume, written by the consumer
+    char pad1[64];
+    atomic<unsigned long long> tail;    // the next batch to produce, written by the producer
+    char pad2[64];
+    Batch slot[RING];
+
+    Ring()
+    {
+        head.store(0);
+        tail.store(0);
+    }
+    Batch *Produce_begin(Stage_stat &stat)
+    {
+        unsigned long long t = tail.load(memory_order_relaxed);
+        if(t - head.load(memory_order_acquire) >= RING)    // full, wait for the consumer
+        {
+            double start = Now();
+            int phase = profiler.current;
+            Profile(PHASE_WAIT);
+            while(t - head.load(memory_order_acquire) >= RING)
+                this_thread::yield();
+            Profile(phase);
+            stat.wait += (Now() - start);
+        }
+        return &slot[t & (RING-1)];
+    }
+    void Produce_end()
+    {
+        tail.store(tail.load(memory_order_relaxed)+1, memory_order_release);
+    }
+    Batch *Consume_begin(Stage_stat &stat)
+    {
+        unsigned long long h = head.load(memory_order_relaxed);
+        if(tail.load(memory_order_acquire) == h)    // empty, wait for the producer
+        {
+            double start = Now();
+            int phase = profiler.current;
+            Profile(PHASE_WAIT);
+            while(tail.load(memory_order_acquire) == h)
+                this_thread::yield();
+            Profile(phase);
+            stat.wait += (Now() - start);
+        }
+        return &slot[h & (RING-1)];
+    }
+    void Consume_end()
+    {
+        head.store(head.load(memory_order_relaxed)+1, memory_order_release);
+    }
+};
+
+Ring *parsed;                  // parse -> hash, addresses
+Ring *routed[MAX_SLICES];      // hash -> slice, (tag << set_bits) | set_no
+Stage_stat parse_stat, hash_stat, slice_stat[MAX_SLICES];
+unsigned long long (*count)[SETS], (*miss_count)[SETS];
+
+Batch *parse_batch;
+
+void Emit(unsigned long long addr)    // append an access to the batch of the parse stage
+{
+    parse_batch->item[parse_batch->len++] = addr;
+    parse_stat.items++;
+    if(parse_batch->len == BATCH)
+    {
+        parsed->Produce_end();
+        parse_batch = parsed->Produce_begin(parse_stat);
+        parse_batch->len = 0;
+    }
+}
+
+void Parse_stage()
+{
+    double start = Now();
+    Profile_begin(PHASE_READ);
+    parse_batch = parsed->Produce_begin(parse_stat);
+    parse_batch->len = 0;
+
+    char tmp1[100], tmp2[100];
+    if(benchname2[0] == 0)
+    {
+        while(fgets(tmp1, 99, file1) != NULL)
+            Emit(strtoull(tmp1, NULL, 10));
+    }
+    else
+    while(fgets(tmp1, 99, file1) != NULL && fgets(tmp2, 99, file2) != NULL)   // end with either file finished
+    {
+        Emit(strtoull(tmp1, NULL, 10) + ((unsigned long long)1<<53));  // distinguish different benchmark
+        int counter = ::ratio - 1;    // std::ratio comes with <thread>
+        while(counter--)
+        {
+            if(fgets(tmp1, 99, file1) != NULL)
+                Emit(strtoull(tmp1, NULL, 10) + ((unsigned long long)1<<53));
+            else
+                break;
+        }
+        Emit(strtoull(tmp2, NULL, 10));
+    }
+
+    if(parse_batch->len > 0)
+    {
+        parsed->Produce_end();
+        parse_batch = parsed->Produce_begin(parse_stat);
+    }
+    parse_batch->len = 0;    // the end
+    parsed->Produce_end();
+    Profile_end();
+    parse_stat.busy = (Now() - start) - parse_stat.wait;
+}
+
+void Hash_stage()
+{
+    double start = Now();
+    Profile_begin(PHASE_HASH);
+    Batch *out[MAX_SLICES];
+    for(int i = 0; i<slices; i++)
+    {
+        out[i] = routed[i]->Produce_begin(hash_stat);
+        out[i]->len = 0;
+    }
+    while(true)
+    {
+        Batch *in = parsed->Consume_begin(hash_stat);
+        if(in->len == 0)
+            break;
+        for(int k = 0; k<in->len; k++)
+        {
+            unsigned long long addr = in->item[k];
+            unsigned long long tag = addr >> (set_bits+block_bits);
+            unsigned long long set_no = (addr >> block_bits) & 0B11111111111;    // set_bits
+            int slice = Map_slice(addr);
+            Batch *b = out[slice];
+            b->item[b->len++] = (tag << set_bits) | set_no;
+            if(b->len == BATCH)
+            {
+                routed[slice]->Produce_end();
+                out[slice] = routed[slice]->Produce_begin(hash_stat);
+                out[slice]->len = 0;
+            }
+        }
+        hash_stat.items += in->len;
+        parsed->Consume_end();
+    }
+    for(int i = 0; i<slices; i++)
+    {
+        if(out[i]->len > 0)
+        {
+            routed[i]->Produce_end();
+            out[i] = routed[i]->Produce_begin(hash_stat);
+        }
+        out[i]->len = 0;    // the end
+        routed[i]->Produce_end();
+    }
+    Profile_end();
+    hash_stat.busy = (Now() - start) - hash_stat.wait;
+}
+
+void Slice_stage(int slice)
+{
+    double start = Now();
+    Pin(slice);
+    Profile_begin(PHASE_UPDATE);
+    current_arena = &arena[slice];
+    Cache_slice<Arena_allocator> cache;    // its sets are allocated by the worker itself
+    cache.Init(SETS, ways);
+    unsigned long long *access = (unsigned long long *)current_arena->Alloc(SETS*sizeof(unsigned long long));
+    unsigned long long *miss = (unsigned long long *)current_arena->Alloc(SETS*sizeof(unsigned long long));
+    memset(access, 0, SETS*sizeof(unsigned long long));
+    memset(miss, 0, SETS*sizeof(unsigned long long));
+    while(true)
+    {
+        Batch *in = routed[slice]->Consume_begin(slice_stat[slice]);
+        if(in->len == 0)
+            break;
+        for(int k = 0; k<in->len; k++)
+        {
+            unsigned long long set_no = in->item[k] & (SETS-1);
+            unsigned long long tag = in->item[k] >> set_bits;
+
+            access[set_no]++;
+            if(!cache.Access(set_no, tag))
+                miss[set_no]++;
+        }
+        slice_stat[slice].items += in->len;
+        routed[slice]->Consume_end();
+    }
+    memcpy(count[slice], access, SETS*sizeof(unsigned long long));
+    memcpy(miss_count[slice], miss, SETS*sizeof(unsigned long long));
+    arena[slice].Release();    // with the cache, its nodes and the ring
+    Profile_end();
+    slice_stat[slice].busy = (Now() - start) - slice_stat[slice].wait;
+}
+
+void Start()
+{
+    file1 = fopen(filename1, "r");
+    file2 = benchname2[0] != 0? fopen(filename2, "r"):file1;
+    outfile1 = fopen(outfilename1, "w");
+    outfile2 = fopen(outfilename2, "w");
+    if(file1 == NULL || file2 == NULL || outfile1 == NULL || outfile2 == NULL || slices > MAX_SLICES)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    setvbuf(file1, NULL, _IOFBF, 1<<20);
+    if(file2 != file1)
+        setvbuf(file2, NULL, _IOFBF, 1<<20);
+
+    Read_numa();
+    parsed = new Ring;
+    for(int i = 0; i<slices; i++)
+    {
+        arena[i].Init(Slice_node(i));
+        routed[i] = new (arena[i].Alloc(sizeof(Ring))) Ring;    // on the node of its consumer
+    }
+    count = new unsigned long long[slices][SETS]();
+    miss_count = new unsigned long long[slices][SETS]();
+
+    return;
+}
+
+void Finish()
+{
+    delete parsed;
+    delete []count;
+    delete []miss_count;
+
+    fclose(file1);
+    if(file2 != file1)
+        fclose(file2);
+    fclose(outfile1);
+    fclose(outfile2);
+
+    return;
+}
+
+void Print_stat(const char *name, const Stage_stat &stat, double seconds)
+{
+    printf("%-10s %12llu items, %8.2f M items/s busy, waited %5.1f%%\n", name, stat.items,
+           stat.busy > 0? stat.items/stat.busy/1e6:0, seconds > 0? 100*stat.wait/seconds:0);
+}
+
+int main(int argc, char *argv[])
+{
+    char *names[2];
+    int name_num = 0;
+    for(int i = 1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "-P") == 0)
+            profiling = true;
+        else if(strcmp(argv[i], "-m") == 0 && i+1 < argc)
+            slices = Load_slice_map(argv[++i]);
+        else if(name_num < 2)
+            names[name_num++] = argv[i];
+    }
+    if(name_num == 0)
+    {
+        printf("Usage: ./cal_set_slice_pipeline [benchmark1] [benchmark2] (or [merged]) [-P] [-m slice_map]\n");
+        exit(1);
+    }
+
+    if(name_num == 1)    // a merged trace
+    {
+        strcpy(benchname1, names[0]);
+        benchname2[0] = 0;
+        sprintf(filename1, "%s.out", benchname1);
+        sprintf(outfilename1, "%s_access", benchname1);
+        sprintf(outfilename2, "%s_miss", benchname1);
+    }
+    else
+    {
+        printf("please input ratio: ");
+        scanf("%d", &::ratio);
+        strcpy(benchname1, names[0]);
+        strcpy(benchname2, names[1]);
+        sprintf(filename1, "%s.out", benchname1);
+        sprintf(filename2, "%s.out", benchname2);
+        sprintf(outfilename1, "%s_%s_access", benchname1, benchname2);
+        sprintf(outfilename2, "%s_%s_miss", benchname1, benchname2);
+    }
+
+    Start();
+
+    double start = Now();
+    vector<thread> threads;
+    threads.push_back(thread(Parse_stage));
+    threads.push_back(thread(Hash_stage));
+    for(int i = 0; i<slices; i++)
+        threads.push_back(thread(Slice_stage, i));
+    for(unsigned long long i = 0; i<threads.size(); i++)
+        threads[i].join();
+    double seconds = (Now() - start);
+
+    // counters of the slices are merged here
+    Profile_begin(PHASE_OUTPUT);
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
+        {
+            fprintf(outfile1, "%llu\n", count[i][j]);
+            fprintf(outfile2, "%llu\n", miss_count[i][j]);
+        }
+    fflush(outfile1);
+    fflush(outfile2);
+    Profile_end();
+
+    printf("%llu accesses in %.3fs, %.2f M accesses/s\n", parse_stat.items, seconds, parse_stat.items/seconds/1e6);
+    int huge = 2;    // of all the arenas, each written only by its worker, read after the join
+    for(int i = 0; i<slices; i++)
+        huge = arena[i].huge < huge? arena[i].huge:huge;
+    printf("%d NUMA nodes, the arenas on %s\n", (int)numa_cpus.size(),
+           huge == 2? "explicit huge pages":huge == 1? "transparent huge pages, at least partly":"normal pages, at least partly");
+    Print_stat("parse", parse_stat, seconds);
+    Print_stat("hash", hash_stat, seconds);
+    for(int i = 0; i<slices; i++)
+    {
+        char name[20];
+        sprintf(name, "slice %d", i);
+        Print_stat(name, slice_stat[i], seconds);
+    }
+    if(profiling)
+        Print_profile(profile_total, parse_stat.items);
+
+    Finish();
+
+    return 0;
+}
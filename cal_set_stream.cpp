@@ -0,0 +1,344 @@
+/*
+ * This program simulates a LRU-based last level cache with several slices on live traces, based on
+ * cal_set_slice_compact.cpp (the Compact_set of compact_set.h), e.g. piped from a Pin or DynamoRIO tool, without writing them to the disk first.
+ * Every stream is stdin ("-"), a named pipe or a file, of text (an address every line) or binary (64-bit
+ * little-endian addresses, as [benchmark].bin of index.cpp). The pipes are read without blocking and multiplexed
+ * by epoll: while waiting for a slow stream, the others are read ahead into their buffers, and a stream whose buffer
+ * is full is not read until there is room again, so its producer blocks and the memory is bounded by BUFFER
+ * for every stream (and the 1MB of the cache). A malformed text line (non-digit characters, larger than 2^64-1, or
+ * longer than BUFFER) is reported with its stream and line number, and the run stops.
+ * The streams are interleaved in turns as cal_set_slice.cpp does: every turn takes weight_i accesses of stream i
+ * in order, it begins only when every stream has an access, and the run ends with any stream finished.
+ * Stream i (0~N-1) is marked by adding (N-1-i)<<53 to its addresses as merge.cpp does, so for two streams with the
+ * weights "ratio,1" the outputs are the same as "./cal_set_slice [benchmark1] [benchmark2]" with the ratio.
+ * The outputs are rewritten every [seconds] (to temporary files which then replace them), so a long run can be
+ * observed while it goes on.
+ * The parameters are given by options instead of the hints, because stdin may be a stream.
+ * Usage: g++ -std=c++11 -O2 cal_set_stream.cpp -o cal_set_stream
+ *        ./cal_set_stream [output] [-b] [-w weight1,weight2,...] [-f seconds] [stream1] ... [streamN]
+ *        -b: binary streams, text by default; -w: 1 for every stream by default; -f: only at the end by default
+ *        e.g. mkfifo p1 p2; ./cal_set_stream a_b -w 3,1 -f 10 p1 p2
+ * Output: the accesses and misses of all the sets, saved as text as cal_set_slice.cpp -T does,
+ *         [output]_access and [output]_miss
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "compact_set.h"
+#include "slice_map.h"
+using namespace std;
+
+char outfilename1[300], outfilename2[300];
+int slices = 8, set_bits = 11, block_bits = 6;
+#define SETS 2048    // 2^set_bits
+#define WAYS 11      // ways, at most 15 so that the order fits in 64 bits
+typedef unsigned int Tag;
+#define TAG_BITS 32  // at most 8*sizeof(Tag)
+#define MAX_STREAMS 64
+#define BUFFER (1<<20)    // bytes buffered for every stream
+unsigned long long (*count)[SETS], (*miss_count)[SETS];
+unsigned long long accesses = 0;
+bool binary = false;
+int flush_seconds = 0;
+
+static_assert(TAG_BITS <= 8*sizeof(Tag), "the tag does not fit in Tag");
+
+Compact_set<Tag, WAYS> (*Cache)[SETS];
+
+class Stream
+{
+public:
+    int fd;
+    bool pollable;    // a pipe or a terminal, a regular file can not be polled and is read directly
+    bool armed;       // in the epoll set
+    bool eof;
+    char *buf;
+    int begin, end;   // the unread bytes are buf[begin~end-1]
+    unsigned long long marker, line_no;
+    int weight;
+
+    void Open(const char *name, int i, int n);
+    bool Parse(unsigned long long &addr);    // false when a whole record is not buffered yet
+    void Fill();
+};
+
+int epoll_fd;
+vector<Stream> streams;
+
+void Stream::Open(const char *name, int i, int n)
+{
+    fd = strcmp(name, "-") == 0? 0:open(name, O_RDONLY);    // a named pipe blocks here until its writer opens it
+    if(fd < 0)
+    {
+        printf("cannot open %s\n", name);
+        exit(1);
+    }
+    buf = new char[BUFFER];
+    begin = end = 0;
+    eof = false;
+    line_no = 0;
+    marker = (unsigned long long)(n-1-i) << 53;
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = i;
+    pollable = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+    armed = pollable;
+    if(pollable)
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+void Stream::Fill()    // read as much as there is room for, without blocking for a pipe
+{
+    if(begin > 0 && (begin == end || begin >= BUFFER/2 || end == BUFFER))    // a full buffer always makes room
+    {
+        memmove(buf, buf+begin, end-begin);
+        end -= begin;
+        begin = 0;
+    }
+    while(end < BUFFER && !eof)
+    {
+        ssize_t len = read(fd, buf+end, BUFFER-end);
+        if(len > 0)
+        {
+            end += len;
+            if(!pollable)
+                break;
+        }
+        else if(len == 0)
+            eof = true;
+        else if(errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+        else if(errno != EINTR)
+        {
+            printf("cannot read stream %d\n", (int)(this - streams.data()));
+            exit(1);
+        }
+    }
+    bool want = pollable && !eof && end < BUFFER;    // a full buffer is not polled, so the producer waits
+    if(want != armed)
+    {
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = (unsigned)(this - streams.data());
+        epoll_ctl(epoll_fd, want? EPOLL_CTL_ADD:EPOLL_CTL_DEL, fd, &ev);
+        armed = want;
+    }
+}
+
+bool Stream::Parse(unsigned long long &addr)
+{
+    if(binary)
+    {
+        if(end - begin < (int)sizeof(unsigned long long))
+            return false;
+        memcpy(&addr, buf+begin, sizeof(unsigned long long));
+        begin += sizeof(unsigned long long);
+        return true;
+    }
+    while(true)
+    {
+        char *nl = (char *)memchr(buf+begin, '\n', end-begin);
+        if(nl == NULL && begin == 0 && end == BUFFER)    // no room to read the rest of the line
+        {
+            printf("stream %d: line %llu is longer than %d bytes\n", (int)(this - streams.data()), line_no+1, BUFFER);
+            exit(1);
+        }
+        if(nl == NULL && !(eof && end > begin))
+            return false;
+        char *line_end = nl == NULL? buf+end:nl;
+        char *p = buf+begin;
+        begin = nl == NULL? end:nl-buf+1;
+        line_no++;
+        while(p < line_end && (*p == ' ' || *p == '\r'))
+            p++;
+        if(p == line_end)    // an empty line
+            continue;
+        char *digits = p;
+        bool overflow = false;
+        addr = 0;
+        for(; p < line_end && *p >= '0' && *p <= '9'; p++)
+        {
+            overflow = overflow || addr > (~0ULL - (*p - '0'))/10;
+            addr = addr*10 + (*p - '0');
+        }
+        char *q = p;
+        while(q < line_end && (*q == ' ' || *q == '\r'))
+            q++;
+        if(p == digits || q != line_end || overflow)    // as parse.cpp, a malformed line is reported, not read as 0
+        {
+            printf("stream %d: line %llu is malformed: \"%.*s\"\n", (int)(this - streams.data()), line_no,
+                   (int)(line_end-digits < 40? line_end-digits:40), digits);
+            exit(1);
+        }
+        return true;
+    }
+}
+
+// the next address of stream i, waiting for it while reading ahead the others; false when the stream ended
+bool Next(int i, unsigned long long &addr)
+{
+    Stream &s = streams[i];
+    while(!s.Parse(addr))
+    {
+        if(s.eof)
+            return false;
+        if(!s.pollable || !s.armed)    // a file, or a pipe not polled since its buffer was full
+        {
+            s.Fill();
+            continue;
+        }
+        epoll_event events[MAX_STREAMS];
+        int n = epoll_wait(epoll_fd, events, MAX_STREAMS, -1);
+        if(n < 0 && errno != EINTR)
+        {
+            printf("epoll_wait failed\n");
+            exit(1);
+        }
+        for(int k = 0; k<n; k++)
+            streams[events[k].data.u32].Fill();
+    }
+    addr += s.marker;
+    return true;
+}
+
+void Access(unsigned long long addr)
+{
+    Tag tag;
+    unsigned char owner;
+    Split_tag(addr, set_bits+block_bits, TAG_BITS, tag, owner);
+    unsigned long long set_no = (addr >> block_bits) & 0B11111111111;    // set_bits
+    int slice = Cal_slice(addr);
+
+    count[slice][set_no]++;
+    accesses++;
+    if(!Compact_access(Cache[slice][set_no], tag, owner))
+        miss_count[slice][set_no]++;
+}
+
+void Flush()    // rewrite the outputs
+{
+    char tmp1[320], tmp2[320];
+    sprintf(tmp1, "%s.tmp", outfilename1);
+    sprintf(tmp2, "%s.tmp", outfilename2);
+    FILE *outfile1 = fopen(tmp1, "w");
+    FILE *outfile2 = fopen(tmp2, "w");
+    if(outfile1 == NULL || outfile2 == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
+        {
+            fprintf(outfile1, "%llu\n", count[i][j]);
+            fprintf(outfile2, "%llu\n", miss_count[i][j]);
+        }
+    fclose(outfile1);
+    fclose(outfile2);
+    rename(tmp1, outfilename1);
+    rename(tmp2, outfilename2);
+}
+
+int main(int argc, char *argv[])
+{
+    vector<char *> names;
+    char *weights = NULL;
+    for(int i = 2; i<argc; i++)
+    {
+        if(strcmp(argv[i], "-b") == 0)
+            binary = true;
+        else if(strcmp(argv[i], "-w") == 0 && i+1 < argc)
+            weights = argv[++i];
+        else if(strcmp(argv[i], "-f") == 0 && i+1 < argc)
+            flush_seconds = atoi(argv[++i]);
+        else
+            names.push_back(argv[i]);
+    }
+    int n = names.size();
+    if(argc < 3 || n < 1 || n > MAX_STREAMS)
+    {
+        printf("Usage: ./cal_set_stream [output] [-b] [-w weight1,weight2,...] [-f seconds] [stream1] ... [streamN]\n");
+        exit(1);
+    }
+    sprintf(outfilename1, "%s_access", argv[1]);
+    sprintf(outfilename2, "%s_miss", argv[1]);
+
+    epoll_fd = epoll_create1(0);
+    streams.resize(n);
+    for(int i = 0; i<n; i++)
+    {
+        streams[i].Open(names[i], i, n);
+        streams[i].weight = 1;
+    }
+    for(int i = 0; weights != NULL && i<n; i++)
+    {
+        streams[i].weight = strtol(weights, &weights, 10);
+        if(streams[i].weight < 1)
+        {
+            printf("the weights must be positive\n");
+            exit(1);
+        }
+        if(*weights == ',')
+            weights++;
+    }
+
+    Cache = new Compact_set<Tag, WAYS>[slices][SETS];
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
+            Init_set(Cache[i][j]);
+    count = new unsigned long long[slices][SETS]();
+    miss_count = new unsigned long long[slices][SETS]();
+
+    time_t start = time(NULL), last_flush = start;
+    unsigned long long turns = 0;
+    vector<unsigned long long> first(n);
+    while(true)
+    {
+        bool finished = false;    // a turn begins only when every stream has an access
+        for(int i = 0; i<n && !finished; i++)
+            finished = !Next(i, first[i]);
+        if(finished)
+            break;
+        for(int i = 0; i<n; i++)
+        {
+            Access(first[i]);
+            unsigned long long addr;
+            for(int k = 1; k<streams[i].weight; k++)
+            {
+                if(!Next(i, addr))
+                    break;
+                Access(addr);
+            }
+        }
+
+        turns++;
+        if(flush_seconds > 0 && (turns & 0xFFF) == 0 && time(NULL) - last_flush >= flush_seconds)
+        {
+            Flush();
+            last_flush = time(NULL);
+            printf("%llu accesses in %lds\n", accesses, (long)(last_flush - start));
+            fflush(stdout);
+        }
+    }
+    Flush();
+    printf("%llu accesses in %lds\n", accesses, (long)(time(NULL) - start));
+
+    for(int i = 0; i<n; i++)
+    {
+        if(streams[i].fd != 0)
+            close(streams[i].fd);
+        delete []streams[i].buf;
+    }
+    close(epoll_fd);
+    delete []Cache;
+    delete []count;
+    delete []miss_count;
+    return 0;
+}
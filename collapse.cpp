@@ -0,0 +1,76 @@
+/*
+ * This program collapses the consecutive accesses to the same cache line of a trace into one record.
+ * Under LRU, such a repeat is always a hit on the MRU line of its set and changes nothing but the counters,
+ * so the simulators can take a record as one access plus count-1 hits credited in bulk, and the results stay exact.
+ * For a replacement policy where a hit also updates the state (e.g. LFU counters or RRIP re-reference values),
+ * the collapsed trace is only an approximation: do NOT use it with such policies.
+ * Every line of the output is "address count", where address is the first address of the run.
+ * cal_set.cpp and cal_set_slice.cpp read [benchmark].rle when [benchmark].out is absent; occupancy*.cpp read
+ * [benchmark]_[slice_no]_[set_no].rle, which collapses the repeats of one set, when the .out is absent.
+ * Precondition: The .out file including all the traces of the benchmark, or the traces of one set filtered by filter.cpp.
+ * Usage: g++ -std=c++11 -O2 collapse.cpp -o collapse
+ *        ./collapse [benchmark]    (or [benchmark]_[slice_no]_[set_no])
+ * Output: the collapsed trace, saved as [benchmark].rle
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+using namespace std;
+
+char benchname[100];
+char filename[200], outfilename[200];
+FILE *file, *outfile;
+int block_bits = 6;
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        printf("Usage: ./collapse [benchmark]\n");
+        exit(1);
+    }
+    strcpy(benchname, argv[1]);
+    sprintf(filename, "%s.out", benchname);
+    sprintf(outfilename, "%s.rle", benchname);
+    file = fopen(filename, "r");
+    outfile = fopen(outfilename, "w");
+    if(file == NULL || outfile == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    setvbuf(file, NULL, _IOFBF, 1<<20);
+    setvbuf(outfile, NULL, _IOFBF, 1<<20);
+
+    char tmp[100];
+    unsigned long long addr, run_addr = 0, run_count = 0, accesses = 0, runs = 0;
+    while(fgets(tmp, 99, file) != NULL)
+    {
+        addr = strtoull(tmp, NULL, 10);
+        accesses++;
+        if(run_count > 0 && (addr >> block_bits) == (run_addr >> block_bits))
+        {
+            run_count++;
+            continue;
+        }
+        if(run_count > 0)
+        {
+            fprintf(outfile, "%llu %llu\n", run_addr, run_count);
+            runs++;
+        }
+        run_addr = addr;
+        run_count = 1;
+    }
+    if(run_count > 0)
+    {
+        fprintf(outfile, "%llu %llu\n", run_addr, run_count);
+        runs++;
+    }
+
+    fclose(file);
+    fclose(outfile);
+    printf("%llu accesses collapsed into %llu records (%.2fx), exact for LRU only\n", accesses, runs,
+           runs > 0? (double)accesses/runs:0);
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * The compact LRU set of cal_set_slice_compact.cpp and cal_set_stream.cpp, which oracle.cpp checks against the
+ * reference. A Compact_set of WAYS ways (at most 15) keeps, instead of a linked list and two unordered_maps:
+ *   tag:    the tags of the ways, with the set bits, the block bits and the benchmark marker removed (see Split_tag);
+ *   owner:  the benchmark of every way, i.e. the marker (address >> 53);
+ *   order:  the recency as a permutation of the ways, 4 bits for every position, position 0 is the MRU
+ *           and position ways-1 is the LRU (Move_to_front, also used by Flat_cache of flat_cache.h).
+ * A set may use only its first [ways] ways, as oracle.cpp does for every geometry.
+ */
+
+#ifndef COMPACT_SET_H
+#define COMPACT_SET_H
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+inline void Move_to_front(unsigned long long &order, int pos)    // the way at position pos becomes the MRU
+{
+    unsigned long long way = (order >> (4*pos)) & 15;
+    unsigned long long below = order & ((1ULL << (4*pos)) - 1);     // positions 0~pos-1
+    unsigned long long above = order & (~0ULL << (4*(pos+1)));      // positions pos+1~
+    order = above | (below << 4) | way;
+}
+
+template<class Tag, int WAYS>
+struct Compact_set
+{
+    unsigned long long order;     // the way at position i is (order >> 4*i) & 15
+    Tag tag[WAYS];
+    unsigned char owner[WAYS];
+    unsigned char used;           // the ways filled, they are always at positions 0~used-1
+
+    static_assert(WAYS <= 15, "the order of the ways does not fit in 64 bits");
+};
+
+template<class Tag, int WAYS>
+void Init_set(Compact_set<Tag, WAYS> &set, int ways = WAYS)
+{
+    memset(&set, 0, sizeof(set));
+    for(int i = 0; i<ways; i++)    // the empty ways in order, way used is the next one to fill
+        set.order |= (unsigned long long)i << (4*i);
+}
+
+// the tag of addr without the set bits and the block bits (shift) and the benchmark marker, and the marker as its
+// owner; a trace whose tag does not fit in tag_bits bits is rejected
+template<class Tag>
+void Split_tag(unsigned long long addr, int shift, int tag_bits, Tag &tag, unsigned char &owner)
+{
+    unsigned long long full_tag = (addr & (((unsigned long long)1<<53) - 1)) >> shift;
+    unsigned long long marker = addr >> 53;
+    if(full_tag >> (tag_bits-1) >> 1 != 0 || marker > 255)    // two shifts, tag_bits may be 64
+    {
+        printf("the tag of address %llu does not fit in %d bits, widen Tag and TAG_BITS\n", addr, tag_bits);
+        exit(1);
+    }
+    tag = (Tag)full_tag;
+    owner = (unsigned char)marker;
+}
+
+template<class Tag, int WAYS>
+bool Compact_access(Compact_set<Tag, WAYS> &set, Tag tag, unsigned char owner, int ways = WAYS)    // true when hit
+{
+    for(int pos = 0; pos<set.used; pos++)
+    {
+        int way = (set.order >> (4*pos)) & 15;
+        if(set.tag[way] == tag && set.owner[way] == owner) // found
+        {
+            if(pos > 0)
+                Move_to_front(set.order, pos);
+            return true;
+        }
+    }
+
+    // not found
+    int pos = set.used < ways? set.used++:ways-1;    // the next empty way, or the LRU one when full
+    int way = (set.order >> (4*pos)) & 15;
+    set.tag[way] = tag;
+    set.owner[way] = owner;
+    Move_to_front(set.order, pos);
+    return false;
+}
+
+#endif
@@ -2,7 +2,7 @@
  * This program filters the traces given slice_no and set_no.
  * Precondition: The .out file including all the traces of the benchmark.
  * Usage: g++ filter.cpp -o filter
- *        ./filter [benchmark]
+ *        ./filter [benchmark] [-m slice_map]    (the slice map of cal_set_slice.cpp, 8 slices of Cal_slice by default)
  * Input: follow the hints
  * Output: the traces of a certain set of the slice, saved as [benchmark]_[slice_no]_[set_no].out
  * Author: Jack Wang
@@ -13,6 +13,7 @@
 #include <cstring>
 #include <cstdlib>
 #include <cmath>
+#include "slice_map.h"
 using namespace std;
 
 char benchname[20];
@@ -44,27 +45,23 @@ void Finish()
     return;
 }
 
-int Cal_slice(unsigned long long addr)
-{
-    unsigned long long result = 0;
-    result += ((addr>>37)&1) ^ ((addr>>36)&1) ^ ((addr>>35)&1) ^ ((addr>>34)&1) ^ ((addr>>31)&1) ^ ((addr>>30)&1)
-              ^ ((addr>>27)&1) ^ ((addr>>26)&1) ^ ((addr>>23)&1) ^ ((addr>>22)&1) ^ ((addr>>19)&1) ^ ((addr>>16)&1)
-              ^ ((addr>>13)&1) ^ ((addr>>12)&1) ^ ((addr>>8)&1);
-    result = result << 1;
-    result += ((addr>>37)&1) ^ ((addr>>35)&1) ^ ((addr>>34)&1) ^ ((addr>>33)&1) ^ ((addr>>31)&1) ^ ((addr>>29)&1)
-              ^ ((addr>>28)&1) ^ ((addr>>26)&1) ^ ((addr>>24)&1) ^ ((addr>>23)&1) ^ ((addr>>22)&1) ^ ((addr>>21)&1)
-              ^ ((addr>>20)&1) ^ ((addr>>19)&1) ^ ((addr>>17)&1) ^ ((addr>>15)&1) ^ ((addr>>13)&1) ^ ((addr>>11)&1)
-              ^ ((addr>>7)&1);
-    result = result << 1;
-    result += ((addr>>36)&1) ^ ((addr>>35)&1) ^ ((addr>>33)&1) ^ ((addr>>32)&1) ^ ((addr>>30)&1) ^ ((addr>>28)&1)
-              ^ ((addr>>27)&1) ^ ((addr>>26)&1) ^ ((addr>>25)&1) ^ ((addr>>24)&1) ^ ((addr>>22)&1) ^ ((addr>>20)&1)
-              ^ ((addr>>18)&1) ^ ((addr>>17)&1) ^ ((addr>>16)&1) ^ ((addr>>14)&1) ^ ((addr>>12)&1) ^ ((addr>>10)&1)
-              ^ ((addr>>6)&1);
-    return result;
-}
-
 int main(int argc, char *argv[])
 {
+    if(argc < 2)
+    {
+        printf("Usage: ./filter [benchmark] [-m slice_map]\n");
+        exit(1);
+    }
+    for(int i = 2; i<argc; i++)
+    {
+        if(strcmp(argv[i], "-m") == 0 && i+1 < argc)
+            slices = Load_slice_map(argv[++i]);
+        else
+        {
+            printf("unknown option %s, usage: ./filter [benchmark] [-m slice_map]\n", argv[i]);
+            exit(1);
+        }
+    }
     printf("please input slice number(0~%d): ", slices-1);
     scanf("%d", &chosen_slice_no);
     printf("please input set number(0~%d): ", SETS-1);
@@ -91,7 +88,7 @@ int main(int argc, char *argv[])
         // addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
         unsigned long long tag = addr >> (set_bits+block_bits);
         unsigned long long set_no = (addr >> block_bits) & 0B11111111111;    // set_bits
-        int slice = Cal_slice(addr);
+        int slice = Map_slice(addr);
 
         if((slice == chosen_slice_no) && (set_no == chosen_set_no))
             fprintf(outfile, "%llu\n", addr);
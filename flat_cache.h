@@ -0,0 +1,116 @@
+/*
+ * The flat LRU cache of cal_set_hierarchy.cpp, a level of the hierarchy or a slice of the LLC, which oracle.cpp
+ * checks against the reference: the line addresses of a set in one array and the recency as a permutation of the
+ * ways, 4 bits for every position (see compact_set.h), so at most 15 ways. A cache of 0 sets is disabled.
+ */
+
+#ifndef FLAT_CACHE_H
+#define FLAT_CACHE_H
+
+#include "compact_set.h"
+
+class Flat_cache
+{
+public:
+    int sets, ways;
+    unsigned long long *line;     // line[set*ways+way], the line address (address >> block_bits)
+    unsigned long long *order;    // the way at position i of a set is (order[set] >> 4*i) & 15, position 0 is the MRU
+    unsigned char *used;          // the ways filled, they are always at positions 0~used-1
+    unsigned long long accesses, misses;
+
+    void Init(int s, int w);
+    bool Access(unsigned long long l, unsigned long long &victim);
+    bool Invalidate(unsigned long long l);
+    int State(unsigned long long set_no, int *way, unsigned long long *lines);
+    void Free();
+};
+
+void Flat_cache::Init(int s, int w)
+{
+    sets = s;
+    ways = w;
+    accesses = misses = 0;
+    if(sets == 0)
+        return;
+    line = new unsigned long long[(size_t)sets*ways]();
+    order = new unsigned long long[sets];
+    used = new unsigned char[sets]();
+    for(int k = 0; k<sets; k++)
+    {
+        order[k] = 0;
+        for(int i = 0; i<ways; i++)    // the empty ways in order, way used is the next one to fill
+            order[k] |= (unsigned long long)i << (4*i);
+    }
+}
+
+void Flat_cache::Free()
+{
+    if(sets == 0)
+        return;
+    delete []line;
+    delete []order;
+    delete []used;
+}
+
+// true when hit; when missed, the line is filled and the evicted line is saved in victim (~0 when none)
+bool Flat_cache::Access(unsigned long long l, unsigned long long &victim)
+{
+    unsigned long long set_no = l & (sets-1);
+    unsigned long long *lines = line + set_no*ways;
+    accesses++;
+    for(int pos = 0; pos<used[set_no]; pos++)
+    {
+        int way = (order[set_no] >> (4*pos)) & 15;
+        if(lines[way] == l) // found
+        {
+            if(pos > 0)
+                Move_to_front(order[set_no], pos);
+            return true;
+        }
+    }
+
+    // not found
+    misses++;
+    bool full = used[set_no] == ways;
+    int pos = full? ways-1:used[set_no]++;    // the LRU way when full, or the next empty one
+    int way = (order[set_no] >> (4*pos)) & 15;
+    victim = full? lines[way]:~0ULL;
+    lines[way] = l;
+    Move_to_front(order[set_no], pos);
+    return false;
+}
+
+bool Flat_cache::Invalidate(unsigned long long l)    // the way becomes the first empty one
+{
+    unsigned long long set_no = l & (sets-1);
+    unsigned long long *lines = line + set_no*ways;
+    for(int pos = 0; pos<used[set_no]; pos++)
+    {
+        int way = (order[set_no] >> (4*pos)) & 15;
+        if(lines[way] == l)
+        {
+            int last = used[set_no]-1;
+            unsigned long long o = order[set_no];
+            unsigned long long below = o & ((1ULL << (4*pos)) - 1);
+            unsigned long long middle = (o >> (4*(pos+1))) & ((1ULL << (4*(last-pos))) - 1);    // positions pos+1~last
+            unsigned long long above = o & (~0ULL << (4*(last+1)));
+            order[set_no] = above | ((unsigned long long)way << (4*last)) | (middle << (4*pos)) | below;
+            lines[way] = ~0ULL;
+            used[set_no]--;
+            return true;
+        }
+    }
+    return false;
+}
+
+int Flat_cache::State(unsigned long long set_no, int *way, unsigned long long *lines)    // the valid ways from the MRU
+{
+    for(int pos = 0; pos<used[set_no]; pos++)
+    {
+        way[pos] = (order[set_no] >> (4*pos)) & 15;
+        lines[pos] = line[set_no*ways+way[pos]];
+    }
+    return used[set_no];
+}
+
+#endif
@@ -0,0 +1,390 @@
+/*
+ * This program estimates the footprint of every set of the sliced LLC for every benchmark, in one pass over its trace,
+ * to choose the sets to study with filter.cpp and occupancy.cpp. For every (slice, set) of a benchmark:
+ *   accesses;
+ *   distinct: the distinct lines, by a HyperLogLog of 2^precision registers of a byte (precision 10 by default:
+ *             1KB for every set, a standard error of 1.04/sqrt(1024) = 3.3%);
+ *   reuse:    accesses / distinct, the accesses of a line on average;
+ *   working set: the distinct lines in every window of [window] accesses of the set, by a HyperLogLog of 64 registers
+ *             (13% error) restarted at the end of every window (tumbling windows), as the mean and the max over the
+ *             windows. The last window, cut by the end of the trace, counts as a window.
+ * The lines are hashed by the finalizer of splitmix64, so one hash serves both sketches. No line is kept.
+ * Parallel: "-f [first] -n [count]" takes only the accesses first~first+count-1 of the trace, and "-s" saves the
+ * sketches as [benchmark]_[first].hll, so the parts of a trace can run in parallel and be merged by "-m": the
+ * registers are merged by max, which gives the same distinct lines as one pass, the accesses and windows are added,
+ * and a window cut at the end of a part counts as a window.
+ * Precondition: [benchmark].out including all the traces of the benchmark, or the .rle/.bin as cal_set_slice.cpp.
+ * Usage: g++ -std=c++11 -O2 footprint.cpp -o footprint
+ *        ./footprint [benchmark] [-p precision] [-w window] [-f first] [-n count] [-s]
+ *        ./footprint -m [output] [sketch1] ... [sketchN]
+ * Output: [benchmark]_footprint ([output]_footprint, [benchmark]_[first]_footprint for a part), every line is
+ *         "slice_no set_no accesses distinct reuse working_set_mean working_set_max"
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include "slice_map.h"
+using namespace std;
+
+char benchname[100];
+char outfilename[200], sketch_filename[200];
+FILE *outfile;
+int slices = 8, set_bits = 11, block_bits = 6;
+#define SETS 2048    // 2^set_bits
+#define WINDOW_BITS 6    // 64 registers for the working set of a window
+int precision = 10;
+unsigned long long window = 10000;    // accesses of a set
+unsigned long long first = 0, access_num = ~0ULL;    // the part of the trace
+
+struct Set_sketch
+{
+    unsigned long long accesses;
+    unsigned long long windows;          // finished
+    double ws_sum, ws_max;               // of the working sets of the finished windows
+    unsigned long long window_accesses;  // of the current window
+    unsigned char window_reg[1<<WINDOW_BITS];
+};
+
+Set_sketch (*sketch)[SETS];
+unsigned char *reg;    // reg[(slice*SETS+set) << precision]
+
+struct Sketch_header
+{
+    char magic[8];    // "HLL1"
+    unsigned int slices, sets, precision, window_bits;
+    unsigned long long window;
+};
+// followed by sketch[slices][SETS] and reg[slices*SETS << precision]
+
+class Trace_reader    // [benchmark].out, or [benchmark].rle collapsed by collapse.cpp, or [benchmark].bin
+{
+public:
+    FILE *file;
+    int kind;                         // 0: .out, 1: .rle, 2: .bin
+    unsigned long long addr, left;    // the current run of the same line
+
+    bool Open(const char *benchname);
+    bool Next(unsigned long long &a, unsigned long long &n, unsigned long long max);
+    unsigned long long Skip(unsigned long long n);
+};
+
+bool Trace_reader::Open(const char *benchname)
+{
+    char filename[200];
+    sprintf(filename, "%s.out", benchname);
+    kind = 0;
+    left = 0;
+    file = fopen(filename, "r");
+    if(file == NULL)
+    {
+        sprintf(filename, "%s.rle", benchname);
+        file = fopen(filename, "r");
+        kind = 1;
+    }
+    if(file == NULL)
+    {
+        sprintf(filename, "%s.bin", benchname);
+        file = fopen(filename, "rb");
+        kind = 2;
+    }
+    if(file != NULL)
+        setvbuf(file, NULL, _IOFBF, 1<<20);
+    return file != NULL;
+}
+
+// the next n (1~max) accesses, which are all to the line of address a
+bool Trace_reader::Next(unsigned long long &a, unsigned long long &n, unsigned long long max)
+{
+    if(left == 0 && kind == 2)
+    {
+        if(fread(&addr, sizeof(unsigned long long), 1, file) != 1)
+            return false;
+        left = 1;
+    }
+    else if(left == 0)
+    {
+        char tmp[100], *p;
+        if(fgets(tmp, 99, file) == NULL)
+            return false;
+        addr = strtoull(tmp, &p, 10);
+        left = kind == 1? strtoull(p, NULL, 10):1;
+        if(left == 0)
+            left = 1;
+    }
+    a = addr;
+    n = left < max? left:max;
+    left -= n;
+    return true;
+}
+
+unsigned long long Trace_reader::Skip(unsigned long long n)    // pass over n accesses, returns those really skipped
+{
+    unsigned long long skipped = left < n? left:n;    // the rest of the current run
+    left -= skipped;
+    if(kind == 2)
+    {
+        long pos = ftell(file);
+        fseek(file, 0, SEEK_END);
+        unsigned long long rest = (ftell(file) - pos) / sizeof(unsigned long long);
+        unsigned long long k = rest < n-skipped? rest:n-skipped;
+        fseek(file, pos + k*sizeof(unsigned long long), SEEK_SET);
+        return skipped + k;
+    }
+    char tmp[100], *p;
+    while(skipped < n && fgets(tmp, 99, file) != NULL)
+    {
+        if(kind == 0)
+        {
+            skipped++;
+            continue;
+        }
+        unsigned long long a = strtoull(tmp, &p, 10), run = strtoull(p, NULL, 10);
+        if(run == 0)
+            run = 1;
+        if(run > n-skipped)    // the run goes on after the skip
+        {
+            addr = a;
+            left = run - (n-skipped);
+            run = n-skipped;
+        }
+        skipped += run;
+    }
+    return skipped;
+}
+
+unsigned long long Hash(unsigned long long x)    // the finalizer of splitmix64
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+void Add(unsigned char *r, int bits, unsigned long long h)    // the register of the top bits, the rank of the rest
+{
+    unsigned long long idx = h >> (64-bits);
+    unsigned char rank = __builtin_clzll((h << bits) | (1ULL << (bits-1))) + 1;
+    if(rank > r[idx])
+        r[idx] = rank;
+}
+
+double Estimate(const unsigned char *r, int bits)
+{
+    int m = 1 << bits, zeros = 0;
+    double sum = 0;
+    for(int i = 0; i<m; i++)
+    {
+        sum += ldexp(1.0, -r[i]);
+        zeros += r[i] == 0;
+    }
+    double alpha = m == 16? 0.673:m == 32? 0.697:m == 64? 0.709:0.7213/(1+1.079/m);
+    double e = alpha*m*m/sum;
+    if(e <= 2.5*m && zeros > 0)    // small range, linear counting
+        e = m*log((double)m/zeros);
+    return e;
+}
+
+void End_window(Set_sketch &s)
+{
+    double ws = Estimate(s.window_reg, WINDOW_BITS);
+    s.windows++;
+    s.ws_sum += ws;
+    if(ws > s.ws_max)
+        s.ws_max = ws;
+    s.window_accesses = 0;
+    memset(s.window_reg, 0, sizeof(s.window_reg));
+}
+
+void Access(unsigned long long addr, unsigned long long n)    // n accesses to the same line in a row
+{
+    unsigned long long set_no = (addr >> block_bits) & 0B11111111111;    // set_bits
+    int slice = Cal_slice(addr);
+    Set_sketch &s = sketch[slice][set_no];
+    unsigned long long h = Hash(addr >> block_bits);
+    Add(reg + (((unsigned long long)slice*SETS + set_no) << precision), precision, h);
+    s.accesses += n;
+    while(n > 0)    // a run may cross the end of a window
+    {
+        Add(s.window_reg, WINDOW_BITS, h);
+        unsigned long long k = window - s.window_accesses < n? window - s.window_accesses:n;
+        s.window_accesses += k;
+        n -= k;
+        if(s.window_accesses == window)
+            End_window(s);
+    }
+}
+
+void Start()
+{
+    sketch = new Set_sketch[slices][SETS]();
+    reg = new unsigned char[(size_t)slices*SETS << precision]();
+}
+
+void Save_sketch()
+{
+    FILE *file = fopen(sketch_filename, "wb");
+    if(file == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    Sketch_header header;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, "HLL1");
+    header.slices = slices;
+    header.sets = SETS;
+    header.precision = precision;
+    header.window_bits = WINDOW_BITS;
+    header.window = window;
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(sketch, sizeof(Set_sketch), (size_t)slices*SETS, file);
+    fwrite(reg, 1, (size_t)slices*SETS << precision, file);
+    fclose(file);
+}
+
+void Merge_sketch(const char *filename, bool first_one)
+{
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL)
+    {
+        printf("cannot open %s\n", filename);
+        exit(1);
+    }
+    Sketch_header header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || strcmp(header.magic, "HLL1") != 0 || header.slices != (unsigned)slices ||
+       header.sets != SETS || header.window_bits != WINDOW_BITS || (!first_one && (header.precision != (unsigned)precision ||
+       header.window != window)))
+    {
+        printf("%s is not a sketch of the same geometry, precision and window\n", filename);
+        exit(1);
+    }
+    if(first_one)
+    {
+        precision = header.precision;
+        window = header.window;
+        Start();
+    }
+    Set_sketch *part = new Set_sketch[(size_t)slices*SETS];
+    unsigned char *part_reg = new unsigned char[(size_t)slices*SETS << precision];
+    if(fread(part, sizeof(Set_sketch), (size_t)slices*SETS, file) != (size_t)slices*SETS ||
+       fread(part_reg, 1, (size_t)slices*SETS << precision, file) != ((size_t)slices*SETS << precision))
+    {
+        printf("%s is broken\n", filename);
+        exit(1);
+    }
+    fclose(file);
+
+    Set_sketch *s = &sketch[0][0];
+    for(size_t k = 0; k<(size_t)slices*SETS; k++)
+    {
+        s[k].accesses += part[k].accesses;
+        s[k].windows += part[k].windows;
+        s[k].ws_sum += part[k].ws_sum;
+        if(part[k].ws_max > s[k].ws_max)
+            s[k].ws_max = part[k].ws_max;
+    }
+    for(size_t k = 0; k<((size_t)slices*SETS << precision); k++)
+        if(part_reg[k] > reg[k])
+            reg[k] = part_reg[k];
+    delete []part;
+    delete []part_reg;
+}
+
+void Write_footprint()
+{
+    outfile = fopen(outfilename, "w");
+    if(outfile == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    for(int i = 0; i<slices; i++)
+        for(int j = 0; j<SETS; j++)
+        {
+            Set_sketch &s = sketch[i][j];
+            double distinct = Estimate(reg + (((unsigned long long)i*SETS + j) << precision), precision);
+            if(s.accesses > 0 && distinct < 1)
+                distinct = 1;
+            fprintf(outfile, "%d %d %llu %.0f %.2f %.1f %.0f\n", i, j, s.accesses, distinct,
+                    distinct > 0? s.accesses/distinct:0, s.windows > 0? s.ws_sum/s.windows:0, s.ws_max);
+        }
+    fclose(outfile);
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc >= 4 && strcmp(argv[1], "-m") == 0)
+    {
+        for(int i = 3; i<argc; i++)
+            Merge_sketch(argv[i], i == 3);
+        sprintf(outfilename, "%s_footprint", argv[2]);
+        Write_footprint();
+        printf("%d sketches merged\n", argc-3);
+        return 0;
+    }
+
+    bool save = false;
+    if(argc < 2)
+    {
+        printf("Usage: ./footprint [benchmark] [-p precision] [-w window] [-f first] [-n count] [-s], or "
+               "./footprint -m [output] [sketch1] ... [sketchN]\n");
+        exit(1);
+    }
+    for(int i = 2; i<argc; i++)
+    {
+        if(strcmp(argv[i], "-p") == 0 && i+1 < argc)
+            precision = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-w") == 0 && i+1 < argc)
+            window = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-f") == 0 && i+1 < argc)
+            first = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            access_num = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-s") == 0)
+            save = true;
+    }
+    if(precision < 4 || precision > 16 || window == 0)
+    {
+        printf("the precision must be 4~16 and the window positive\n");
+        exit(1);
+    }
+    strcpy(benchname, argv[1]);
+    if(first > 0 || access_num != ~0ULL)    // a part, not to overwrite the other parts or the whole trace
+        sprintf(outfilename, "%s_%llu_footprint", benchname, first);
+    else
+        sprintf(outfilename, "%s_footprint", benchname);
+    sprintf(sketch_filename, "%s_%llu.hll", benchname, first);
+
+    Trace_reader reader;
+    if(!reader.Open(benchname))
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    Start();
+
+    reader.Skip(first);
+    unsigned long long addr, n, accesses = 0;
+    while(accesses < access_num && reader.Next(addr, n, access_num - accesses))
+    {
+        Access(addr, n);
+        accesses += n;
+    }
+    fclose(reader.file);
+
+    for(int i = 0; i<slices; i++)    // the windows cut by the end
+        for(int j = 0; j<SETS; j++)
+            if(sketch[i][j].window_accesses > 0)
+                End_window(sketch[i][j]);
+    if(save)
+        Save_sketch();
+    Write_footprint();
+    printf("%llu accesses, the sketches take %.2fMB\n", accesses,
+           (double)slices*SETS*(sizeof(Set_sketch) + (1 << precision))/(1<<20));
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * This program builds the per-set index of a trace, so that the accesses of one set of one slice can be
+ * gathered from the whole trace directly, instead of filtering them into a file with filter.cpp first.
+ * The binary trace [benchmark].bin is an array of 64-bit little-endian addresses in the order of [benchmark].out,
+ * it is converted from [benchmark].out when it does not exist (parse.cpp converts it much faster and checks every line).
+ * The index [benchmark].idx is built in one parallel pass over the mmaped binary trace, every thread takes a
+ * contiguous chunk and the lists of the chunks are concatenated in order. Layout:
+ *   Idx_header;
+ *   unsigned long long offset[slices*SETS+1];    // byte offsets of the position lists in data
+ *   unsigned long long number[slices*SETS];      // accesses of every (slice, set), index = slice*SETS+set
+ *   unsigned char data[];                        // positions (indexes in [benchmark].bin) of every (slice, set),
+ *                                                // as LEB128 varints of the deltas, the first one from 0
+ * occupancy.cpp and occupancy_dynamic.cpp read a set through the index when [benchmark]_[slice]_[set].out is absent.
+ * Usage: g++ -std=c++11 -O2 -pthread index.cpp -o index
+ *        ./index [benchmark] [-m slice_map]
+ * Slices: the 8 slices of Cal_slice by default, or the slice map of a file given by "-m" (see Load_slice_map of
+ * slice_map.h), so that the sets are those of filter.cpp and cal_set_slice.cpp with the same map.
+ * Output: [benchmark].bin (when absent) and [benchmark].idx
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "slice_map.h"
+using namespace std;
+
+char benchname[100];
+char filename[200], binfilename[200], idxfilename[200];
+int slices = 8, set_bits = 11, block_bits = 6;
+#define SETS 2048    // 2^set_bits
+
+struct Idx_header
+{
+    char magic[8];                 // "SETIDX1"
+    unsigned int slices, sets;
+    unsigned long long accesses;   // the length of [benchmark].bin
+};
+
+struct Chunk_list                  // the positions of one (slice, set) in one chunk
+{
+    unsigned long long first, last, number;
+    vector<unsigned char> rest;    // varint deltas after the first position
+};
+
+void Put_varint(vector<unsigned char> &v, unsigned long long x)
+{
+    while(x >= 0x80)
+    {
+        v.push_back((unsigned char)(x | 0x80));
+        x >>= 7;
+    }
+    v.push_back((unsigned char)x);
+}
+
+void Convert()    // [benchmark].out -> [benchmark].bin
+{
+    FILE *file = fopen(filename, "r");
+    FILE *binfile = fopen(binfilename, "wb");
+    if(file == NULL || binfile == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    const int batch = 1<<16;
+    unsigned long long *buf = new unsigned long long[batch];
+    int n = 0;
+    char tmp[100];
+    while(fgets(tmp, 99, file) != NULL)
+    {
+        buf[n++] = strtoull(tmp, NULL, 10);
+        if(n == batch)
+        {
+            fwrite(buf, sizeof(unsigned long long), n, binfile);
+            n = 0;
+        }
+    }
+    fwrite(buf, sizeof(unsigned long long), n, binfile);
+    delete []buf;
+    fclose(file);
+    fclose(binfile);
+}
+
+void Build_chunk(const unsigned long long *trace, unsigned long long begin, unsigned long long end, Chunk_list *lists)
+{
+    for(unsigned long long i = begin; i<end; i++)
+    {
+        unsigned long long addr = trace[i];
+        unsigned long long set_no = (addr >> block_bits) & (SETS-1);
+        Chunk_list &list = lists[Map_slice(addr)*SETS + set_no];
+        if(list.number == 0)
+            list.first = i;
+        else
+            Put_varint(list.rest, i - list.last);
+        list.last = i;
+        list.number++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        printf("Usage: ./index [benchmark] [-m slice_map]\n");
+        exit(1);
+    }
+    strcpy(benchname, argv[1]);
+    for(int i = 2; i<argc; i++)
+    {
+        if(strcmp(argv[i], "-m") == 0 && i+1 < argc)
+            slices = Load_slice_map(argv[++i]);
+        else
+        {
+            printf("unknown option %s, usage: ./index [benchmark] [-m slice_map]\n", argv[i]);
+            exit(1);
+        }
+    }
+    sprintf(filename, "%s.out", benchname);
+    sprintf(binfilename, "%s.bin", benchname);
+    sprintf(idxfilename, "%s.idx", benchname);
+
+    clock_t start = clock();
+    if(access(binfilename, F_OK) != 0)
+        Convert();
+
+    int fd = open(binfilename, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0)
+    {
+        printf("cannot open %s\n", binfilename);
+        exit(1);
+    }
+    unsigned long long accesses = st.st_size / sizeof(unsigned long long);
+    const unsigned long long *trace = NULL;
+    if(accesses > 0)
+    {
+        trace = (const unsigned long long *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(trace == MAP_FAILED)
+        {
+            printf("cannot mmap %s\n", binfilename);
+            exit(1);
+        }
+        madvise((void *)trace, st.st_size, MADV_SEQUENTIAL);
+    }
+
+    // one parallel pass, a contiguous chunk for every thread
+    int thread_num = thread::hardware_concurrency();
+    if(thread_num < 1)
+        thread_num = 1;
+    int lists_num = slices*SETS;
+    vector<Chunk_list *> lists(thread_num);
+    vector<thread> threads;
+    for(int t = 0; t<thread_num; t++)
+    {
+        lists[t] = new Chunk_list[lists_num];
+        for(int k = 0; k<lists_num; k++)
+            lists[t][k].number = 0;
+        unsigned long long begin = accesses*t/thread_num, end = accesses*(t+1)/thread_num;
+        threads.push_back(thread(Build_chunk, trace, begin, end, lists[t]));
+    }
+    for(int t = 0; t<thread_num; t++)
+        threads[t].join();
+
+    FILE *idxfile = fopen(idxfilename, "wb");
+    if(idxfile == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    Idx_header header;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, "SETIDX1");
+    header.slices = slices;
+    header.sets = SETS;
+    header.accesses = accesses;
+    vector<unsigned long long> offset(lists_num+1, 0), number(lists_num, 0);
+    fwrite(&header, sizeof(header), 1, idxfile);
+    fwrite(offset.data(), sizeof(unsigned long long), lists_num+1, idxfile);    // rewritten below
+    fwrite(number.data(), sizeof(unsigned long long), lists_num, idxfile);
+
+    vector<unsigned char> data;
+    for(int k = 0; k<lists_num; k++)
+    {
+        data.clear();
+        unsigned long long prev = 0;
+        for(int t = 0; t<thread_num; t++)
+        {
+            Chunk_list &list = lists[t][k];
+            if(list.number == 0)
+                continue;
+            Put_varint(data, list.first - prev);    // the first delta of a chunk is relative to the previous chunk
+            data.insert(data.end(), list.rest.begin(), list.rest.end());
+            prev = list.last;
+            number[k] += list.number;
+            vector<unsigned char>().swap(list.rest);
+        }
+        fwrite(data.data(), 1, data.size(), idxfile);
+        offset[k+1] = offset[k] + data.size();
+    }
+    fseek(idxfile, sizeof(header), SEEK_SET);
+    fwrite(offset.data(), sizeof(unsigned long long), lists_num+1, idxfile);
+    fwrite(number.data(), sizeof(unsigned long long), lists_num, idxfile);
+    fclose(idxfile);
+
+    for(int t = 0; t<thread_num; t++)
+        delete []lists[t];
+    if(trace != NULL)
+        munmap((void *)trace, st.st_size);
+    close(fd);
+    printf("%llu accesses indexed with %d threads in %.3fs, %.2f bytes per access\n", accesses, thread_num,
+           (double)(clock()-start) / CLOCKS_PER_SEC, accesses > 0? (double)offset[lists_num]/accesses:0);
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * This program prints the live statistics of a long run of cal_set_slice.cpp or occupancy.cpp started with
+ * "-L [name]", by reading the shared memory page the simulator publishes (see Live_page of live.h), without locks and
+ * without slowing it: the page is only read, and a copy torn by an update is read again (seqlock).
+ * Every line: the time since the start, the accesses, the accesses/s of the last update and on average, the
+ * traces read, the miss ratio, and the occupancies of the two benchmarks (occupancy.cpp); with "-s", the hits,
+ * misses and miss ratio of every slice (cal_set_slice.cpp) or benchmark (occupancy.cpp).
+ * It waits for the run to start, and ends with it.
+ * Usage: g++ -std=c++11 -O2 live.cpp -o live
+ *        ./live [name] [-i milliseconds] [-s]    (1000 milliseconds between two lines by default)
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include "live.h"
+using namespace std;
+
+struct Live_values    // a consistent copy of the counters
+{
+    int done;
+    double seconds, rate;
+    unsigned long long accesses, bytes, total_bytes;
+    int occupancy[2];
+    unsigned long long hit[LIVE_SLICES], miss[LIVE_SLICES];
+};
+
+void Read(const Live_page *live, Live_values &v)
+{
+    while(true)
+    {
+        unsigned seq = live->seq.load(memory_order_acquire);
+        if(seq & 1)    // being updated
+        {
+            usleep(100);
+            continue;
+        }
+        v.done = live->done;
+        v.seconds = live->seconds;
+        v.rate = live->rate;
+        v.accesses = live->accesses;
+        v.bytes = live->bytes;
+        v.total_bytes = live->total_bytes;
+        memcpy(v.occupancy, live->occupancy, sizeof(v.occupancy));
+        memcpy(v.hit, live->hit, sizeof(v.hit));
+        memcpy(v.miss, live->miss, sizeof(v.miss));
+        atomic_thread_fence(memory_order_acquire);
+        if(live->seq.load(memory_order_relaxed) == seq)
+            return;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        printf("Usage: ./live [name] [-i milliseconds] [-s]\n");
+        exit(1);
+    }
+    char name[100];
+    sprintf(name, argv[1][0] == '/'? "%s":"/%s", argv[1]);
+    int interval = 1000;
+    bool per_slice = false;
+    for(int i = 2; i<argc; i++)
+    {
+        if(strcmp(argv[i], "-i") == 0 && i+1 < argc)
+            interval = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-s") == 0)
+            per_slice = true;
+    }
+
+    int fd;
+    bool waiting = false;
+    while((fd = shm_open(name, O_RDONLY, 0)) < 0)
+    {
+        if(errno != ENOENT)
+        {
+            printf("cannot open %s\n", name);
+            exit(1);
+        }
+        if(!waiting)
+            printf("waiting for %s\n", name);
+        waiting = true;
+        usleep(interval*1000);
+    }
+    const Live_page *live = (const Live_page *)mmap(NULL, sizeof(Live_page), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(live == MAP_FAILED)
+    {
+        printf("cannot map %s\n", name);
+        exit(1);
+    }
+    while(strnlen(live->magic, sizeof(live->magic)) < strlen(LIVE_MAGIC))    // not yet written
+        usleep(1000);
+    if(strncmp(live->magic, LIVE_MAGIC, sizeof(live->magic)) != 0)
+    {
+        printf("%s is a live page of another version (%.8s), rebuild live.cpp with the simulator\n", name, live->magic);
+        exit(1);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    printf("%s of %s (pid %d)\n", live->kind == 0? "cal_set_slice":"occupancy", live->name, live->pid);
+
+    Live_values v;
+    while(true)
+    {
+        Read(live, v);
+        unsigned long long hit = 0, miss = 0;
+        for(int i = 0; i<live->slices; i++)
+        {
+            hit += v.hit[i];
+            miss += v.miss[i];
+        }
+        printf("%9.1fs %14llu accesses %8.3f M/s (%.3f M/s on average) %6.2f%% of the traces, miss ratio %.4f",
+               v.seconds, v.accesses, v.rate/1e6, v.seconds > 0? v.accesses/v.seconds/1e6:0,
+               v.total_bytes > 0? 100.0*v.bytes/v.total_bytes:0, hit+miss > 0? (double)miss/(hit+miss):0);
+        if(live->kind == 1)
+            printf(", occupancy %d %d", v.occupancy[0], v.occupancy[1]);
+        printf("\n");
+        if(per_slice)
+            for(int i = 0; i<live->slices; i++)
+                printf("    %s %2d: %14llu hits %14llu misses, miss ratio %.4f\n", live->kind == 0? "slice":"benchmark",
+                       live->kind == 0? i:i+1, v.hit[i], v.miss[i], v.hit[i]+v.miss[i] > 0? (double)v.miss[i]/(v.hit[i]+v.miss[i]):0);
+        fflush(stdout);
+        if(v.done)
+            break;
+        if(kill(live->pid, 0) != 0 && errno == ESRCH)
+        {
+            printf("the run ended without finishing\n");
+            break;
+        }
+        usleep(interval*1000);
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * The live page of cal_set_slice.cpp and occupancy.cpp, read by live.cpp: the live statistics of a run in a shared
+ * memory object. The writer and the viewers are different programs, so they all include this layout, and a change
+ * of it must change LIVE_MAGIC, which the viewer checks.
+ */
+
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <atomic>
+#include <cstddef>
+
+#define LIVE_MAGIC "LIVE2"    // the layout version, written last by the writer
+#define LIVE_SLICES 64        // the slices published on the live page, occupancy.cpp uses 2
+
+struct Live_page
+{
+    char magic[8];    // LIVE_MAGIC
+    int kind;         // 0: cal_set_slice, 1: occupancy
+    int slices;       // the slices in hit/miss, or the 2 benchmarks
+    int pid;
+    char name[44];
+    // the counters of the only writer, on their own cache lines: a seqlock, seq is odd while they are updated
+    alignas(64) std::atomic<unsigned> seq;
+    int done;
+    double seconds, rate;    // since the start, and the accesses/s since the last update
+    unsigned long long accesses, bytes, total_bytes;    // bytes: read from the traces
+    int occupancy[2];
+    unsigned long long hit[LIVE_SLICES], miss[LIVE_SLICES];
+};
+
+static_assert(offsetof(Live_page, seq) == 64, "the counters of Live_page must start a cache line");
+static_assert(offsetof(Live_page, hit) == 120 && sizeof(Live_page) == 1152, "the layout of Live_page changed, change LIVE_MAGIC");
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * The node of the LRU lists of cal_set_slice.cpp (Cache_slice of cache_slice.h) and occupancy.cpp (Mirror_set of
+ * mirror_set.h): a way of a set, linked from the MRU to the LRU.
+ */
+
+#ifndef LRU_NODE_H
+#define LRU_NODE_H
+
+#include <cstddef>
+
+struct Node
+{
+    Node *pre;
+    Node *next;
+    int line_no;
+    unsigned long long tag;
+    Node(int a)
+    {
+        line_no = a;
+        pre = NULL;
+        next = NULL;
+    }
+};
+
+#endif
@@ -0,0 +1,305 @@
+/*
+ * This program merges the traces of N co-run benchmarks into one trace ordered by arrival time,
+ * instead of the fixed integer ratio of cal_set*.cpp or the random draws of occupancy.cpp.
+ * Two kinds of input are supported:
+ *   0: timestamped traces, every line of [benchmark].out is "timestamp address", the timestamps of a benchmark
+ *      must be non-decreasing;
+ *   1: per-interval rates, the addresses of [benchmark].out are spread evenly over the time intervals of
+ *      [benchmark]_formalized (the accesses of every interval, as occupancy.cpp uses), so fractional ratios
+ *      and phase changes are kept.
+ * The streams are read in batches and merged through a tournament (loser) tree, ties go to the smaller benchmark.
+ * Benchmark i (0~N-1) is marked by adding (N-1-i)<<53 to its addresses, so for two benchmarks the merged trace
+ * follows the same convention as cal_set*.cpp (benchmark1 + 1<<53) and can be simulated by
+ * "./cal_set_slice [output]".
+ * Usage: g++ -std=c++11 -O2 merge.cpp -o merge
+ *        ./merge [output] [benchmark1] [benchmark2] ... [benchmarkN]
+ * Input: follow the hints
+ * Output: the merged trace, saved as [output].out
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+using namespace std;
+
+#define MAX_BENCH 64
+#define BATCH 4096             // records of a stream decoded at a time
+#define BUFFER (1<<20)         // bytes read at a time
+int bench_num, mode;
+char outfilename[300];
+FILE *outfile;
+unsigned long long merged = 0;
+
+class Stream
+{
+public:
+    FILE *file, *perf_file;
+    char *buf;
+    int buf_len, buf_pos;
+    bool eof;
+    unsigned long long line_no, last_time;
+    unsigned long long marker;
+    unsigned long long time[BATCH], addr[BATCH];
+    int len, pos;
+    // per-interval rates
+    unsigned long long interval, in_interval, interval_num;
+
+    void Open(const char *benchname, int i);
+    bool Refill();
+    unsigned long long Key()    // the time of the next record, ~0 when finished
+    {
+        if(pos == len && !Refill())
+            return ~0ULL;
+        return time[pos];
+    }
+
+private:
+    bool Number(unsigned long long &value, bool &end_of_line);
+    bool Next_interval();
+};
+
+void Stream::Open(const char *benchname, int i)
+{
+    char filename[300];
+    sprintf(filename, "%s.out", benchname);
+    file = fopen(filename, "r");
+    if(file == NULL)
+    {
+        printf("cannot open %s\n", filename);
+        exit(1);
+    }
+    perf_file = NULL;
+    if(mode == 1)
+    {
+        sprintf(filename, "%s_formalized", benchname);
+        perf_file = fopen(filename, "r");
+        if(perf_file == NULL)
+        {
+            printf("cannot open %s\n", filename);
+            exit(1);
+        }
+        interval = 0;
+        in_interval = 0;
+        interval_num = 0;
+        if(!Next_interval())
+            interval_num = 0;
+    }
+    buf = new char[BUFFER];
+    buf_len = buf_pos = 0;
+    eof = false;
+    line_no = 0;
+    last_time = 0;
+    marker = (unsigned long long)(bench_num-1-i) << 53;
+    len = pos = 0;
+}
+
+bool Stream::Next_interval()    // move to the next non-empty interval
+{
+    char tmp[100];
+    while(fgets(tmp, 99, perf_file) != NULL)
+    {
+        interval_num = strtoull(tmp, NULL, 10);
+        in_interval = 0;
+        if(interval_num > 0)
+            return true;
+        interval++;
+    }
+    return false;
+}
+
+// parse the next decimal number, skipping spaces; end_of_line is set when a newline follows it
+bool Stream::Number(unsigned long long &value, bool &end_of_line)
+{
+    value = 0;
+    bool digits = false;
+    end_of_line = false;
+    while(true)
+    {
+        if(buf_pos == buf_len)
+        {
+            if(eof)
+                return digits;
+            buf_len = fread(buf, 1, BUFFER, file);
+            buf_pos = 0;
+            if(buf_len == 0)
+            {
+                eof = true;
+                return digits;
+            }
+        }
+        char c = buf[buf_pos];
+        if(c >= '0' && c <= '9')
+        {
+            value = value*10 + (c-'0');
+            digits = true;
+            buf_pos++;
+        }
+        else if(digits)
+        {
+            end_of_line = c == '\n';
+            buf_pos++;
+            return true;
+        }
+        else
+            buf_pos++;    // leading spaces and empty lines
+    }
+}
+
+bool Stream::Refill()
+{
+    len = pos = 0;
+    bool end_of_line;
+    while(len < BATCH)
+    {
+        unsigned long long a, t;
+        if(mode == 0)
+        {
+            if(!Number(t, end_of_line))
+                break;
+            line_no++;
+            if(end_of_line || !Number(a, end_of_line))
+            {
+                printf("line %llu: the address is missing\n", line_no);
+                exit(1);
+            }
+            if(t < last_time)
+            {
+                printf("line %llu: the timestamp decreases\n", line_no);
+                exit(1);
+            }
+            last_time = t;
+        }
+        else
+        {
+            if(interval_num == 0 || !Number(a, end_of_line))
+                break;
+            // access j of the k accesses in interval t arrives at t + (j+0.5)/k, in 32-bit fixed point
+            t = (interval << 32) + (((2*in_interval+1) << 31) / interval_num);
+            in_interval++;
+            if(in_interval == interval_num)
+            {
+                interval++;
+                if(!Next_interval())
+                    interval_num = 0;
+            }
+        }
+        time[len] = t;
+        addr[len] = a + marker;
+        len++;
+    }
+    return len > 0;
+}
+
+Stream *streams;
+vector<int> loser;    // loser[0] is the winner, loser[1~N-1] are the losers of the internal nodes
+
+bool Before(int a, int b)    // stream a goes before stream b
+{
+    unsigned long long ka = streams[a].Key(), kb = streams[b].Key();
+    return ka < kb || (ka == kb && a < b);
+}
+
+void Build()
+{
+    // winner[node] of the subtree, leaves are nodes N~2N-1
+    vector<int> winner(2*bench_num);
+    for(int i = 0; i<bench_num; i++)
+        winner[bench_num+i] = i;
+    loser.assign(bench_num, 0);
+    for(int node = bench_num-1; node>0; node--)
+    {
+        int l = winner[2*node], r = winner[2*node+1];
+        if(Before(l, r))
+        {
+            winner[node] = l;
+            loser[node] = r;
+        }
+        else
+        {
+            winner[node] = r;
+            loser[node] = l;
+        }
+    }
+    loser[0] = bench_num > 1? winner[1]:0;
+}
+
+void Replay(int s)    // the key of stream s (the last winner) changed, replay its path to the root
+{
+    int winner = s;
+    for(int node = (bench_num+s)/2; node>0; node /= 2)
+        if(Before(loser[node], winner))
+        {
+            int tmp = loser[node];
+            loser[node] = winner;
+            winner = tmp;
+        }
+    loser[0] = winner;
+}
+
+int main(int argc, char *argv[])
+{
+    bench_num = argc - 2;
+    if(bench_num < 1 || bench_num > MAX_BENCH)
+    {
+        printf("Usage: ./merge [output] [benchmark1] ... [benchmarkN]\n");
+        exit(1);
+    }
+    printf("please input the kind of input(0: timestamped traces, 1: per-interval rates): ");
+    scanf("%d", &mode);
+    sprintf(outfilename, "%s.out", argv[1]);
+    outfile = fopen(outfilename, "w");
+    if(outfile == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+
+    streams = new Stream[bench_num];
+    for(int i = 0; i<bench_num; i++)
+        streams[i].Open(argv[i+2], i);
+
+    clock_t start = clock();
+    char *out = new char[BUFFER+32];
+    int out_len = 0;
+    Build();
+    while(true)
+    {
+        int s = loser[0];
+        if(streams[s].Key() == ~0ULL)    // the winner is finished, so are all the others
+            break;
+        // print the address
+        unsigned long long a = streams[s].addr[streams[s].pos++];
+        char digits[24];
+        int n = 0;
+        do
+        {
+            digits[n++] = '0' + a%10;
+            a /= 10;
+        } while(a > 0);
+        while(n > 0)
+            out[out_len++] = digits[--n];
+        out[out_len++] = '\n';
+        if(out_len >= BUFFER)
+        {
+            fwrite(out, 1, out_len, outfile);
+            out_len = 0;
+        }
+        merged++;
+        if(bench_num > 1)
+            Replay(s);
+    }
+    fwrite(out, 1, out_len, outfile);
+    double seconds = (double)(clock()-start) / CLOCKS_PER_SEC;
+
+    fclose(outfile);
+    for(int i = 0; i<bench_num; i++)
+    {
+        fclose(streams[i].file);
+        if(streams[i].perf_file != NULL)
+            fclose(streams[i].perf_file);
+    }
+    printf("%llu accesses merged in %.3fs\n", merged, seconds);
+    return 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * The set of occupancy.cpp and of the replicas of occupancy_mc.cpp, which oracle.cpp checks against the reference:
+ * benchmark1 owns the ways 0~end_way1 and benchmark2 the ways begin_way2~ways-1, every benchmark has an
+ * LRU list of its ways, and a line in the overlapping ways is in both lists, so an access to it refreshes both.
+ * Benchmark1 fills its empty ways from way 0 up, benchmark2 from way ways-1 down, and a victim of the other
+ * benchmark moves one way of occupancy. A repeat of the last line accessed (last_tag) is a hit on the MRU line and
+ * skips the lookup. The tags keep the marker of benchmark1 (1 << 53 of the address), above marker_shift.
+ */
+
+#ifndef MIRROR_SET_H
+#define MIRROR_SET_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include "lru_node.h"
+
+class Mirror_set
+{
+public:
+    int begin_way1, end_way1, begin_way2, end_way2;
+    Node *head1, *tail1, *head2, *tail2;
+    std::unordered_map<unsigned long long, int> tag_line_no1, tag_line_no2;
+    std::unordered_map<int, Node*> line_no_ptr1, line_no_ptr2;
+    int occupancy1, occupancy2;
+    unsigned long long last_tag;    // the tag of the last access, i.e. the MRU line of the set
+    int marker_shift;               // 53-set_bits-block_bits
+
+    void Init(int ways, int e1, int b2, int shift);
+    void Free();
+    bool Belong1(unsigned long long tag) { return (tag >> marker_shift) == 1; }
+    void Refresh1(int line_no_tmp);
+    void Refresh2(int line_no_tmp);
+    bool Access1(unsigned long long tag);
+    bool Access2(unsigned long long tag);
+};
+
+void Mirror_set::Init(int ways, int e1, int b2, int shift)
+{
+    begin_way1 = 0;
+    end_way1 = e1;
+    begin_way2 = b2;
+    end_way2 = ways-1;
+    occupancy1 = occupancy2 = 0;
+    last_tag = ~0ULL;
+    marker_shift = shift;
+
+    // benchmark1
+    Node *tmp_pre = NULL, *tmp_next = NULL;
+    head1 = new Node(begin_way1);
+    tmp_pre = head1;
+    for(int i = begin_way1+1; i<=end_way1; i++)
+    {
+        tmp_next = new Node(i);
+        tmp_pre->next = tmp_next;
+        tmp_next->pre = tmp_pre;
+        tmp_pre = tmp_next;
+    }
+    tail1 = tmp_pre;
+
+    Node *tmp = head1;
+    for(int i = begin_way1; i<=end_way1; i++)
+    {
+        line_no_ptr1.insert(std::make_pair(i, tmp));
+        tmp = tmp->next;
+    }
+
+    // benchmark2
+    tmp_pre = NULL;
+    tmp_next = NULL;
+    head2 = new Node(end_way2);
+    tmp_pre = head2;
+    for(int i = end_way2-1; i>=begin_way2; i--)
+    {
+        tmp_next = new Node(i);
+        tmp_pre->next = tmp_next;
+        tmp_next->pre = tmp_pre;
+        tmp_pre = tmp_next;
+    }
+    tail2 = tmp_pre;
+
+    tmp = head2;
+    for(int i = end_way2; i>=begin_way2; i--)
+    {
+        line_no_ptr2.insert(std::make_pair(i, tmp));
+        tmp = tmp->next;
+    }
+}
+
+void Mirror_set::Free()
+{
+    for(Node *p = head1; p != NULL; )
+    {
+        Node *next = p->next;
+        delete p;
+        p = next;
+    }
+    for(Node *p = head2; p != NULL; )
+    {
+        Node *next = p->next;
+        delete p;
+        p = next;
+    }
+    tag_line_no1.clear();
+    tag_line_no2.clear();
+    line_no_ptr1.clear();
+    line_no_ptr2.clear();
+}
+
+void Mirror_set::Refresh1(int line_no_tmp)
+{
+    if(line_no_tmp > end_way1 || line_no_tmp < begin_way1)
+    {
+        printf("Refresh1 error\n");
+        exit(1);
+    }
+    Node *tmp = line_no_ptr1[line_no_tmp];
+    if(head1 != tmp)
+    {
+        if(tmp->pre != NULL)
+            tmp->pre->next = tmp->next;
+        if(tmp->next != NULL)
+            tmp->next->pre = tmp->pre;
+        if(tail1 == tmp)
+            tail1 = tmp->pre;
+        tmp->next = head1;
+        head1->pre = tmp;
+        tmp->pre = NULL;
+        head1 = tmp;
+    }
+    return;
+}
+
+void Mirror_set::Refresh2(int line_no_tmp)
+{
+    if(line_no_tmp > end_way2 || line_no_tmp < begin_way2)
+    {
+        printf("Refresh2 error\n");
+        exit(1);
+    }
+    Node *tmp = line_no_ptr2[line_no_tmp];
+    if(head2 != tmp)
+    {
+        if(tmp->pre != NULL)
+            tmp->pre->next = tmp->next;
+        if(tmp->next != NULL)
+            tmp->next->pre = tmp->pre;
+        if(tail2 == tmp)
+            tail2 = tmp->pre;
+        tmp->next = head2;
+        head2->pre = tmp;
+        tmp->pre = NULL;
+        head2 = tmp;
+    }
+    return;
+}
+
+bool Mirror_set::Access1(unsigned long long tag)    // an access of benchmark1, tag with the marker; true when hit
+{
+    bool hit = true;
+    if(tag == last_tag)    // a hit on the MRU line changes nothing
+    {
+    }
+    else if(tag_line_no1.find(tag) != tag_line_no1.end()) // found
+    {
+        int line_no = tag_line_no1[tag];
+        Refresh1(line_no);
+        if(line_no >= begin_way2)
+            Refresh2(line_no);
+    }
+    else    // not found
+    {
+        hit = false;
+        if((int)tag_line_no1.size() < (end_way1-begin_way1)+1)   // not full
+        {
+            int allocated_line_no = occupancy1;
+            tag_line_no1[tag] = allocated_line_no;
+            Node* tmp = line_no_ptr1[allocated_line_no];
+            tmp->tag = tag;
+            Refresh1(allocated_line_no);
+            occupancy1++;
+            if(allocated_line_no >= begin_way2)
+            {
+                tag_line_no2[tag] = allocated_line_no;
+                tmp = line_no_ptr2[allocated_line_no];
+                tmp->tag = tag;
+                Refresh2(allocated_line_no);
+            }
+        }
+        else // full
+        {
+            int line_no = tail1->line_no;
+            unsigned long long oldtag = tail1->tag;
+            tag_line_no1.erase(oldtag);
+            tag_line_no1[tag] = line_no;
+            tail1->tag = tag;
+            Refresh1(line_no);
+            if(line_no >= begin_way2)
+            {
+                Node* tmp = line_no_ptr2[line_no];
+                tag_line_no2.erase(oldtag);
+                tag_line_no2[tag] = line_no;
+                tmp->tag = tag;
+                Refresh2(line_no);
+            }
+            if(!Belong1(oldtag))
+            {
+                occupancy1++;
+                occupancy2--;
+            }
+        }
+    }
+    last_tag = tag;
+    return hit;
+}
+
+bool Mirror_set::Access2(unsigned long long tag)    // an access of benchmark2; true when hit
+{
+    bool hit = true;
+    if(tag == last_tag)    // a hit on the MRU line changes nothing
+    {
+    }
+    else if(tag_line_no2.find(tag) != tag_line_no2.end()) // found
+    {
+        int line_no = tag_line_no2[tag];
+        Refresh2(line_no);
+        if(line_no <= end_way1)
+            Refresh1(line_no);
+    }
+    else    // not found
+    {
+        hit = false;
+        if((int)tag_line_no2.size() < (end_way2-begin_way2)+1)   // not full
+        {
+            int allocated_line_no = end_way2-occupancy2;
+            tag_line_no2[tag] = allocated_line_no;
+            Node* tmp = line_no_ptr2[allocated_line_no];
+            tmp->tag = tag;
+            Refresh2(allocated_line_no);
+            occupancy2++;
+            if(allocated_line_no <= end_way1)
+            {
+                tag_line_no1[tag] = allocated_line_no;
+                tmp = line_no_ptr1[allocated_line_no];
+                tmp->tag = tag;
+                Refresh1(allocated_line_no);
+            }
+        }
+        else // full
+        {
+            int line_no = tail2->line_no;
+            unsigned long long oldtag = tail2->tag;
+            tag_line_no2.erase(oldtag);
+            tag_line_no2[tag] = line_no;
+            tail2->tag = tag;
+            Refresh2(line_no);
+            if(line_no <= end_way1)
+            {
+                Node* tmp = line_no_ptr1[line_no];
+                tag_line_no1.erase(oldtag);
+                tag_line_no1[tag] = line_no;
+                tmp->tag = tag;
+                Refresh1(line_no);
+            }
+            if(Belong1(oldtag))
+            {
+                occupancy1--;
+                occupancy2++;
+            }
+        }
+    }
+    last_tag = tag;
+    return hit;
+}
+
+#endif
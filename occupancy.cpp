@@ -5,10 +5,27 @@
  * The simulator supports overlapping cache allocation, as intel CAT does.
  * This version considerates access phased-change of benchmarks during running.
  * Cache allocation requirement: benchmark1 begins with way0 while benchmark2 ends with way(ways-1). 
+ * When [benchmark]_[slice_no]_[set_no].out does not exist, [benchmark]_[slice_no]_[set_no].rle collapsed by collapse.cpp
+ * is read, or else the traces of the set are gathered from [benchmark].bin through the per-set index [benchmark].idx
+ * built by index.cpp. The set is a Mirror_set of mirror_set.h, where a repeat of the last line accessed is a hit on
+ * the MRU line and skips the lookup.
+ * The random draws of time interval i are seeded by seed+i, where seed is the time at the start.
+ * Checkpoint: with "-c [intervals]", the complete state (both lists with their tags, the occupancies, the counters,
+ * the offsets of the traces and of the outputs, and the seed) is saved to
+ * [benchmark1]_[benchmark2]_[slice_no]_[set_no]_[overlap].ckpt every [intervals] time intervals, built in memory and
+ * written with one sequential write to a temporary file which then replaces the old one.
+ * With "-r [snapshot]", the run resumes from the snapshot (mmaped) with the same draws as if it never stopped,
+ * the outputs are cut back to where the snapshot was saved and continued.
+ * Live page: with "-L [name]", the accesses, the bytes read of the traces, the hits and misses of both benchmarks,
+ * the occupancies and the accesses/s are published at the end of every time interval in the shared memory object
+ * [name], which live.cpp prints while the run goes on (see Live_page of live.h). The hits and misses
+ * are counted from the start of this process, also after resuming.
  * Usage: g++ -std=c++11 occupancy.cpp -o occupancy
- *        ./occupancy [benchmark1] [benchmark2]
+ *        ./occupancy [benchmark1] [benchmark2] [-c intervals] [-r snapshot] [-T] [-L live_page]
  * Input: follow the hints
- * Output: the occupancies of benchmark1 and benchmark2, saved as 
+ * Output: the occupancies of benchmark1 and benchmark2 every step, saved as [benchmark1]_[benchmark2]_[slice_no]_[set_no]_[overlap].npy,
+ *         an int32 array of [steps][2] for numpy.load (mmap_mode='r' reads it without parsing), whose shape is
+ *         written at the end; with "-T", as text, saved as
  *         [benchmark1]_[benchmark2]_[slice_no]_[set_no]_[overlap]_1 and [benchmark1]_[benchmark2]_[slice_no]_[set_no]_[overlap]_2 
  * Author: Jack Wang
  * Date: 2019.11.19
@@ -18,176 +35,388 @@
 #include <cstring>
 #include <cstdlib>
 #include <unordered_map>
+#include <atomic>
 #include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "live.h"
+#include "mirror_set.h"
+#include "set_reader.h"
 using namespace std;
 char benchname1[100], benchname2[100];
 char perf_filename1[100], perf_filename2[100];
 char filename1[100], filename2[100], outfilename1[100], outfilename2[100];
-FILE *file1, *file2, *perf_file1, *perf_file2, *outfile1, *outfile2;
+FILE *perf_file1, *perf_file2, *outfile1, *outfile2;
 int slices = 8, set_bits = 11, block_bits = 6, ways = 10;
 int step;    // the step of printing
 unsigned long long count = 0, addr1, addr2;
-int occupancy1 = 0, occupancy2 = 0; 
 int overlap;  // the number of overlapping ways
 int begin_way1 = 0, end_way1, begin_way2, end_way2 = ways-1;
 unsigned long long chosen_set_no;
 int chosen_slice_no;
+unsigned seed;                          // the draws of time interval i are seeded by seed+i
+unsigned long long interval_no = 0;
+int checkpoint = 0;                     // time intervals between two snapshots, 0 for none
+char snapshot_filename[200], resume_filename[200];
+bool text = false;                      // "-T", the occupancies as two text files instead of a .npy
+unsigned long long access_count[2], miss_count[2];    // of benchmark1 and benchmark2 in this run, for the live page
 #define SETS 2048    // 2^set_bits
+#define NPY_HEADER 128
 
-struct Node
-{
-    Node *pre;
-    Node *next;
-    int line_no;
-    unsigned long long tag;
-    Node(int a) 
-    {
-        line_no = a;
-        pre = NULL;
-        next = NULL;
-    }
-};
+Mirror_set cache;    // the set, see mirror_set.h
 
-Node *head1, *tail1;
-unordered_map<unsigned long long, int> tag_line_no1;
-unordered_map<int, Node*> line_no_ptr1;
-Node *head2, *tail2;
-unordered_map<unsigned long long, int> tag_line_no2;
-unordered_map<int, Node*> line_no_ptr2;
+Set_reader reader1, reader2;
 
-bool belong(unsigned long long tag)     // addr belongs to benchmark1
+// the header of a .npy file (format version 1.0) of little-endian [descr] values, NPY_HEADER bytes, so that it can be
+// rewritten in place when the rows are known; columns 0 for a 1-D array
+void Write_npy_header(FILE *file, const char *descr, unsigned long long rows, int columns)
 {
-    if((tag>>(53-set_bits-block_bits)) == 1)
-        return true;
-    else
-        return false;
+    char header[NPY_HEADER];
+    memset(header, ' ', sizeof(header));
+    memcpy(header, "\x93NUMPY\x01\x00\x76\x00", 10);    // 118 bytes of the dict
+    int len = columns > 0? sprintf(header+10, "{'descr': '%s', 'fortran_order': False, 'shape': (%llu, %d), }", descr, rows, columns):
+                           sprintf(header+10, "{'descr': '%s', 'fortran_order': False, 'shape': (%llu,), }", descr, rows);
+    header[10+len] = ' ';
+    header[NPY_HEADER-1] = '\n';
+    fwrite(header, 1, sizeof(header), file);
 }
 
-void Init()
+void Output_step()
 {
-    // benchmark1
-    Node *tmp_pre = NULL, *tmp_next = NULL;
-    head1 = new Node(begin_way1);
-    tmp_pre = head1;
-    for(int i = begin_way1+1; i<=end_way1; i++)
+    if(text)
     {
-        tmp_next = new Node(i);
-        tmp_pre->next = tmp_next;
-        tmp_next->pre = tmp_pre;
-        tmp_pre = tmp_next;
+        fprintf(outfile1, "%d\n", cache.occupancy1);
+        fprintf(outfile2, "%d\n", cache.occupancy2);
+        return;
     }
-    tail1 = tmp_pre;
+    int occupancy[2] = {cache.occupancy1, cache.occupancy2};    // a row of [steps][2]
+    fwrite(occupancy, sizeof(int), 2, outfile1);
+}
 
-    Node *tmp = head1;
-    for(int i = begin_way1; i<=end_way1; i++)
-    {
-        line_no_ptr1.insert(make_pair(i, tmp));
-        tmp = tmp->next;
-    }
+char live_name[100];    // "-L", the shared memory object, none when empty
+Live_page *live;
+unsigned long long last_live_count = 0;
+double live_start, last_live_time;
 
-    // benchmark2
-    tmp_pre = NULL;
-    tmp_next = NULL;
-    head2 = new Node(end_way2);
-    tmp_pre = head2;
-    for(int i = end_way2-1; i>=begin_way2; i--)
-    {
-        tmp_next = new Node(i);
-        tmp_pre->next = tmp_next;
-        tmp_next->pre = tmp_pre;
-        tmp_pre = tmp_next;
-    }
-    tail2 = tmp_pre;
+double Now()
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+}
 
-    tmp = head2;
-    for(int i = end_way2; i>=begin_way2; i--)
+unsigned long long Reader_bytes(Set_reader &reader, bool total)    // read, or all the bytes of the traces of the set
+{
+    if(reader.file != NULL)
     {
-        line_no_ptr2.insert(make_pair(i, tmp));
-        tmp = tmp->next;
+        struct stat st;
+        return !total? ftell(reader.file):fstat(fileno(reader.file), &st) == 0? st.st_size:0;
     }
+    return total? reader.data_end - reader.data_begin:reader.data - reader.data_begin;    // of the position list
 }
 
-void Refresh1(int line_no_tmp)
+void Open_live(const char *name)
 {
-    if(line_no_tmp > end_way1 || line_no_tmp < begin_way1)
+    int fd = shm_open(live_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if(fd < 0 || ftruncate(fd, sizeof(Live_page)) != 0 ||
+       (live = (Live_page *)mmap(NULL, sizeof(Live_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
     {
-        printf("Refresh1 error\n");
+        printf("cannot create the live page %s\n", live_name);
         exit(1);
     }
-    Node *tmp = line_no_ptr1[line_no_tmp];
-    if(head1 != tmp)
-    {
-        if(tmp->pre != NULL)
-            tmp->pre->next = tmp->next;
-        if(tmp->next != NULL)
-            tmp->next->pre = tmp->pre;
-        if(tail1 == tmp)
-            tail1 = tmp->pre;
-        tmp->next = head1;
-        head1->pre = tmp;
-        tmp->pre = NULL;
-        head1 = tmp;
-    }
-    return;
+    close(fd);
+    live->kind = 1;
+    live->slices = 2;
+    live->pid = getpid();
+    snprintf(live->name, sizeof(live->name), "%s", name);
+    live->total_bytes = Reader_bytes(reader1, true) + Reader_bytes(reader2, true);
+    atomic_thread_fence(memory_order_release);
+    strcpy(live->magic, LIVE_MAGIC);    // the last, the viewer waits for it
+    live_start = last_live_time = Now();
+    last_live_count = count;
 }
 
-void Refresh2(int line_no_tmp)
+void Update_live(bool done)    // at the end of a time interval
 {
-    if(line_no_tmp > end_way2 || line_no_tmp < begin_way2)
+    double now = Now();
+    unsigned seq = live->seq.load(memory_order_relaxed);
+    live->seq.store(seq+1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    live->seconds = now - live_start;
+    if(count > last_live_count && now > last_live_time)    // kept when nothing is new, e.g. at the end
     {
-        printf("Refresh2 error\n");
-        exit(1);
+        live->rate = (count - last_live_count)/(now - last_live_time);
+        last_live_time = now;
+        last_live_count = count;
     }
-    Node *tmp = line_no_ptr2[line_no_tmp];
-    if(head2 != tmp)
+    live->accesses = count;
+    live->bytes = Reader_bytes(reader1, false) + Reader_bytes(reader2, false);
+    live->occupancy[0] = cache.occupancy1;
+    live->occupancy[1] = cache.occupancy2;
+    for(int k = 0; k<2; k++)
     {
-        if(tmp->pre != NULL)
-            tmp->pre->next = tmp->next;
-        if(tmp->next != NULL)
-            tmp->next->pre = tmp->pre;
-        if(tail2 == tmp)
-            tail2 = tmp->pre;
-        tmp->next = head2;
-        head2->pre = tmp;
-        tmp->pre = NULL;
-        head2 = tmp;
+        live->hit[k] = access_count[k] - miss_count[k];
+        live->miss[k] = miss_count[k];
     }
-    return;
+    live->done = done;
+    live->seq.store(seq+2, memory_order_release);
+}
+
+void Close_live()
+{
+    Update_live(true);
+    munmap(live, sizeof(Live_page));
+    shm_unlink(live_name);    // the viewers keep their mappings
 }
 
 void Start()
 {
-    file1 = fopen(filename1, "r");
-    file2 = fopen(filename2, "r");
+    bool open1 = reader1.Open(filename1, benchname1, slices, SETS, chosen_slice_no, chosen_set_no);
+    bool open2 = reader2.Open(filename2, benchname2, slices, SETS, chosen_slice_no, chosen_set_no);
     perf_file1 = fopen(perf_filename1, "r");
     perf_file2 = fopen(perf_filename2, "r");
-    outfile1 = fopen(outfilename1, "w");
-    outfile2 = fopen(outfilename2, "w");
-    if(file1 == NULL || file2 == NULL || perf_file1 == NULL || perf_file2 == NULL ||
-    outfile1 == NULL || outfile2 == NULL)
+    outfile1 = resume_filename[0] != 0? fopen(outfilename1, "r+"):NULL;    // continued after resuming
+    outfile2 = resume_filename[0] != 0 && text? fopen(outfilename2, "r+"):NULL;
+    if(outfile1 == NULL)
+    {
+        outfile1 = fopen(outfilename1, "w");
+        if(!text && outfile1 != NULL)
+            Write_npy_header(outfile1, "<i4", 0, 2);    // rewritten by Finish()
+    }
+    if(outfile2 == NULL && text)
+        outfile2 = fopen(outfilename2, "w");
+    if(!open1 || !open2 || perf_file1 == NULL || perf_file2 == NULL ||
+    outfile1 == NULL || (text && outfile2 == NULL))
     {
         printf("cannot open all the files\n");
         exit(1);
     }
 
-    Init();
+    cache.Init(ways, end_way1, begin_way2, 53-set_bits-block_bits);
 
     return;
 }
 
 void Finish()
 {
-    fclose(file1);
-    fclose(file2);
+    reader1.Close();
+    reader2.Close();
     fclose(perf_file1);
     fclose(perf_file2);
+    if(!text)
+    {
+        fseek(outfile1, 0, SEEK_END);
+        unsigned long long rows = (ftell(outfile1) - NPY_HEADER) / (2*sizeof(int));
+        fseek(outfile1, 0, SEEK_SET);
+        Write_npy_header(outfile1, "<i4", rows, 2);
+    }
     fclose(outfile1);
-    fclose(outfile2);
+    if(outfile2 != NULL)
+        fclose(outfile2);
     return;
 }
 
+struct Snapshot_header
+{
+    char magic[8];    // "OCKPT1"
+    int slice_no, set_no, ways, end_way1, begin_way2;
+    unsigned seed;
+    unsigned long long interval_no, count, last_tag;
+    int occupancy1, occupancy2;
+    Reader_state reader[2];
+    unsigned long long perf_offset[2], out_offset[2];
+    unsigned long long map_size1, map_size2;
+};
+// followed by the (line_no, tag) of the nodes of list1 and list2 from the head to the tail,
+// then the (tag, line_no) of tag_line_no1 and tag_line_no2
+
+unsigned long long *Save_list(unsigned long long *p, Node *head)
+{
+    for(Node *tmp = head; tmp != NULL; tmp = tmp->next)
+    {
+        *p++ = tmp->line_no;
+        *p++ = tmp->tag;
+    }
+    return p;
+}
+
+unsigned long long *Save_map(unsigned long long *p, unordered_map<unsigned long long, int> &tag_line_no)
+{
+    for(auto it = tag_line_no.begin(); it != tag_line_no.end(); it++)
+    {
+        *p++ = it->first;
+        *p++ = it->second;
+    }
+    return p;
+}
+
+const unsigned long long *Load_list(const unsigned long long *p, int n, Node *&head, Node *&tail,
+                                    unordered_map<int, Node*> &line_no_ptr)
+{
+    Node *pre = NULL;
+    for(int i = 0; i<n; i++)
+    {
+        Node *tmp = line_no_ptr[p[0]];
+        tmp->tag = p[1];
+        tmp->pre = pre;
+        if(pre == NULL)
+            head = tmp;
+        else
+            pre->next = tmp;
+        pre = tmp;
+        p += 2;
+    }
+    pre->next = NULL;
+    tail = pre;
+    return p;
+}
+
+const unsigned long long *Load_map(const unsigned long long *p, unsigned long long n,
+                                   unordered_map<unsigned long long, int> &tag_line_no)
+{
+    tag_line_no.clear();
+    for(unsigned long long i = 0; i<n; i++)
+    {
+        tag_line_no[p[0]] = p[1];
+        p += 2;
+    }
+    return p;
+}
+
+size_t Snapshot_size(unsigned long long map_size1, unsigned long long map_size2)
+{
+    int nodes = (end_way1-begin_way1+1) + (end_way2-begin_way2+1);
+    return sizeof(Snapshot_header) + (nodes + map_size1 + map_size2)*2*sizeof(unsigned long long);
+}
+
+void Save_snapshot()    // at the end of a time interval
+{
+    size_t size = Snapshot_size(cache.tag_line_no1.size(), cache.tag_line_no2.size());
+    char *buf = new char[size]();
+    Snapshot_header *header = (Snapshot_header *)buf;
+    strcpy(header->magic, "OCKPT1");
+    header->slice_no = chosen_slice_no;
+    header->set_no = chosen_set_no;
+    header->ways = ways;
+    header->end_way1 = end_way1;
+    header->begin_way2 = begin_way2;
+    header->seed = seed;
+    header->interval_no = interval_no;
+    header->count = count;
+    header->last_tag = cache.last_tag;
+    header->occupancy1 = cache.occupancy1;
+    header->occupancy2 = cache.occupancy2;
+    reader1.Save(header->reader[0]);
+    reader2.Save(header->reader[1]);
+    header->perf_offset[0] = ftell(perf_file1);
+    header->perf_offset[1] = ftell(perf_file2);
+    fflush(outfile1);
+    header->out_offset[0] = ftell(outfile1);
+    if(outfile2 != NULL)
+    {
+        fflush(outfile2);
+        header->out_offset[1] = ftell(outfile2);
+    }
+    header->map_size1 = cache.tag_line_no1.size();
+    header->map_size2 = cache.tag_line_no2.size();
+    unsigned long long *p = (unsigned long long *)(header+1);
+    p = Save_list(p, cache.head1);
+    p = Save_list(p, cache.head2);
+    p = Save_map(p, cache.tag_line_no1);
+    p = Save_map(p, cache.tag_line_no2);
+
+    char tmp[220];
+    sprintf(tmp, "%s.tmp", snapshot_filename);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 || write(fd, buf, size) != (ssize_t)size || fsync(fd) != 0 || close(fd) != 0 ||
+       rename(tmp, snapshot_filename) != 0)
+    {
+        printf("cannot save the snapshot %s\n", snapshot_filename);
+        exit(1);
+    }
+    delete []buf;
+}
+
+void Load_snapshot()
+{
+    size_t size;
+    const Snapshot_header *header = (const Snapshot_header *)Map_file(resume_filename, size);
+    if(header == NULL || size < sizeof(Snapshot_header) || strcmp(header->magic, "OCKPT1") != 0 ||
+       size != Snapshot_size(header->map_size1, header->map_size2) || header->slice_no != chosen_slice_no ||
+       header->set_no != (int)chosen_set_no || header->ways != ways || header->end_way1 != end_way1 ||
+       header->begin_way2 != begin_way2)
+    {
+        printf("%s does not match the set or the allocation\n", resume_filename);
+        exit(1);
+    }
+    seed = header->seed;
+    interval_no = header->interval_no;
+    count = header->count;
+    cache.last_tag = header->last_tag;
+    cache.occupancy1 = header->occupancy1;
+    cache.occupancy2 = header->occupancy2;
+    if(!reader1.Load(header->reader[0]) || !reader2.Load(header->reader[1]))
+    {
+        printf("%s was saved from another kind of trace (.out, .rle or .idx)\n", resume_filename);
+        exit(1);
+    }
+    fseek(perf_file1, header->perf_offset[0], SEEK_SET);
+    fseek(perf_file2, header->perf_offset[1], SEEK_SET);
+    FILE *outfile[2] = {outfile1, outfile2};    // outfile2 is NULL for a .npy
+    bool shorter = false;
+    for(int k = 0; k<2; k++)
+        if(outfile[k] != NULL)
+        {
+            fseek(outfile[k], 0, SEEK_END);
+            shorter = shorter || (unsigned long long)ftell(outfile[k]) < header->out_offset[k];
+        }
+    if(shorter)
+        printf("the outputs are shorter than the snapshot, only the rest of the run is kept\n");
+    else
+    for(int k = 0; k<2; k++)
+        if(outfile[k] != NULL)
+        {
+            fflush(outfile[k]);
+            if(ftruncate(fileno(outfile[k]), header->out_offset[k]) != 0)
+            {
+                printf("cannot cut the outputs\n");
+                exit(1);
+            }
+            fseek(outfile[k], header->out_offset[k], SEEK_SET);
+        }
+    const unsigned long long *p = (const unsigned long long *)(header+1);
+    p = Load_list(p, end_way1-begin_way1+1, cache.head1, cache.tail1, cache.line_no_ptr1);
+    p = Load_list(p, end_way2-begin_way2+1, cache.head2, cache.tail2, cache.line_no_ptr2);
+    p = Load_map(p, header->map_size1, cache.tag_line_no1);
+    p = Load_map(p, header->map_size2, cache.tag_line_no2);
+    munmap((void *)header, size);
+}
+
 int main(int argc, char *argv[])
 {
+    if(argc < 3)
+    {
+        printf("Usage: ./occupancy [benchmark1] [benchmark2] [-c intervals] [-r snapshot] [-T] [-L live_page]\n");
+        exit(1);
+    }
+    for(int i = 3; i<argc; i++)
+    {
+        if(strcmp(argv[i], "-c") == 0 && i+1 < argc)
+            checkpoint = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-r") == 0 && i+1 < argc)
+            strcpy(resume_filename, argv[++i]);
+        else if(strcmp(argv[i], "-T") == 0)
+            text = true;
+        else if(strcmp(argv[i], "-L") == 0 && i+1 < argc)
+        {
+            i++;
+            sprintf(live_name, argv[i][0] == '/'? "%s":"/%s", argv[i]);    // a name of shm_open
+        }
+    }
+    seed = (unsigned)time(NULL);
+
     printf("please input slice number(0~%d): ", slices-1);
     scanf("%d", &chosen_slice_no);
     printf("please input set number(0~%d): ", SETS-1);
@@ -236,11 +465,24 @@ int main(int argc, char *argv[])
     strcat(outfilename1, "_1");
     strcat(outfilename2, "_2");
 
+    strcpy(snapshot_filename, outfilename1);
+    strcpy(snapshot_filename+strlen(snapshot_filename)-2, ".ckpt");
+    if(!text)
+        strcpy(outfilename1+strlen(outfilename1)-2, ".npy");
+
     Start();
+    if(resume_filename[0] != 0)
+        Load_snapshot();
+    if(live_name[0] != 0)
+    {
+        char name[200];
+        strcpy(name, outfilename1);
+        name[strlen(name)-(text? 2:4)] = 0;    // without _1 or .npy
+        Open_live(name);
+    }
 
     char tmp_perf1[100], tmp_perf2[100];
     unsigned long long access_num1, access_num2;
-    char tmp_addr1[100], tmp_addr2[100];
     while(fgets(tmp_perf1, 99, perf_file1) != NULL && fgets(tmp_perf2, 99, perf_file2) != NULL)
     {
         access_num1 = strtoull(tmp_perf1, NULL, 10);
@@ -252,23 +494,19 @@ int main(int argc, char *argv[])
         int k = 0;
         for(k;k<access_num1;k++)
         {
-            if(fgets(tmp_addr1, 99, file1) != NULL)
-                addr1[k] = strtoull(tmp_addr1, NULL, 10);
-            else 
+            if(!reader1.Next(addr1[k]))
                 break;
         }
         access_num1 = k;
         k = 0;
         for(k;k<access_num2;k++)
         {
-            if(fgets(tmp_addr2, 99, file2) != NULL)
-                addr2[k] = strtoull(tmp_addr2, NULL, 10);
-            else 
+            if(!reader2.Next(addr2[k]))
                 break;
         }
         access_num2 = k;
         
-        srand((unsigned)time(NULL));
+        srand(seed + interval_no);
 
         unsigned long long index1 = 0, index2 = 0;
         unsigned long long total_count = access_num1 + access_num2;  // ensure that the probability of every pending trace is equal when launching
@@ -282,63 +520,11 @@ int main(int argc, char *argv[])
                 addr = addr + ((unsigned long long)1<<53);  // distinguish different benchmark
                 unsigned long long tag = addr >> (set_bits+block_bits);
 
-                if(tag_line_no1.find(tag) != tag_line_no1.end()) // found
-                {
-                    int line_no = tag_line_no1[tag];
-                    Refresh1(line_no);
-                    if(line_no >= begin_way2)
-                        Refresh2(line_no);
-                }   
-                else    // not found
-                {
-                    if(tag_line_no1.size() < ((end_way1-begin_way1)+1))   // not full
-                    {
-                        // printf("?\n");
-                        int allocated_line_no = occupancy1;
-                        tag_line_no1[tag] = allocated_line_no;
-                        Node* tmp = line_no_ptr1[allocated_line_no];
-                        tmp->tag = tag;
-                        Refresh1(allocated_line_no);
-                        occupancy1++;
-                        if(allocated_line_no >= begin_way2)
-                        {
-                            tag_line_no2[tag] = allocated_line_no;
-                            tmp = line_no_ptr2[allocated_line_no];
-                            tmp->tag = tag;
-                            Refresh2(allocated_line_no);
-                        }
-                    }
-                    else // full
-                    {
-                        int line_no = tail1->line_no;
-                        unsigned long long oldtag = tail1->tag;
-                        tag_line_no1.erase(oldtag);
-                        tag_line_no1[tag] = line_no;
-                        tail1->tag = tag;
-                        Refresh1(line_no);
-                        if(line_no >= begin_way2)
-                        {
-                            Node* tmp = line_no_ptr2[line_no];
-                            tag_line_no2.erase(oldtag);
-                            tag_line_no2[tag] = line_no;
-                            tmp->tag = tag;
-                            Refresh2(line_no);
-                        }
-                        if(!belong(oldtag))
-                        {
-                            // printf("????%llu\n", oldtag);
-                            occupancy1++;
-                            occupancy2--;
-                        }
-                    }
-                }
-
+                if(!cache.Access1(tag))
+                    miss_count[0]++;
                 index1++;
                 if(count % step == 0)
-                {
-                    fprintf(outfile1, "%d\n", occupancy1);
-                    fprintf(outfile2, "%d\n", occupancy2);
-                }
+                    Output_step();
                 count++;
             }
             else                    // launch a trace of the benchmark2
@@ -346,63 +532,11 @@ int main(int argc, char *argv[])
                 unsigned long long addr = addr2[index2];
                 unsigned long long tag = addr >> (set_bits+block_bits);
 
-                if(tag_line_no2.find(tag) != tag_line_no2.end()) // found
-                {
-                    int line_no = tag_line_no2[tag];
-                    Refresh2(line_no);
-                    if(line_no <= end_way1)
-                        Refresh1(line_no);
-                }   
-                else    // not found
-                {
-                    if(tag_line_no2.size() < ((end_way2-begin_way2)+1))   // not full
-                    {
-                        // printf("!\n");
-                        int allocated_line_no = end_way2-occupancy2;
-                        tag_line_no2[tag] = allocated_line_no;
-                        Node* tmp = line_no_ptr2[allocated_line_no];
-                        tmp->tag = tag;
-                        Refresh2(allocated_line_no);
-                        occupancy2++;
-                        if(allocated_line_no <= end_way1)
-                        {
-                            tag_line_no1[tag] = allocated_line_no;
-                            tmp = line_no_ptr1[allocated_line_no];
-                            tmp->tag = tag;
-                            Refresh1(allocated_line_no);
-                        }
-                    }
-                    else // full
-                    {
-                        int line_no = tail2->line_no;
-                        unsigned long long oldtag = tail2->tag;
-                        tag_line_no2.erase(oldtag);
-                        tag_line_no2[tag] = line_no;
-                        tail2->tag = tag;
-                        Refresh2(line_no);
-                        if(line_no <= end_way1)
-                        {
-                            Node* tmp = line_no_ptr1[line_no];
-                            tag_line_no1.erase(oldtag);
-                            tag_line_no1[tag] = line_no;
-                            tmp->tag = tag;
-                            Refresh1(line_no);
-                        }
-                        if(belong(oldtag))
-                        {
-                            // printf("!!!!!!!\n");
-                            occupancy1--;
-                            occupancy2++;
-                        }
-                    }
-                }
-
+                if(!cache.Access2(tag))
+                    miss_count[1]++;
                 index2++;
                 if(count % step == 0)
-                {
-                    fprintf(outfile1, "%d\n", occupancy1);
-                    fprintf(outfile2, "%d\n", occupancy2);
-                }
+                    Output_step();
                 count++;
             }
             
@@ -415,63 +549,11 @@ int main(int argc, char *argv[])
             addr = addr + ((unsigned long long)1<<53);  // distinguish different benchmark
             unsigned long long tag = addr >> (set_bits+block_bits);
 
-            if(tag_line_no1.find(tag) != tag_line_no1.end()) // found
-            {
-                int line_no = tag_line_no1[tag];
-                Refresh1(line_no);
-                if(line_no >= begin_way2)
-                    Refresh2(line_no);
-            }   
-            else    // not found
-            {
-                if(tag_line_no1.size() < ((end_way1-begin_way1)+1))   // not full
-                {
-                    // printf("?\n");
-                    int allocated_line_no = occupancy1;
-                    tag_line_no1[tag] = allocated_line_no;
-                    Node* tmp = line_no_ptr1[allocated_line_no];
-                    tmp->tag = tag;
-                    Refresh1(allocated_line_no);
-                    occupancy1++;
-                    if(allocated_line_no >= begin_way2)
-                    {
-                        tag_line_no2[tag] = allocated_line_no;
-                        tmp = line_no_ptr2[allocated_line_no];
-                        tmp->tag = tag;
-                        Refresh2(allocated_line_no);
-                    }
-                }
-                else // full
-                {
-                    int line_no = tail1->line_no;
-                    unsigned long long oldtag = tail1->tag;
-                    tag_line_no1.erase(oldtag);
-                    tag_line_no1[tag] = line_no;
-                    tail1->tag = tag;
-                    Refresh1(line_no);
-                    if(line_no >= begin_way2)
-                    {
-                        Node* tmp = line_no_ptr2[line_no];
-                        tag_line_no2.erase(oldtag);
-                        tag_line_no2[tag] = line_no;
-                        tmp->tag = tag;
-                        Refresh2(line_no);
-                    }
-                    if(!belong(oldtag))
-                    {
-                        // printf("????%llu\n", oldtag);
-                        occupancy1++;
-                        occupancy2--;
-                    }
-                }
-            }
-
+            if(!cache.Access1(tag))
+                miss_count[0]++;
             index1++;
             if(count % step == 0)
-            {
-                fprintf(outfile1, "%d\n", occupancy1);
-                fprintf(outfile2, "%d\n", occupancy2);
-            }
+                Output_step();
             count++;
         }
 
@@ -480,70 +562,27 @@ int main(int argc, char *argv[])
             unsigned long long addr = addr2[index2];
             unsigned long long tag = addr >> (set_bits+block_bits);
 
-            if(tag_line_no2.find(tag) != tag_line_no2.end()) // found
-            {
-                int line_no = tag_line_no2[tag];
-                Refresh2(line_no);
-                if(line_no <= end_way1)
-                    Refresh1(line_no);
-            }   
-            else    // not found
-            {
-                if(tag_line_no2.size() < ((end_way2-begin_way2)+1))   // not full
-                {
-                    // printf("!\n");
-                    int allocated_line_no = end_way2-occupancy2;
-                    tag_line_no2[tag] = allocated_line_no;
-                    Node* tmp = line_no_ptr2[allocated_line_no];
-                    tmp->tag = tag;
-                    Refresh2(allocated_line_no);
-                    occupancy2++;
-                    if(allocated_line_no <= end_way1)
-                    {
-                        tag_line_no1[tag] = allocated_line_no;
-                        tmp = line_no_ptr1[allocated_line_no];
-                        tmp->tag = tag;
-                        Refresh1(allocated_line_no);
-                    }
-                }
-                else // full
-                {
-                    int line_no = tail2->line_no;
-                    unsigned long long oldtag = tail2->tag;
-                    tag_line_no2.erase(oldtag);
-                    tag_line_no2[tag] = line_no;
-                    tail2->tag = tag;
-                    Refresh2(line_no);
-                    if(line_no <= end_way1)
-                    {
-                        Node* tmp = line_no_ptr1[line_no];
-                        tag_line_no1.erase(oldtag);
-                        tag_line_no1[tag] = line_no;
-                        tmp->tag = tag;
-                        Refresh1(line_no);
-                    }
-                    if(belong(oldtag))
-                    {
-                        // printf("!!!!!!!\n");
-                        occupancy1--;
-                        occupancy2++;
-                    }
-                }
-            }
-
+            if(!cache.Access2(tag))
+                miss_count[1]++;
             index2++;
             if(count % step == 0)
-            {
-                fprintf(outfile1, "%d\n", occupancy1);
-                fprintf(outfile2, "%d\n", occupancy2);
-            }
+                Output_step();
             count++;
         }
 
         delete[] addr1;
         delete[] addr2; 
+        access_count[0] += access_num1;
+        access_count[1] += access_num2;
+        if(live != NULL)
+            Update_live(false);
+        interval_no++;
+        if(checkpoint > 0 && interval_no % checkpoint == 0)
+            Save_snapshot();
     }
 
+    if(live != NULL)
+        Close_live();
     Finish();
 
     return 0;
@@ -0,0 +1,379 @@
+/*
+ * This program simulates a LRU-based cache focusing on only one set, based on occupancy.cpp.
+ * Different from occupancy.cpp, the cache allocation (end_way1, begin_way2) can change at every boundary of
+ * the time intervals of the _formalized perf files, as intel CAT does when the masks are rewritten:
+ * the lines stay where they are, a benchmark can hit in any way, and only the victim selection of the future
+ * misses is restricted to the new mask (empty ways first, then the LRU way of the mask).
+ * The allocation policy runs at the end of every interval, with the counters gathered during the interval:
+ *   0: static schedule, line i of [benchmark1]_[benchmark2]_schedule is "end_way1 begin_way2" of interval i+1,
+ *      the last allocation is kept when the schedule finishes;
+ *   1: UCP, every benchmark has a shadow LRU stack (UMON) counting the hits of every recency position,
+ *      the ways are divided to maximize the hits (the allocation is kept while there is no hit),
+ *      and the counters are halved after every decision;
+ *   2: user policy, the command given by "-u [command]" runs (by /bin/sh) beside the simulation; at the end of every
+ *      interval it reads a line "interval end_way1 begin_way2 occupancy1 occupancy2 access1 miss1 access2 miss2"
+ *      followed by the UMON hits of every recency position of benchmark1 then benchmark2 (ways numbers each, as UCP
+ *      sees them, counted during the interval) on its stdin, and writes a line "end_way1 begin_way2", the allocation
+ *      of the next interval, on its stdout, e.g. -u "python3 my_policy.py".
+ * Cache allocation requirement: benchmark1 begins with way0 while benchmark2 ends with way(ways-1).
+ * When [benchmark]_[slice_no]_[set_no].out does not exist, [benchmark]_[slice_no]_[set_no].rle collapsed by collapse.cpp
+ * is read, or else the traces of the set are gathered from [benchmark].bin through the per-set index [benchmark].idx
+ * built by index.cpp. The set is a Way_set of way_set.h, where a repeat of the last line accessed is a hit on the MRU
+ * line and skips the lookup.
+ * The accesses of the two benchmarks are interleaved at random by rand() seeded with "-s [seed]", the time by
+ * default; the seed is printed, so a run is repeated by giving it.
+ * Usage: g++ -std=c++11 occupancy_dynamic.cpp -o occupancy_dynamic
+ *        ./occupancy_dynamic [benchmark1] [benchmark2] [-s seed] [-u command]
+ * Input: follow the hints
+ * Output: the occupancies of benchmark1 and benchmark2 every step, saved as
+ *         [benchmark1]_[benchmark2]_[slice_no]_[set_no]_dynamic_1 and [benchmark1]_[benchmark2]_[slice_no]_[set_no]_dynamic_2;
+ *         the statistics of every interval, saved as [benchmark1]_[benchmark2]_[slice_no]_[set_no]_dynamic_interval,
+ *         every line is "interval end_way1 begin_way2 occupancy1 occupancy2 access1 miss1 access2 miss2",
+ *         where end_way1 and begin_way2 are the allocation used during the interval.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "set_reader.h"
+#include "way_set.h"
+using namespace std;
+char benchname1[100], benchname2[100];
+char perf_filename1[300], perf_filename2[300], schedule_filename[300];
+char filename1[300], filename2[300], outfilename1[300], outfilename2[300], intervalfilename[300];
+FILE *perf_file1, *perf_file2, *schedule_file, *outfile1, *outfile2, *intervalfile;
+int slices = 8, set_bits = 11, block_bits = 6, ways = 10;
+int step;    // the step of printing
+int policy;
+unsigned seed;
+char *user_command;    // "-u", the user policy
+FILE *to_user, *from_user;    // the stdin and the stdout of the user policy
+unsigned long long count = 0;
+int begin_way1 = 0, end_way1, begin_way2, end_way2 = ways-1;
+unsigned long long chosen_set_no;
+int chosen_slice_no;
+#define SETS 2048    // 2^set_bits
+#define MAX_WAYS MAX_SET_WAYS
+Way_set cache;    // the state of the set, indexed by way, see way_set.h
+
+struct Interval_stat
+{
+    unsigned long long access[3], miss[3];
+    unsigned long long umon_hits[3][MAX_WAYS];    // hits of every recency position of the shadow stacks
+};
+Interval_stat interval_stat;
+unsigned long long umon_stack[3][MAX_WAYS];       // the shadow LRU stacks, [0] is the MRU
+int umon_size[3];
+
+void Start_user_policy()    // the command of the user policy as a co-process, its stdin and stdout are pipes
+{
+    int in[2], out[2];
+    if(pipe(in) != 0 || pipe(out) != 0)
+    {
+        printf("cannot create pipes\n");
+        exit(1);
+    }
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        dup2(in[0], 0);
+        dup2(out[1], 1);
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+        execl("/bin/sh", "sh", "-c", user_command, (char *)NULL);
+        _exit(127);
+    }
+    close(in[0]);
+    close(out[1]);
+    signal(SIGPIPE, SIG_IGN);    // a policy that ended is reported at the next interval
+    to_user = fdopen(in[1], "w");
+    from_user = fdopen(out[0], "r");
+    if(pid < 0 || to_user == NULL || from_user == NULL)
+    {
+        printf("cannot start the user policy %s\n", user_command);
+        exit(1);
+    }
+}
+
+void User_policy(int interval, Interval_stat &stat, int &end_way1, int &begin_way2)
+{
+    fprintf(to_user, "%d %d %d %d %d %llu %llu %llu %llu", interval, end_way1, begin_way2,
+            cache.occupancy[1], cache.occupancy[2], stat.access[1], stat.miss[1], stat.access[2], stat.miss[2]);
+    for(int k = 1; k<=2; k++)
+        for(int i = 0; i<ways; i++)
+            fprintf(to_user, " %llu", stat.umon_hits[k][i]);
+    fprintf(to_user, "\n");
+    char tmp[100];
+    if(fflush(to_user) != 0 || fgets(tmp, 99, from_user) == NULL || sscanf(tmp, "%d %d", &end_way1, &begin_way2) != 2)
+    {
+        printf("interval %d: the user policy gave no allocation\n", interval);
+        exit(1);
+    }
+    memset(stat.umon_hits, 0, sizeof(stat.umon_hits));    // of the next interval
+}
+
+void Static_policy(int &end_way1, int &begin_way2)
+{
+    char tmp[100];
+    int e, b;
+    if(fgets(tmp, 99, schedule_file) != NULL && sscanf(tmp, "%d %d", &e, &b) == 2)
+    {
+        end_way1 = e;
+        begin_way2 = b;
+    }
+}
+
+void Ucp_policy(Interval_stat &stat, int &end_way1, int &begin_way2)
+{
+    unsigned long long max_hits = 0;
+    int best = end_way1;
+    for(int e = 0; e<ways-1; e++)    // benchmark1 gets e+1 ways, benchmark2 gets the rest
+    {
+        unsigned long long hits = 0;
+        for(int i = 0; i<=e; i++)
+            hits += stat.umon_hits[1][i];
+        for(int i = 0; i<ways-1-e; i++)
+            hits += stat.umon_hits[2][i];
+        if(hits > max_hits)
+        {
+            max_hits = hits;
+            best = e;
+        }
+    }
+    if(max_hits > 0)    // without any hit in the monitors, the allocation (and its overlap) is kept
+    {
+        end_way1 = best;
+        begin_way2 = best+1;
+    }
+    for(int k = 1; k<=2; k++)
+        for(int i = 0; i<ways; i++)
+            stat.umon_hits[k][i] /= 2;
+}
+
+void Umon(int bench, unsigned long long t)    // update the shadow stack of a benchmark as if it owned the whole set
+{
+    int pos = 0;
+    while(pos < umon_size[bench] && umon_stack[bench][pos] != t)
+        pos++;
+    if(pos < umon_size[bench])
+        interval_stat.umon_hits[bench][pos]++;
+    else if(umon_size[bench] < ways)
+        umon_size[bench]++;
+    else
+        pos = ways-1;    // drop the LRU one
+    for(int i = pos; i>0; i--)
+        umon_stack[bench][i] = umon_stack[bench][i-1];
+    umon_stack[bench][0] = t;
+}
+
+void Access(int bench, unsigned long long addr)
+{
+    if(bench == 1)
+        addr = addr + ((unsigned long long)1<<53);  // distinguish different benchmark
+    unsigned long long t = addr >> (set_bits+block_bits);
+    interval_stat.access[bench]++;
+    if(policy != 0)
+        Umon(bench, t);
+
+    int begin = bench == 1? begin_way1:begin_way2;
+    int end = bench == 1? end_way1:end_way2;
+    if(!cache.Access(bench, t, count, begin, end))
+        interval_stat.miss[bench]++;
+}
+
+Set_reader reader1, reader2;
+
+void Start()
+{
+    bool open1 = reader1.Open(filename1, benchname1, slices, SETS, chosen_slice_no, chosen_set_no);
+    bool open2 = reader2.Open(filename2, benchname2, slices, SETS, chosen_slice_no, chosen_set_no);
+    perf_file1 = fopen(perf_filename1, "r");
+    perf_file2 = fopen(perf_filename2, "r");
+    outfile1 = fopen(outfilename1, "w");
+    outfile2 = fopen(outfilename2, "w");
+    intervalfile = fopen(intervalfilename, "w");
+    if(!open1 || !open2 || perf_file1 == NULL || perf_file2 == NULL ||
+    outfile1 == NULL || outfile2 == NULL || intervalfile == NULL)
+    {
+        printf("cannot open all the files\n");
+        exit(1);
+    }
+    if(policy == 0)
+    {
+        schedule_file = fopen(schedule_filename, "r");
+        if(schedule_file == NULL)
+        {
+            printf("cannot open %s\n", schedule_filename);
+            exit(1);
+        }
+    }
+
+    cache.Init(ways);
+    memset(&interval_stat, 0, sizeof(interval_stat));
+    umon_size[1] = umon_size[2] = 0;
+
+    return;
+}
+
+void Finish()
+{
+    reader1.Close();
+    reader2.Close();
+    fclose(perf_file1);
+    fclose(perf_file2);
+    fclose(outfile1);
+    fclose(outfile2);
+    fclose(intervalfile);
+    if(policy == 0)
+        fclose(schedule_file);
+    if(policy == 2)
+    {
+        fclose(to_user);    // the end of its input
+        fclose(from_user);
+        wait(NULL);
+    }
+    return;
+}
+
+bool Check_allocation()
+{
+    return 0 <= end_way1 && end_way1 < ways && 0 <= begin_way2 && begin_way2 < ways;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 3)
+    {
+        printf("Usage: ./occupancy_dynamic [benchmark1] [benchmark2] [-s seed] [-u command]\n");
+        exit(1);
+    }
+    seed = (unsigned)time(NULL);
+    for(int i = 3; i<argc; i++)
+    {
+        if(strcmp(argv[i], "-s") == 0 && i+1 < argc)
+            seed = strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-u") == 0 && i+1 < argc)
+            user_command = argv[++i];
+        else
+        {
+            printf("unknown option %s\n", argv[i]);
+            exit(1);
+        }
+    }
+    printf("please input slice number(0~%d): ", slices-1);
+    scanf("%d", &chosen_slice_no);
+    printf("please input set number(0~%d): ", SETS-1);
+    scanf("%llu", &chosen_set_no);
+    printf("please input the step: ");
+    scanf("%d", &step);
+    printf("please input the initial allocation(end_way1 and begin_way2): ");
+    scanf("%d %d", &end_way1, &begin_way2);
+    printf("please input the policy(0: static schedule, 1: UCP, 2: user policy): ");
+    scanf("%d", &policy);
+    if(ways > MAX_WAYS || !Check_allocation())
+    {
+        printf("wrong allocation\n");
+        exit(1);
+    }
+    if(policy == 2 && user_command == NULL)
+    {
+        printf("the user policy needs -u [command]\n");
+        exit(1);
+    }
+    strcpy(benchname1, argv[1]);
+    strcpy(benchname2, argv[2]);
+    sprintf(filename1, "%s_%d_%llu.out", benchname1, chosen_slice_no, chosen_set_no);
+    sprintf(filename2, "%s_%d_%llu.out", benchname2, chosen_slice_no, chosen_set_no);
+    sprintf(perf_filename1, "%s_formalized", benchname1);
+    sprintf(perf_filename2, "%s_formalized", benchname2);
+    sprintf(schedule_filename, "%s_%s_schedule", benchname1, benchname2);
+    sprintf(outfilename1, "%s_%s_%d_%llu_dynamic_1", benchname1, benchname2, chosen_slice_no, chosen_set_no);
+    sprintf(outfilename2, "%s_%s_%d_%llu_dynamic_2", benchname1, benchname2, chosen_slice_no, chosen_set_no);
+    sprintf(intervalfilename, "%s_%s_%d_%llu_dynamic_interval", benchname1, benchname2, chosen_slice_no, chosen_set_no);
+
+    Start();
+    if(policy == 2)
+        Start_user_policy();
+    printf("seed %u\n", seed);
+    srand(seed);
+
+    char tmp_perf1[100], tmp_perf2[100];
+    unsigned long long access_num1, access_num2;
+    int interval = 0;
+    while(fgets(tmp_perf1, 99, perf_file1) != NULL && fgets(tmp_perf2, 99, perf_file2) != NULL)
+    {
+        access_num1 = strtoull(tmp_perf1, NULL, 10);
+        access_num2 = strtoull(tmp_perf2, NULL, 10);
+        access_num1 = access_num1 / slices / SETS;    // calculate access of one set during this time interval
+        access_num2 = access_num2 / slices / SETS;
+        unsigned long long *addr1 = new unsigned long long[access_num1];
+        unsigned long long *addr2 = new unsigned long long[access_num2];
+        unsigned long long k;
+        for(k = 0; k<access_num1; k++)
+        {
+            if(!reader1.Next(addr1[k]))
+                break;
+        }
+        access_num1 = k;
+        for(k = 0; k<access_num2; k++)
+        {
+            if(!reader2.Next(addr2[k]))
+                break;
+        }
+        access_num2 = k;
+
+        unsigned long long index1 = 0, index2 = 0;
+        unsigned long long total_count = access_num1 + access_num2;  // ensure that the probability of every pending trace is equal when launching
+        while(index1 < access_num1 || index2 < access_num2)
+        {
+            unsigned long long random_num = rand() % total_count;
+            if(random_num < (access_num1-index1))        // launch a trace of the benchmark1
+                Access(1, addr1[index1++]);
+            else                                          // launch a trace of the benchmark2
+                Access(2, addr2[index2++]);
+
+            if(count % step == 0)
+            {
+                fprintf(outfile1, "%d\n", cache.occupancy[1]);
+                fprintf(outfile2, "%d\n", cache.occupancy[2]);
+            }
+            count++;
+            total_count--;
+        }
+
+        delete[] addr1;
+        delete[] addr2;
+
+        // the end of the interval
+        fprintf(intervalfile, "%d %d %d %d %d %llu %llu %llu %llu\n", interval, end_way1, begin_way2,
+                cache.occupancy[1], cache.occupancy[2], interval_stat.access[1], interval_stat.miss[1], interval_stat.access[2], interval_stat.miss[2]);
+        int old_end_way1 = end_way1, old_begin_way2 = begin_way2;
+        if(policy == 0)
+            Static_policy(end_way1, begin_way2);
+        else if(policy == 1)
+            Ucp_policy(interval_stat, end_way1, begin_way2);
+        else
+            User_policy(interval, interval_stat, end_way1, begin_way2);
+        if(!Check_allocation())
+        {
+            printf("interval %d: wrong allocation %d %d, keep the old one\n", interval, end_way1, begin_way2);
+            end_way1 = old_end_way1;
+            begin_way2 = old_begin_way2;
+        }
+        interval_stat.access[1] = interval_stat.miss[1] = interval_stat.access[2] = interval_stat.miss[2] = 0;
+        interval++;
+    }
+
+    Finish();
+
+    return 0;
+}
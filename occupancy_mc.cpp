@@ -0,0 +1,391 @@
+/*
+ * This program runs the simulation of occupancy.cpp as Monte Carlo replicas, since the random interleaving of the two
+ * benchmarks within a time interval makes the occupancies of one run only one sample.
+ * The replicas simulate the same set with the same allocation, every one with its own draws: the draws of replica r
+ * in time interval i are seeded by seed+r*REPLICA_STRIDE+i (rand_r), so a run is repeated by giving its seed.
+ * The traces of every time interval are read once and shared by the replicas, which run on [threads] threads.
+ * The threads are started once and handed every time interval through a condition variable.
+ * Instead of the occupancies of every replica, their mean, standard deviation and percentiles (5%, 50%, 95%) over the
+ * replicas are written every step. At the end, the steady-state occupancy of every replica is its mean after the first
+ * [warm-up]% of the steps (rounded to time intervals), and the mean over the replicas is reported with its 95%
+ * confidence interval (Student's t with replicas-1 degrees of freedom).
+ * Cache allocation requirement: benchmark1 begins with way0 while benchmark2 ends with way(ways-1).
+ * The traces of the set are read as occupancy.cpp: [benchmark]_[slice_no]_[set_no].out, .rle or through the .idx.
+ * Usage: g++ -std=c++11 -O2 -pthread occupancy_mc.cpp -o occupancy_mc
+ *        ./occupancy_mc [benchmark1] [benchmark2] [-n replicas] [-t threads] [-s seed] [-w warm-up]
+ *        (replicas: 16 by default, threads: the cores by default, seed: the time by default, warm-up: 20 by default)
+ * Input: follow the hints
+ * Output: the occupancies of benchmark1 and benchmark2 every step over the replicas, saved as
+ *         [benchmark1]_[benchmark2]_[slice_no]_[set_no]_[overlap]_mc_1 and [benchmark1]_[benchmark2]_[slice_no]_[set_no]_[overlap]_mc_2,
+ *         every line is "mean stddev p5 p50 p95";
+ *         the steady-state summary, printed and saved as [benchmark1]_[benchmark2]_[slice_no]_[set_no]_[overlap]_mc_summary
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mirror_set.h"
+#include "set_reader.h"
+using namespace std;
+char benchname1[100], benchname2[100];
+char perf_filename1[300], perf_filename2[300];
+char filename1[300], filename2[300], outfilename1[300], outfilename2[300], summary_filename[300];
+FILE *perf_file1, *perf_file2, *outfile1, *outfile2, *summary_file;
+int slices = 8, set_bits = 11, block_bits = 6, ways = 10;
+int step;    // the step of printing
+int overlap;  // the number of overlapping ways
+int begin_way1 = 0, end_way1, begin_way2, end_way2 = ways-1;
+unsigned long long chosen_set_no;
+int chosen_slice_no;
+unsigned seed;
+int replicas = 16, threads = 0, warm_up = 20;
+#define SETS 2048    // 2^set_bits
+#define REPLICA_STRIDE 1000003    // between the seeds of two replicas, more than the time intervals
+
+class Replica    // the set of occupancy.cpp (a Mirror_set of mirror_set.h) with its own draws
+{
+public:
+    unsigned long long count;
+    Mirror_set set;
+    unsigned rand_state;
+    vector<int> samples1, samples2;    // the occupancies every step of the current time interval
+    vector<long long> sum1, sum2;      // the sum of the samples of every time interval
+
+    void Init();
+    void Run(const unsigned long long *addr1, unsigned long long access_num1,
+             const unsigned long long *addr2, unsigned long long access_num2, unsigned draw_seed);
+
+private:
+    void Access1(unsigned long long addr);
+    void Access2(unsigned long long addr);
+    void Sample();
+};
+
+void Replica::Init()
+{
+    count = 0;
+    set.Init(ways, end_way1, begin_way2, 53-set_bits-block_bits);
+}
+
+void Replica::Access1(unsigned long long addr)
+{
+    addr = addr + ((unsigned long long)1<<53);  // distinguish different benchmark
+    set.Access1(addr >> (set_bits+block_bits));
+    Sample();
+}
+
+void Replica::Access2(unsigned long long addr)
+{
+    set.Access2(addr >> (set_bits+block_bits));
+    Sample();
+}
+
+inline void Replica::Sample()
+{
+    if(count % step == 0)
+    {
+        samples1.push_back(set.occupancy1);
+        samples2.push_back(set.occupancy2);
+    }
+    count++;
+}
+
+void Replica::Run(const unsigned long long *addr1, unsigned long long access_num1,
+                  const unsigned long long *addr2, unsigned long long access_num2, unsigned draw_seed)
+{
+    samples1.clear();
+    samples2.clear();
+    rand_state = draw_seed;
+    unsigned long long index1 = 0, index2 = 0;
+    unsigned long long total_count = access_num1 + access_num2;  // ensure that the probability of every pending trace is equal when launching
+    while(index1 < access_num1 && index2 < access_num2)
+    {
+        unsigned long long random_num = rand_r(&rand_state) % total_count;
+        if(random_num < (access_num1-index1))        // launch a trace of the benchmark1
+            Access1(addr1[index1++]);
+        else                                          // launch a trace of the benchmark2
+            Access2(addr2[index2++]);
+        total_count--;
+    }
+    while(index1 < access_num1)
+        Access1(addr1[index1++]);
+    while(index2 < access_num2)
+        Access2(addr2[index2++]);
+
+    long long s1 = 0, s2 = 0;
+    for(size_t k = 0; k<samples1.size(); k++)
+    {
+        s1 += samples1[k];
+        s2 += samples2[k];
+    }
+    sum1.push_back(s1);
+    sum2.push_back(s2);
+}
+
+Set_reader reader1, reader2;
+vector<Replica> replica;
+
+// the workers, started once: worker w runs the replicas w, w+threads, ... of every time interval handed out
+vector<thread> workers;
+mutex pool_lock;
+condition_variable pool_start, pool_done;
+unsigned long long pool_round = 0;    // the time intervals handed out
+int pool_busy = 0;                    // the workers still running the current time interval
+bool pool_stop = false;
+const unsigned long long *pool_addr1, *pool_addr2;
+unsigned long long pool_access_num1, pool_access_num2, pool_interval_no;
+
+void Worker(int w)
+{
+    unsigned long long round = 0;
+    while(true)
+    {
+        {
+            unique_lock<mutex> lock(pool_lock);
+            pool_start.wait(lock, [&]() { return pool_stop || pool_round != round; });
+            if(pool_stop)
+                return;
+            round = pool_round;
+        }
+        for(int r = w; r<replicas; r += threads)
+            replica[r].Run(pool_addr1, pool_access_num1, pool_addr2, pool_access_num2,
+                           seed + (unsigned)r*REPLICA_STRIDE + (unsigned)pool_interval_no);
+        lock_guard<mutex> lock(pool_lock);
+        if(--pool_busy == 0)
+            pool_done.notify_one();
+    }
+}
+
+void Run_interval(const unsigned long long *addr1, unsigned long long access_num1,
+                  const unsigned long long *addr2, unsigned long long access_num2, unsigned long long interval_no)
+{
+    unique_lock<mutex> lock(pool_lock);
+    pool_addr1 = addr1;
+    pool_access_num1 = access_num1;
+    pool_addr2 = addr2;
+    pool_access_num2 = access_num2;
+    pool_interval_no = interval_no;
+    pool_busy = threads;
+    pool_round++;
+    pool_start.notify_all();
+    pool_done.wait(lock, []() { return pool_busy == 0; });
+}
+
+void Stop_workers()
+{
+    {
+        lock_guard<mutex> lock(pool_lock);
+        pool_stop = true;
+    }
+    pool_start.notify_all();
+    for(int w = 0; w<threads; w++)
+        workers[w].join();
+}
+
+void Start()
+{
+    bool open1 = reader1.Open(filename1, benchname1, slices, SETS, chosen_slice_no, chosen_set_no);
+    bool open2 = reader2.Open(filename2, benchname2, slices, SETS, chosen_slice_no, chosen_set_no);
+    perf_file1 = fopen(perf_filename1, "r");
+    perf_file2 = fopen(perf_filename2, "r");
+    outfile1 = fopen(outfilename1, "w");
+    outfile2 = fopen(outfilename2, "w");
+    summary_file = fopen(summary_filename, "w");
+    if(!open1 || !open2 || perf_file1 == NULL || perf_file2 == NULL ||
+    outfile1 == NULL || outfile2 == NULL || summary_file == NULL)
+    {
+        printf("cannot open all the files\n");
+        exit(1);
+    }
+
+    replica.resize(replicas);
+    for(int r = 0; r<replicas; r++)
+        replica[r].Init();
+    for(int w = 0; w<threads; w++)
+        workers.push_back(thread(Worker, w));
+
+    return;
+}
+
+void Finish()
+{
+    Stop_workers();
+    reader1.Close();
+    reader2.Close();
+    fclose(perf_file1);
+    fclose(perf_file2);
+    fclose(outfile1);
+    fclose(outfile2);
+    fclose(summary_file);
+    return;
+}
+
+void Write_step(FILE *outfile, vector<int> &value)    // the occupancies of the replicas at a step
+{
+    double mean = 0, var = 0;
+    for(int r = 0; r<replicas; r++)
+        mean += value[r];
+    mean /= replicas;
+    for(int r = 0; r<replicas; r++)
+        var += (value[r]-mean)*(value[r]-mean);
+    var = replicas > 1? var/(replicas-1):0;
+    sort(value.begin(), value.end());    // nearest rank
+    fprintf(outfile, "%.3f %.3f %d %d %d\n", mean, sqrt(var), value[(int)ceil(0.05*replicas)-1],
+            value[(int)ceil(0.5*replicas)-1], value[(int)ceil(0.95*replicas)-1]);
+}
+
+double T_quantile(int df)    // the 97.5% quantile of Student's t
+{
+    static const double t[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    return df <= 30? t[df-1]:1.96;
+}
+
+void Summary(const vector<unsigned long long> &interval_samples)
+{
+    unsigned long long total = 0, skipped = 0, kept = 0;
+    for(size_t i = 0; i<interval_samples.size(); i++)
+        total += interval_samples[i];
+    size_t first = 0;    // the first time interval of the steady state
+    while(first < interval_samples.size() && skipped + interval_samples[first] <= total*warm_up/100)
+        skipped += interval_samples[first++];
+    for(size_t i = first; i<interval_samples.size(); i++)
+        kept += interval_samples[i];
+    if(kept == 0)
+    {
+        printf("no step after the warm-up\n");
+        return;
+    }
+
+    for(int bench = 1; bench<=2; bench++)
+    {
+        vector<double> steady(replicas);
+        double mean = 0, var = 0;
+        for(int r = 0; r<replicas; r++)
+        {
+            const vector<long long> &sum = bench == 1? replica[r].sum1:replica[r].sum2;
+            long long s = 0;
+            for(size_t i = first; i<sum.size(); i++)
+                s += sum[i];
+            steady[r] = (double)s/kept;
+            mean += steady[r];
+        }
+        mean /= replicas;
+        for(int r = 0; r<replicas; r++)
+            var += (steady[r]-mean)*(steady[r]-mean);
+        var = replicas > 1? var/(replicas-1):0;
+        double half = replicas > 1? T_quantile(replicas-1)*sqrt(var/replicas):0;
+        double min = *min_element(steady.begin(), steady.end()), max = *max_element(steady.begin(), steady.end());
+        for(FILE *f = stdout; f != NULL; f = f == stdout? summary_file:NULL)
+            fprintf(f, "benchmark%d: steady-state occupancy %.3f, 95%% confidence interval [%.3f, %.3f], "
+                    "stddev over the replicas %.3f, min %.3f, max %.3f\n", bench, mean, mean-half, mean+half, sqrt(var), min, max);
+    }
+    for(FILE *f = stdout; f != NULL; f = f == stdout? summary_file:NULL)
+        fprintf(f, "%d replicas, seed %u, %llu steps, the first %llu steps (%zu time intervals) skipped as the warm-up\n",
+                replicas, seed, total, skipped, first);
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 3)
+    {
+        printf("Usage: ./occupancy_mc [benchmark1] [benchmark2] [-n replicas] [-t threads] [-s seed] [-w warm-up]\n");
+        exit(1);
+    }
+    seed = (unsigned)time(NULL);
+    for(int i = 3; i+1<argc; i += 2)
+    {
+        if(strcmp(argv[i], "-n") == 0)
+            replicas = atoi(argv[i+1]);
+        else if(strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i+1]);
+        else if(strcmp(argv[i], "-s") == 0)
+            seed = strtoul(argv[i+1], NULL, 10);
+        else if(strcmp(argv[i], "-w") == 0)
+            warm_up = atoi(argv[i+1]);
+    }
+    if(replicas < 1 || warm_up < 0 || warm_up > 100)
+    {
+        printf("the replicas must be positive and the warm-up 0~100\n");
+        exit(1);
+    }
+    if(threads <= 0)
+        threads = thread::hardware_concurrency() > 0? thread::hardware_concurrency():1;
+    threads = min(threads, replicas);
+
+    printf("please input slice number(0~%d): ", slices-1);
+    scanf("%d", &chosen_slice_no);
+    printf("please input set number(0~%d): ", SETS-1);
+    scanf("%llu", &chosen_set_no);
+    printf("please input the step: ");
+    scanf("%d", &step);
+    printf("please input the allocation(end_way1 and begin_way2): ");
+    scanf("%d %d", &end_way1, &begin_way2);
+    overlap = (end_way1-begin_way2)<0? 0:(end_way1-begin_way2)+1;
+    strcpy(benchname1, argv[1]);
+    strcpy(benchname2, argv[2]);
+    sprintf(filename1, "%s_%d_%llu.out", benchname1, chosen_slice_no, chosen_set_no);
+    sprintf(filename2, "%s_%d_%llu.out", benchname2, chosen_slice_no, chosen_set_no);
+    sprintf(perf_filename1, "%s_formalized", benchname1);
+    sprintf(perf_filename2, "%s_formalized", benchname2);
+    sprintf(outfilename1, "%s_%s_%d_%llu_%d_mc_1", argv[1], argv[2], chosen_slice_no, chosen_set_no, overlap);
+    sprintf(outfilename2, "%s_%s_%d_%llu_%d_mc_2", argv[1], argv[2], chosen_slice_no, chosen_set_no, overlap);
+    sprintf(summary_filename, "%s_%s_%d_%llu_%d_mc_summary", argv[1], argv[2], chosen_slice_no, chosen_set_no, overlap);
+
+    Start();
+
+    char tmp_perf1[100], tmp_perf2[100];
+    unsigned long long access_num1, access_num2, interval_no = 0;
+    vector<unsigned long long> addr1, addr2, interval_samples;
+    vector<int> value(replicas);
+    while(fgets(tmp_perf1, 99, perf_file1) != NULL && fgets(tmp_perf2, 99, perf_file2) != NULL)
+    {
+        access_num1 = strtoull(tmp_perf1, NULL, 10);
+        access_num2 = strtoull(tmp_perf2, NULL, 10);
+        access_num1 = access_num1 / slices / SETS;    // calculate access of one set during this time interval
+        access_num2 = access_num2 / slices / SETS;
+        addr1.resize(access_num1);    // read once, shared by the replicas
+        addr2.resize(access_num2);
+        unsigned long long k = 0;
+        for(k = 0; k<access_num1; k++)
+            if(!reader1.Next(addr1[k]))
+                break;
+        access_num1 = k;
+        for(k = 0; k<access_num2; k++)
+            if(!reader2.Next(addr2[k]))
+                break;
+        access_num2 = k;
+
+        Run_interval(addr1.data(), access_num1, addr2.data(), access_num2, interval_no);
+
+        size_t samples = replica[0].samples1.size();    // the same in every replica
+        for(size_t s = 0; s<samples; s++)
+        {
+            for(int r = 0; r<replicas; r++)
+                value[r] = replica[r].samples1[s];
+            Write_step(outfile1, value);
+            for(int r = 0; r<replicas; r++)
+                value[r] = replica[r].samples2[s];
+            Write_step(outfile2, value);
+        }
+        interval_samples.push_back(samples);
+        interval_no++;
+    }
+
+    Summary(interval_samples);
+    Finish();
+
+    return 0;
+}
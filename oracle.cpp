@@ -0,0 +1,1098 @@
+/*
+ * This program checks the optimized engines of the simulators against the reference engines, access by access.
+ * The engines checked are those of the tools, from the headers the tools include, so they cannot drift apart.
+ * Reference engines, kept as they were written:
+ *   Ref_slice, the Cache_slice of cal_set_slice.cpp, a linked list and two unordered_maps for every set, without the
+ *     MRU fast path: while a set is not full, the line size() is filled (allocated_line_no);
+ *   Ref_mirror, the two mirrored lists of occupancy.cpp for one set, without the last_tag fast path: benchmark1 owns
+ *     the ways begin_way1~end_way1 and benchmark2 the ways begin_way2~end_way2, and a line in the overlapping ways is
+ *     in both lists;
+ *   Ref_ways, the set of occupancy_dynamic.cpp with the recency of the ways as a list instead of the times of access.
+ * Engines checked:
+ *   mru:       Cache_slice of cache_slice.h, a run of the same line as one access (cal_set_slice.cpp, .rle);
+ *   pipeline:  the same Cache_slice with Arena_allocator, from an Arena of arena.h (cal_set_slice_pipeline.cpp);
+ *   compact:   Compact_set of compact_set.h (cal_set_slice_compact.cpp and cal_set_stream.cpp), up to 15 ways;
+ *   flat:      Flat_cache of flat_cache.h (cal_set_hierarchy.cpp);
+ *   batch:     the batched driver of cal_set_slice.cpp, Hash_batch and Simulate_batch of cache_slice.h, in every
+ *              shard of -k (a Cache_slice of its own, as the processes), with a prefetch distance and, in fuzz,
+ *              segments not measured as the sampling of -f/-w/-d/-s;
+ *   occupancy: Mirror_set of mirror_set.h (occupancy.cpp, and every replica of occupancy_mc.cpp);
+ *   dynamic:   Way_set of way_set.h (occupancy_dynamic.cpp), the allocation changing at any time.
+ * After every access, the hit or miss of every engine and the state of the set accessed, i.e. the (line, tag) of the
+ * ways from the MRU to the LRU (and the occupancies), must be the same as the reference. A line is the way, so the
+ * order of filling is checked too. After every batch, the counters of every set accessed and its state must be those
+ * of the reference in its shard, and the set must be untouched in the other shards. At the first divergence, the
+ * access and the set in every engine are dumped.
+ * Modes:
+ *   trace: the traces are interleaved as cal_set_slice.cpp does, with the geometry of the tools (8 slices, 2048 sets,
+ *          11 ways), and the LLC engines are checked, the batched driver with 3 shards and a prefetch distance of 8;
+ *   fuzz:  every case draws a geometry (0~11 set bits, 1~15 ways, 1~4 shards, a prefetch distance of 0~16, the
+ *          allocation of occupancy.cpp, and 2~32 ways for occupancy_dynamic.cpp) and generates a trace of two
+ *          benchmarks mixing a hot pool, streams, conflicts on one set and repeats of a line, then the LLC engines,
+ *          the occupancy engines and the dynamic engines are checked. A case is reproduced by its seed.
+ * Usage: g++ -std=c++11 -O2 oracle.cpp -o oracle
+ *        ./oracle [benchmark1] [benchmark2]
+ *        ./oracle [merged]    (a trace merged by merge.cpp)
+ *        ./oracle -z [cases] [seed] [accesses]    (100 cases of 20000 accesses from the seed 1 by default)
+ * Input: follow the hints
+ * Output: "all the engines agree" and the accesses checked, or the first divergence, and the exit code is 1
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
+#include "cache_slice.h"
+#include "compact_set.h"
+#include "flat_cache.h"
+#include "mirror_set.h"
+#include "way_set.h"
+using namespace std;
+
+char benchname1[20], benchname2[20];
+int slices = 8, set_bits = 11, block_bits = 6, ways = 11;
+int sets = 2048;    // 2^set_bits
+unsigned long long addr1, addr2;
+int ratio;    // benchmark1:benchmark2
+#define MAX_WAYS 15    // so that the order of Compact_set and Flat_cache fits in 64 bits
+typedef unsigned int Tag;
+#define TAG_BITS 32    // as cal_set_slice_compact.cpp
+unsigned long long checked = 0, case_begin = 0;    // accesses, case_begin: checked when the case began
+unsigned long long ref_misses = 0;
+#define BATCH 256        // as cal_set_slice.cpp
+#define MAX_SHARDS 4
+int shards = 3, prefetch_distance = 8;    // of the batched driver, as "-k" and "-p" of cal_set_slice.cpp
+
+class Ref_slice    // the Cache_slice of cal_set_slice.cpp as it was, for any number of sets
+{
+public:
+    vector<Node*> head, tail;
+    vector<unordered_map<unsigned long long, int> > tag_line_no;
+    vector<unordered_map<int, Node*> > line_no_ptr;
+
+    void Init();
+    void Free();
+    void Refresh(unsigned long long set_no, unsigned long long tag);
+    void Replace(unsigned long long set_no, unsigned long long newtag);
+    bool Access(unsigned long long set_no, unsigned long long tag);
+    int State(unsigned long long set_no, int *line, unsigned long long *tags);
+};
+
+void Ref_slice::Init()
+{
+    head.assign(sets, NULL);
+    tail.assign(sets, NULL);
+    tag_line_no.assign(sets, unordered_map<unsigned long long, int>());
+    line_no_ptr.assign(sets, unordered_map<int, Node*>());
+    for(int k = 0; k<sets; k++)
+    {
+        Node *tmp_pre = NULL, *tmp_next = NULL;
+        head[k] = new Node(0);
+        tmp_pre = head[k];
+        for(int i = 1; i<ways; i++)
+        {
+            tmp_next = new Node(i);
+            tmp_pre->next = tmp_next;
+            tmp_next->pre = tmp_pre;
+            tmp_pre = tmp_next;
+        }
+        tail[k] = tmp_pre;
+
+        Node *tmp = head[k];
+        for(int i = 0; i<ways; i++)
+        {
+            line_no_ptr[k].insert(make_pair(i, tmp));
+            tmp = tmp->next;
+        }
+    }
+}
+
+void Ref_slice::Free()
+{
+    for(int k = 0; k<sets; k++)
+        for(Node *p = head[k]; p != NULL; )
+        {
+            Node *next = p->next;
+            delete p;
+            p = next;
+        }
+}
+
+void Ref_slice::Refresh(unsigned long long set_no, unsigned long long tag)
+{
+    int line_no_tmp = tag_line_no[set_no][tag];
+    if(line_no_tmp >= ways || line_no_tmp < 0)
+    {
+        printf("line_no_tmp >= ways || line_no_tmp < 0\n");
+        exit(1);
+    }
+    Node *tmp = line_no_ptr[set_no][line_no_tmp];
+    if(head[set_no] != tmp)
+    {
+        if(tmp->pre != NULL)
+            tmp->pre->next = tmp->next;
+        if(tmp->next != NULL)
+            tmp->next->pre = tmp->pre;
+        if(tail[set_no] == tmp)
+            tail[set_no] = tmp->pre;
+        tmp->next = head[set_no];
+        head[set_no]->pre = tmp;
+        tmp->pre = NULL;
+        head[set_no] = tmp;
+    }
+    return;
+}
+
+void Ref_slice::Replace(unsigned long long set_no, unsigned long long newtag)
+{
+    int line_no_tmp = tail[set_no]->line_no;
+    unsigned long long oldtag = tail[set_no]->tag;
+    tag_line_no[set_no].erase(oldtag);
+    tag_line_no[set_no][newtag] = line_no_tmp;
+    tail[set_no]->tag = newtag;
+    Refresh(set_no, newtag);
+    return;
+}
+
+bool Ref_slice::Access(unsigned long long set_no, unsigned long long tag)    // true when hit
+{
+    if(tag_line_no[set_no].find(tag) != tag_line_no[set_no].end()) // found
+    {
+        Refresh(set_no, tag);
+        return true;
+    }
+    // not found
+    if((int)tag_line_no[set_no].size() < ways)   // not full
+    {
+        int allocated_line_no = tag_line_no[set_no].size();
+        tag_line_no[set_no][tag] = allocated_line_no;
+        Node* tmp = line_no_ptr[set_no][allocated_line_no];
+        tmp->tag = tag;
+        Refresh(set_no, tag);
+    }
+    else // full
+    {
+        Replace(set_no, tag);
+    }
+    return false;
+}
+
+int Ref_slice::State(unsigned long long set_no, int *line, unsigned long long *tags)    // the valid lines from the MRU
+{
+    int used = tag_line_no[set_no].size(), n = 0;
+    for(Node *p = head[set_no]; p != NULL && n < used; p = p->next, n++)
+    {
+        line[n] = p->line_no;
+        tags[n] = p->tag;
+    }
+    return n;
+}
+
+int Compact_state(const Compact_set<Tag, MAX_WAYS> &set, int *line, unsigned long long *tags)
+{
+    for(int pos = 0; pos<set.used; pos++)
+    {
+        int way = (set.order >> (4*pos)) & 15;
+        line[pos] = way;
+        tags[pos] = ((unsigned long long)set.owner[way] << (53-set_bits-block_bits)) | set.tag[way];    // with the marker
+    }
+    return set.used;
+}
+
+int Flat_state(Flat_cache &cache, unsigned long long set_no, int *way, unsigned long long *tags)
+{
+    int used = cache.State(set_no, way, tags);
+    for(int i = 0; i<used; i++)    // the line addresses without the set bits
+        tags[i] >>= set_bits;
+    return used;
+}
+
+Ref_slice *ref_llc;
+Cache_slice<> *mru;
+Cache_slice<Arena_allocator> *pipeline;
+Arena arena;
+Compact_set<Tag, MAX_WAYS> **compact;    // [slice][set], of which the first ways are used
+Flat_cache *flat;
+
+// the batched driver: the accesses of the batch, and every shard with its cache and counters ([slice*sets+set])
+unsigned long long batch_addr[BATCH], batch_n[BATCH];
+bool batch_measure[BATCH];
+int batch_len = 0;
+Cache_slice<> *shard_llc[MAX_SHARDS];
+unsigned long long *shard_count[MAX_SHARDS], *shard_miss[MAX_SHARDS], shard_measured[MAX_SHARDS];
+unsigned long long *ref_count, *ref_miss, ref_measured;    // of the reference, the measured accesses only
+
+void Start_llc()
+{
+    ref_llc = new Ref_slice[slices];
+    mru = new Cache_slice<>[slices];
+    pipeline = new Cache_slice<Arena_allocator>[slices];
+    arena.Init(-1);
+    current_arena = &arena;
+    compact = new Compact_set<Tag, MAX_WAYS>*[slices];
+    flat = new Flat_cache[slices];
+    for(int i = 0; i<slices; i++)
+    {
+        ref_llc[i].Init();
+        mru[i].Init(sets, ways);
+        pipeline[i].Init(sets, ways);
+        compact[i] = new Compact_set<Tag, MAX_WAYS>[sets];
+        for(int j = 0; j<sets; j++)
+            Init_set(compact[i][j], ways);
+        flat[i].Init(sets, ways);
+    }
+    for(int s = 0; s<shards; s++)
+    {
+        shard_llc[s] = new Cache_slice<>[slices];
+        for(int i = 0; i<slices; i++)
+            shard_llc[s][i].Init(sets, ways);
+        shard_count[s] = new unsigned long long[(size_t)slices*sets]();
+        shard_miss[s] = new unsigned long long[(size_t)slices*sets]();
+        shard_measured[s] = 0;
+    }
+    ref_count = new unsigned long long[(size_t)slices*sets]();
+    ref_miss = new unsigned long long[(size_t)slices*sets]();
+    ref_measured = 0;
+    batch_len = 0;
+}
+
+void Finish_llc()
+{
+    for(int i = 0; i<slices; i++)
+    {
+        ref_llc[i].Free();
+        mru[i].Free();
+        pipeline[i].Free();
+        delete []compact[i];
+        flat[i].Free();
+    }
+    delete []ref_llc;
+    delete []mru;
+    delete []pipeline;
+    arena.Release();
+    delete []compact;
+    delete []flat;
+    for(int s = 0; s<shards; s++)
+    {
+        for(int i = 0; i<slices; i++)
+            shard_llc[s][i].Free();
+        delete []shard_llc[s];
+        delete []shard_count[s];
+        delete []shard_miss[s];
+    }
+    delete []ref_count;
+    delete []ref_miss;
+}
+
+void Dump(const char *name, bool hit, int n, const int *line, const unsigned long long *tags)
+{
+    printf("  %-9s %-4s", name, hit? "hit":"miss");
+    for(int i = 0; i<n; i++)
+        printf(" %d:%llx", line[i], tags[i]);
+    printf("\n");
+}
+
+// the batch through Hash_batch and Simulate_batch in every shard, after the reference has taken the same accesses:
+// the accesses measured in all the shards, and the counters and the state of every set accessed must be those of the
+// reference in its shard, while the other shards never count or fill it
+void Check_batch()
+{
+    for(int s = 0; s<shards; s++)
+    {
+        Slice_access a[BATCH];
+        int len = Hash_batch(batch_addr, batch_n, batch_measure, batch_len, set_bits, block_bits, shards, s, a);
+        Simulate_batch(shard_llc[s], a, len, prefetch_distance, shard_count[s], shard_miss[s], shard_measured[s]);
+    }
+    unsigned long long measured = 0;
+    for(int s = 0; s<shards; s++)
+        measured += shard_measured[s];
+
+    int line[2][MAX_WAYS], used[2] = {0, 0}, bad = -1, bad_shard = 0;
+    unsigned long long tags[2][MAX_WAYS];
+    bool same = measured == ref_measured;
+    for(int i = 0; same && i<batch_len; i++)
+    {
+        unsigned long long set_no = (batch_addr[i] >> block_bits) & (sets-1);
+        int slice = Cal_slice(batch_addr[i]);
+        unsigned long long k = slice*sets + set_no;
+        used[0] = ref_llc[slice].State(set_no, line[0], tags[0]);
+        for(int s = 0; same && s<shards; s++)
+        {
+            Cache_slice<> &cache = shard_llc[s][slice];
+            used[1] = cache.State(set_no, line[1], tags[1]);
+            if((int)(k % shards) == s)
+            {
+                same = shard_count[s][k] == ref_count[k] && shard_miss[s][k] == ref_miss[k] && used[1] == used[0];
+                for(int j = 0; same && j<used[0]; j++)
+                    same = line[1][j] == line[0][j] && tags[1][j] == tags[0][j];
+            }
+            else
+                same = shard_count[s][k] == 0 && shard_miss[s][k] == 0 && used[1] == 0;
+            if(!same)
+            {
+                bad = i;
+                bad_shard = s;
+            }
+        }
+    }
+    batch_len = 0;
+    if(same)
+        return;
+
+    printf("divergence in the batch ending at access %llu of the case, %d shards, prefetch distance %d\n",
+           checked-case_begin, shards, prefetch_distance);
+    if(bad < 0)
+    {
+        printf("%llu accesses measured in the shards, %llu in the reference\n", measured, ref_measured);
+        exit(1);
+    }
+    unsigned long long set_no = (batch_addr[bad] >> block_bits) & (sets-1);
+    int slice = Cal_slice(batch_addr[bad]);
+    unsigned long long k = slice*sets + set_no;
+    printf("address %llx of the batch, slice %d, set %llu of shard %llu: in shard %d, %llu accesses and %llu misses, "
+           "%llu and %llu in the reference\n", batch_addr[bad], slice, set_no, k % shards, bad_shard,
+           shard_count[bad_shard][k], shard_miss[bad_shard][k], ref_count[k], ref_miss[k]);
+    printf("the set from the MRU to the LRU, line:tag\n");
+    Dump("reference", true, used[0], line[0], tags[0]);
+    Dump("shard", true, used[1], line[1], tags[1]);
+    exit(1);
+}
+
+// n accesses to the line of address addr in a row, the reference takes them one by one and the others as one;
+// measure: counted by the batched driver
+void Check_llc(unsigned long long addr, unsigned long long n, bool measure)
+{
+    unsigned long long tag = addr >> (set_bits+block_bits);
+    unsigned long long set_no = (addr >> block_bits) & (sets-1);
+    int slice = Cal_slice(addr);
+    unsigned long long victim;
+    Tag compact_tag;
+    unsigned char owner;
+    Split_tag(addr, set_bits+block_bits, TAG_BITS, compact_tag, owner);
+
+    bool hit[5];
+    hit[0] = ref_llc[slice].Access(set_no, tag);
+    if(!hit[0])
+        ref_misses++;
+    bool repeats_hit = true;
+    for(unsigned long long k = 1; k<n; k++)
+        repeats_hit = ref_llc[slice].Access(set_no, tag) && repeats_hit;
+    hit[1] = mru[slice].Access(set_no, tag);
+    hit[2] = pipeline[slice].Access(set_no, tag);
+    hit[3] = Compact_access(compact[slice][set_no], compact_tag, owner, ways);
+    hit[4] = flat[slice].Access(addr >> block_bits, victim);
+
+    int line[5][MAX_WAYS], used[5];
+    unsigned long long tags[5][MAX_WAYS];
+    used[0] = ref_llc[slice].State(set_no, line[0], tags[0]);
+    used[1] = mru[slice].State(set_no, line[1], tags[1]);
+    used[2] = pipeline[slice].State(set_no, line[2], tags[2]);
+    used[3] = Compact_state(compact[slice][set_no], line[3], tags[3]);
+    used[4] = Flat_state(flat[slice], set_no, line[4], tags[4]);
+
+    bool same = repeats_hit;
+    for(int e = 1; e<5; e++)
+    {
+        same = same && hit[e] == hit[0] && used[e] == used[0];
+        for(int i = 0; same && i<used[0]; i++)
+            same = line[e][i] == line[0][i] && tags[e][i] == tags[0][i];
+    }
+    checked += n;
+    if(!same)
+    {
+        const char *name[5] = {"reference", "mru", "pipeline", "compact", "flat"};
+        printf("divergence at access %llu of the case: address %llx (x%llu), slice %d, set %llu, tag %llx%s\n",
+               checked-n-case_begin, addr, n, slice, set_no, tag, repeats_hit? "":", a repeat missed in the reference");
+        printf("the set from the MRU to the LRU, line:tag\n");
+        for(int e = 0; e<5; e++)
+            Dump(name[e], hit[e], used[e], line[e], tags[e]);
+        exit(1);
+    }
+
+    if(measure)    // all but the first of the run are hits
+    {
+        unsigned long long k = slice*sets + set_no;
+        ref_count[k] += n;
+        ref_measured += n;
+        if(!hit[0])
+            ref_miss[k]++;
+    }
+    batch_addr[batch_len] = addr;
+    batch_n[batch_len] = n;
+    batch_measure[batch_len] = measure;
+    batch_len++;
+    if(batch_len == BATCH)
+        Check_batch();
+}
+
+class Ref_mirror    // the two mirrored lists of occupancy.cpp for one set as they were
+{
+public:
+    int begin_way1, end_way1, begin_way2, end_way2;
+    Node *head1, *tail1, *head2, *tail2;
+    unordered_map<unsigned long long, int> tag_line_no1, tag_line_no2;
+    unordered_map<int, Node*> line_no_ptr1, line_no_ptr2;
+    int occupancy1, occupancy2;
+
+    void Init(int e1, int b2);
+    void Free();
+    void Refresh1(int line_no_tmp);
+    void Refresh2(int line_no_tmp);
+    bool Access1(unsigned long long tag);
+    bool Access2(unsigned long long tag);
+};
+
+bool belong(unsigned long long tag)     // addr belongs to benchmark1
+{
+    if((tag>>(53-set_bits-block_bits)) == 1)
+        return true;
+    else
+        return false;
+}
+
+void Ref_mirror::Init(int e1, int b2)
+{
+    begin_way1 = 0;
+    end_way1 = e1;
+    begin_way2 = b2;
+    end_way2 = ways-1;
+    occupancy1 = occupancy2 = 0;
+
+    // benchmark1
+    Node *tmp_pre = NULL, *tmp_next = NULL;
+    head1 = new Node(begin_way1);
+    tmp_pre = head1;
+    for(int i = begin_way1+1; i<=end_way1; i++)
+    {
+        tmp_next = new Node(i);
+        tmp_pre->next = tmp_next;
+        tmp_next->pre = tmp_pre;
+        tmp_pre = tmp_next;
+    }
+    tail1 = tmp_pre;
+
+    Node *tmp = head1;
+    for(int i = begin_way1; i<=end_way1; i++)
+    {
+        line_no_ptr1.insert(make_pair(i, tmp));
+        tmp = tmp->next;
+    }
+
+    // benchmark2
+    tmp_pre = NULL;
+    tmp_next = NULL;
+    head2 = new Node(end_way2);
+    tmp_pre = head2;
+    for(int i = end_way2-1; i>=begin_way2; i--)
+    {
+        tmp_next = new Node(i);
+        tmp_pre->next = tmp_next;
+        tmp_next->pre = tmp_pre;
+        tmp_pre = tmp_next;
+    }
+    tail2 = tmp_pre;
+
+    tmp = head2;
+    for(int i = end_way2; i>=begin_way2; i--)
+    {
+        line_no_ptr2.insert(make_pair(i, tmp));
+        tmp = tmp->next;
+    }
+}
+
+void Ref_mirror::Free()
+{
+    for(Node *p = head1; p != NULL; )
+    {
+        Node *next = p->next;
+        delete p;
+        p = next;
+    }
+    for(Node *p = head2; p != NULL; )
+    {
+        Node *next = p->next;
+        delete p;
+        p = next;
+    }
+    tag_line_no1.clear();
+    tag_line_no2.clear();
+    line_no_ptr1.clear();
+    line_no_ptr2.clear();
+}
+
+void Ref_mirror::Refresh1(int line_no_tmp)
+{
+    if(line_no_tmp > end_way1 || line_no_tmp < begin_way1)
+    {
+        printf("Refresh1 error\n");
+        exit(1);
+    }
+    Node *tmp = line_no_ptr1[line_no_tmp];
+    if(head1 != tmp)
+    {
+        if(tmp->pre != NULL)
+            tmp->pre->next = tmp->next;
+        if(tmp->next != NULL)
+            tmp->next->pre = tmp->pre;
+        if(tail1 == tmp)
+            tail1 = tmp->pre;
+        tmp->next = head1;
+        head1->pre = tmp;
+        tmp->pre = NULL;
+        head1 = tmp;
+    }
+    return;
+}
+
+void Ref_mirror::Refresh2(int line_no_tmp)
+{
+    if(line_no_tmp > end_way2 || line_no_tmp < begin_way2)
+    {
+        printf("Refresh2 error\n");
+        exit(1);
+    }
+    Node *tmp = line_no_ptr2[line_no_tmp];
+    if(head2 != tmp)
+    {
+        if(tmp->pre != NULL)
+            tmp->pre->next = tmp->next;
+        if(tmp->next != NULL)
+            tmp->next->pre = tmp->pre;
+        if(tail2 == tmp)
+            tail2 = tmp->pre;
+        tmp->next = head2;
+        head2->pre = tmp;
+        tmp->pre = NULL;
+        head2 = tmp;
+    }
+    return;
+}
+
+bool Ref_mirror::Access1(unsigned long long tag)    // a trace of benchmark1, tag with the marker; true when hit
+{
+    bool hit = true;
+    if(tag_line_no1.find(tag) != tag_line_no1.end()) // found
+    {
+        int line_no = tag_line_no1[tag];
+        Refresh1(line_no);
+        if(line_no >= begin_way2)
+            Refresh2(line_no);
+    }
+    else    // not found
+    {
+        hit = false;
+        if((int)tag_line_no1.size() < ((end_way1-begin_way1)+1))   // not full
+        {
+            int allocated_line_no = occupancy1;
+            tag_line_no1[tag] = allocated_line_no;
+            Node* tmp = line_no_ptr1[allocated_line_no];
+            tmp->tag = tag;
+            Refresh1(allocated_line_no);
+            occupancy1++;
+            if(allocated_line_no >= begin_way2)
+            {
+                tag_line_no2[tag] = allocated_line_no;
+                tmp = line_no_ptr2[allocated_line_no];
+                tmp->tag = tag;
+                Refresh2(allocated_line_no);
+            }
+        }
+        else // full
+        {
+            int line_no = tail1->line_no;
+            unsigned long long oldtag = tail1->tag;
+            tag_line_no1.erase(oldtag);
+            tag_line_no1[tag] = line_no;
+            tail1->tag = tag;
+            Refresh1(line_no);
+            if(line_no >= begin_way2)
+            {
+                Node* tmp = line_no_ptr2[line_no];
+                tag_line_no2.erase(oldtag);
+                tag_line_no2[tag] = line_no;
+                tmp->tag = tag;
+                Refresh2(line_no);
+            }
+            if(!belong(oldtag))
+            {
+                occupancy1++;
+                occupancy2--;
+            }
+        }
+    }
+    return hit;
+}
+
+bool Ref_mirror::Access2(unsigned long long tag)    // a trace of benchmark2; true when hit
+{
+    bool hit = true;
+    if(tag_line_no2.find(tag) != tag_line_no2.end()) // found
+    {
+        int line_no = tag_line_no2[tag];
+        Refresh2(line_no);
+        if(line_no <= end_way1)
+            Refresh1(line_no);
+    }
+    else    // not found
+    {
+        hit = false;
+        if((int)tag_line_no2.size() < ((end_way2-begin_way2)+1))   // not full
+        {
+            int allocated_line_no = end_way2-occupancy2;
+            tag_line_no2[tag] = allocated_line_no;
+            Node* tmp = line_no_ptr2[allocated_line_no];
+            tmp->tag = tag;
+            Refresh2(allocated_line_no);
+            occupancy2++;
+            if(allocated_line_no <= end_way1)
+            {
+                tag_line_no1[tag] = allocated_line_no;
+                tmp = line_no_ptr1[allocated_line_no];
+                tmp->tag = tag;
+                Refresh1(allocated_line_no);
+            }
+        }
+        else // full
+        {
+            int line_no = tail2->line_no;
+            unsigned long long oldtag = tail2->tag;
+            tag_line_no2.erase(oldtag);
+            tag_line_no2[tag] = line_no;
+            tail2->tag = tag;
+            Refresh2(line_no);
+            if(line_no <= end_way1)
+            {
+                Node* tmp = line_no_ptr1[line_no];
+                tag_line_no1.erase(oldtag);
+                tag_line_no1[tag] = line_no;
+                tmp->tag = tag;
+                Refresh1(line_no);
+            }
+            if(belong(oldtag))
+            {
+                occupancy1--;
+                occupancy2++;
+            }
+        }
+    }
+    return hit;
+}
+
+// the whole list, the tag of a way not in the map of the list is ~0 (empty, or overwritten through the other list)
+int Mirror_state(Node *head, unordered_map<unsigned long long, int> &tag_line_no, int *line, unsigned long long *tags)
+{
+    int n = 0;
+    for(Node *p = head; p != NULL; p = p->next, n++)
+    {
+        unordered_map<unsigned long long, int>::iterator it = tag_line_no.find(p->tag);
+        line[n] = p->line_no;
+        tags[n] = it != tag_line_no.end() && it->second == p->line_no? p->tag:~0ULL;
+    }
+    return n;
+}
+
+Ref_mirror mirror_ref;
+Mirror_set mirror;
+
+void Check_occupancy(int bench, unsigned long long tag)
+{
+    bool hit[2];
+    if(bench == 1)
+    {
+        hit[0] = mirror_ref.Access1(tag);
+        hit[1] = mirror.Access1(tag);
+    }
+    else
+    {
+        hit[0] = mirror_ref.Access2(tag);
+        hit[1] = mirror.Access2(tag);
+    }
+
+    int line[4][MAX_WAYS], used[4];
+    unsigned long long tags[4][MAX_WAYS];
+    used[0] = Mirror_state(mirror_ref.head1, mirror_ref.tag_line_no1, line[0], tags[0]);
+    used[1] = Mirror_state(mirror_ref.head2, mirror_ref.tag_line_no2, line[1], tags[1]);
+    used[2] = Mirror_state(mirror.head1, mirror.tag_line_no1, line[2], tags[2]);
+    used[3] = Mirror_state(mirror.head2, mirror.tag_line_no2, line[3], tags[3]);
+    bool same = hit[0] == hit[1] && mirror_ref.occupancy1 == mirror.occupancy1 && mirror_ref.occupancy2 == mirror.occupancy2
+                && mirror_ref.tag_line_no1 == mirror.tag_line_no1 && mirror_ref.tag_line_no2 == mirror.tag_line_no2;
+    for(int l = 0; l<2; l++)
+    {
+        same = same && used[l] == used[l+2];
+        for(int i = 0; same && i<used[l]; i++)
+            same = line[l][i] == line[l+2][i] && tags[l][i] == tags[l+2][i];
+    }
+    checked++;
+    if(same)
+        return;
+
+    printf("divergence at access %llu of the case: benchmark%d, tag %llx, allocation %d %d of %d ways\n",
+           checked-1-case_begin, bench, tag,
+           mirror_ref.end_way1, mirror_ref.begin_way2, ways);
+    printf("the lists from the MRU to the LRU, line:tag\n");
+    printf("  reference %-4s occupancy %d %d\n", hit[0]? "hit":"miss", mirror_ref.occupancy1, mirror_ref.occupancy2);
+    Dump("list1", hit[0], used[0], line[0], tags[0]);
+    Dump("list2", hit[0], used[1], line[1], tags[1]);
+    printf("  fast      %-4s occupancy %d %d\n", hit[1]? "hit":"miss", mirror.occupancy1, mirror.occupancy2);
+    Dump("list1", hit[1], used[2], line[2], tags[2]);
+    Dump("list2", hit[1], used[3], line[3], tags[3]);
+    exit(1);
+}
+
+class Ref_ways    // the set of occupancy_dynamic.cpp, with the recency of the filled ways as a list
+{
+public:
+    int ways;
+    unsigned long long tag[MAX_SET_WAYS];
+    int owner[MAX_SET_WAYS];    // 0: empty, 1: benchmark1, 2: benchmark2
+    vector<int> recency;        // the filled ways from the MRU to the LRU
+    int occupancy[3];
+
+    void Init(int w);
+    bool Access(int bench, unsigned long long t, int begin, int end);
+};
+
+void Ref_ways::Init(int w)
+{
+    ways = w;
+    for(int i = 0; i<ways; i++)
+        owner[i] = 0;
+    recency.clear();
+    occupancy[0] = ways;
+    occupancy[1] = occupancy[2] = 0;
+}
+
+bool Ref_ways::Access(int bench, unsigned long long t, int begin, int end)    // true when hit
+{
+    int way = -1;
+    bool hit = false;
+    for(int w = 0; w<ways && way < 0; w++)
+        if(owner[w] == bench && tag[w] == t)    // a line hits in any way
+            way = w;
+    if(way >= 0)
+        hit = true;
+    else
+    {
+        for(int i = 0; i<=end-begin && way < 0; i++)    // the first empty way of the mask, from its end for benchmark2
+        {
+            int w = bench == 1? begin+i:end-i;
+            if(owner[w] == 0)
+                way = w;
+        }
+        for(int i = recency.size()-1; i>=0 && way < 0; i--)    // or else the least recent way of the mask
+            if(recency[i] >= begin && recency[i] <= end)
+                way = recency[i];
+        occupancy[owner[way]]--;
+        occupancy[bench]++;
+        owner[way] = bench;
+        tag[way] = t;
+    }
+    for(int i = 0; i<(int)recency.size(); i++)
+        if(recency[i] == way)
+        {
+            recency.erase(recency.begin()+i);
+            break;
+        }
+    recency.insert(recency.begin(), way);
+    return hit;
+}
+
+Ref_ways ways_ref;
+Way_set way_set;
+
+void Dump_ways(const char *name, bool hit, int n, const int *owner, const unsigned long long *tag)
+{
+    printf("  %-9s %-4s", name, hit? "hit":"miss");
+    for(int w = 0; w<n; w++)
+        if(owner[w] == 0)
+            printf(" %d:-", w);
+        else
+            printf(" %d:%d/%llx", w, owner[w], tag[w]);
+    printf("\n");
+}
+
+// the ways of every benchmark, the occupancies, and the recency of the filled ways as the order of their times
+void Check_dynamic(int bench, unsigned long long tag, int end_way1, int begin_way2)
+{
+    int begin = bench == 1? 0:begin_way2;
+    int end = bench == 1? end_way1:ways-1;
+    bool hit[2];
+    hit[0] = ways_ref.Access(bench, tag, begin, end);
+    hit[1] = way_set.Access(bench, tag, checked, begin, end);
+
+    bool same = hit[0] == hit[1] && (int)ways_ref.recency.size() == ways-way_set.occupancy[0];
+    for(int k = 0; k<3; k++)
+        same = same && ways_ref.occupancy[k] == way_set.occupancy[k];
+    for(int w = 0; same && w<ways; w++)
+        same = ways_ref.owner[w] == way_set.owner[w] && (ways_ref.owner[w] == 0 || ways_ref.tag[w] == way_set.tag[w]);
+    for(int i = 1; same && i<(int)ways_ref.recency.size(); i++)
+        same = way_set.stamp[ways_ref.recency[i-1]] > way_set.stamp[ways_ref.recency[i]];
+    checked++;
+    if(same)
+        return;
+
+    printf("divergence at access %llu of the case: benchmark%d, tag %llx, allocation %d %d of %d ways\n",
+           checked-1-case_begin, bench, tag, end_way1, begin_way2, ways);
+    printf("the ways, way:owner/tag, and the recency from the MRU to the LRU, way:time\n");
+    printf("  reference occupancy %d %d %d\n", ways_ref.occupancy[0], ways_ref.occupancy[1], ways_ref.occupancy[2]);
+    Dump_ways("ways", hit[0], ways, ways_ref.owner, ways_ref.tag);
+    printf("  dynamic   occupancy %d %d %d\n", way_set.occupancy[0], way_set.occupancy[1], way_set.occupancy[2]);
+    Dump_ways("ways", hit[1], ways, way_set.owner, way_set.tag);
+    printf("  recency       ");
+    for(int i = 0; i<(int)ways_ref.recency.size(); i++)
+        printf(" %d:%llu", ways_ref.recency[i], way_set.stamp[ways_ref.recency[i]]);
+    printf("\n");
+    exit(1);
+}
+
+class Trace_reader    // [benchmark].out, or [benchmark].rle collapsed by collapse.cpp when the .out is absent
+{
+public:
+    FILE *file;
+    bool rle;
+    unsigned long long addr, left;    // the current run of the same line
+
+    bool Open(const char *benchname);
+    bool Next(unsigned long long &a, unsigned long long &n, unsigned long long max);
+};
+
+bool Trace_reader::Open(const char *benchname)
+{
+    char filename[200];
+    sprintf(filename, "%s.out", benchname);
+    rle = false;
+    left = 0;
+    file = fopen(filename, "r");
+    if(file == NULL)
+    {
+        sprintf(filename, "%s.rle", benchname);
+        file = fopen(filename, "r");
+        rle = true;
+    }
+    return file != NULL;
+}
+
+// the next n (1~max) accesses, which are all to the line of address a
+bool Trace_reader::Next(unsigned long long &a, unsigned long long &n, unsigned long long max)
+{
+    if(left == 0)
+    {
+        char tmp[100], *p;
+        if(fgets(tmp, 99, file) == NULL)
+            return false;
+        addr = strtoull(tmp, &p, 10);
+        left = rle? strtoull(p, NULL, 10):1;
+        if(left == 0)
+            left = 1;
+    }
+    a = addr;
+    n = left < max? left:max;
+    left -= n;
+    return true;
+}
+
+Trace_reader reader1, reader2;
+
+void Run_traces()
+{
+    bool open1 = reader1.Open(benchname1);
+    bool open2 = benchname2[0] != 0? reader2.Open(benchname2):true;
+    if(!open1 || !open2)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    Start_llc();
+
+    unsigned long long n1, n2;
+    if(benchname2[0] == 0)
+    {
+        while(reader1.Next(addr1, n1, ~0ULL))
+            Check_llc(addr1, n1, true);
+    }
+    else
+    while(reader1.Next(addr1, n1, 1) && reader2.Next(addr2, n2, 1))   // end with either file finished
+    {
+        addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
+        Check_llc(addr1, 1, true);
+
+        int counter = ratio - 1;
+        while(counter > 0)
+        {
+            if(reader1.Next(addr1, n1, counter))    // a run is cut at the end of the turn of benchmark1
+            {
+                addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
+                Check_llc(addr1, n1, true);
+                counter -= n1;
+            }
+            else
+                break;
+        }
+
+        Check_llc(addr2, 1, true);
+    }
+
+    Check_batch();    // the rest
+    Finish_llc();
+    fclose(reader1.file);
+    if(benchname2[0] != 0)
+        fclose(reader2.file);
+}
+
+unsigned long long Random()    // 62 random bits, rand() gives at least 31
+{
+    return ((unsigned long long)rand() << 31) | rand();
+}
+
+// a generated trace of two benchmarks, as (address, repeats); the tags are within TAG_BITS bits to fit in Tag
+void Generate(unsigned long long accesses, vector<unsigned long long> &addr, vector<unsigned long long> &n)
+{
+    unsigned long long pool = (unsigned long long)ways*(1+rand()%4) << set_bits;    // lines of the hot pool
+    unsigned long long mask = (1ULL << (TAG_BITS+set_bits)) - 1;    // of the lines
+    unsigned long long base = Random() & mask, line = 0;
+    addr.clear();
+    n.clear();
+    unsigned long long total = 0;
+    while(total < accesses)
+    {
+        int pattern = rand()%4, length = 1+rand()%64;
+        unsigned long long conflict_set = Random() & (sets-1);
+        for(int i = 0; i<length && total < accesses; i++)
+        {
+            if(pattern == 0)         // the hot pool
+                line = base + Random()%pool;
+            else if(pattern == 1)    // a stream
+                line++;
+            else if(pattern == 2)    // conflicts on one set
+                line = ((base + Random()%(3*ways)) << set_bits) | conflict_set;
+            // pattern 3: the same line again
+            line &= mask;
+            unsigned long long marker = rand()%2 == 0? (unsigned long long)1<<53:0;    // benchmark1 or benchmark2
+            unsigned long long a = marker | (line << block_bits) | (Random() & ((1ULL<<block_bits) - 1));
+            unsigned long long repeats = pattern == 3? 1+rand()%8:1;
+            if(!addr.empty() && (addr.back() >> block_bits) == (a >> block_bits))    // one run of the same line
+                n.back() += repeats;
+            else
+            {
+                addr.push_back(a);
+                n.push_back(repeats);
+            }
+            total += repeats;
+        }
+    }
+}
+
+void Fuzz(int cases, unsigned seed, unsigned long long accesses)
+{
+    vector<unsigned long long> addr, n;
+    for(int c = 0; c<cases; c++)
+    {
+        srand(seed + c);
+        set_bits = rand()%12;
+        sets = 1 << set_bits;
+        ways = 1+rand()%MAX_WAYS;
+        shards = 1+rand()%MAX_SHARDS;
+        prefetch_distance = rand()%17;
+        printf("case %d (seed %u): %d sets, %d ways, %d shards, prefetch distance %d\n", c, seed + c, sets, ways,
+               shards, prefetch_distance);
+
+        Generate(accesses, addr, n);
+        case_begin = checked;
+        Start_llc();
+        bool measure = rand()%2 == 0;    // the segments of sampling
+        unsigned long long left = 1+rand()%1000;
+        for(unsigned long long i = 0; i<addr.size(); i++)
+        {
+            if(--left == 0)
+            {
+                measure = !measure;
+                left = 1+rand()%1000;
+            }
+            Check_llc(addr[i], n[i], measure);
+        }
+        Check_batch();    // the rest
+        Finish_llc();
+
+        // occupancy.cpp keeps one set of 2~15 ways, benchmark1 from way 0 and benchmark2 to way ways-1
+        ways = 2+rand()%(MAX_WAYS-1);
+        int end_way1 = rand()%(ways-1), begin_way2 = 1+rand()%(end_way1+1);    // overlapping or adjacent
+        printf("case %d (seed %u): occupancy of %d ways, allocation %d %d\n", c, seed + c, ways, end_way1, begin_way2);
+        case_begin = checked;
+        mirror_ref.Init(end_way1, begin_way2);
+        mirror.Init(ways, end_way1, begin_way2, 53-set_bits-block_bits);
+        for(unsigned long long i = 0; i<addr.size(); i++)
+        {
+            int bench = addr[i] >> 53 == 1? 1:2;
+            unsigned long long tag = addr[i] >> (set_bits+block_bits);
+            unsigned long long marker = tag & (~0ULL << (53-set_bits-block_bits));
+            tag = marker | (tag % (3*ways));    // a few tags for one set
+            for(unsigned long long k = 0; k<n[i]; k++)
+                Check_occupancy(bench, tag);
+        }
+        mirror_ref.Free();
+        mirror.Free();
+
+        // occupancy_dynamic.cpp keeps one set of 2~32 ways, and any allocation may be written at any time
+        ways = 2+rand()%(MAX_SET_WAYS-1);
+        end_way1 = rand()%ways;
+        begin_way2 = rand()%ways;
+        printf("case %d (seed %u): dynamic of %d ways\n", c, seed + c, ways);
+        case_begin = checked;
+        ways_ref.Init(ways);
+        way_set.Init(ways);
+        left = 1+rand()%2000;
+        for(unsigned long long i = 0; i<addr.size(); i++)
+        {
+            int bench = addr[i] >> 53 == 1? 1:2;
+            unsigned long long tag = addr[i] >> (set_bits+block_bits);
+            unsigned long long marker = tag & (~0ULL << (53-set_bits-block_bits));
+            tag = marker | (tag % (3*ways));
+            for(unsigned long long k = 0; k<n[i]; k++)
+            {
+                if(--left == 0)    // a new allocation
+                {
+                    end_way1 = rand()%ways;
+                    begin_way2 = rand()%ways;
+                    left = 1+rand()%2000;
+                }
+                Check_dynamic(bench, tag, end_way1, begin_way2);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        printf("Usage: ./oracle [benchmark1] [benchmark2] (or [merged]), or ./oracle -z [cases] [seed] [accesses]\n");
+        exit(1);
+    }
+
+    if(strcmp(argv[1], "-z") == 0)
+    {
+        int cases = argc > 2? atoi(argv[2]):100;
+        unsigned seed = argc > 3? strtoul(argv[3], NULL, 10):1;
+        unsigned long long accesses = argc > 4? strtoull(argv[4], NULL, 10):20000;
+        Fuzz(cases, seed, accesses);
+    }
+    else if(argc == 2)    // a merged trace
+    {
+        strcpy(benchname1, argv[1]);
+        benchname2[0] = 0;
+        Run_traces();
+    }
+    else
+    {
+        printf("please input ratio: ");
+        scanf("%d", &ratio);
+        strcpy(benchname1, argv[1]);
+        strcpy(benchname2, argv[2]);
+        Run_traces();
+    }
+
+    printf("all the engines agree on %llu accesses (%llu misses of the reference)\n", checked, ref_misses);
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * This program converts a decimal text trace [benchmark].out into the binary trace [benchmark].bin
+ * (an array of 64-bit little-endian addresses in stream order, see index.cpp) at multi-GB/s.
+ * The text is mmaped and split into newline-aligned chunks, one for every thread. The first pass counts the lines
+ * of every chunk, so every thread knows where its addresses go; the second pass parses the digits with a SWAR
+ * kernel (8 digits per step in a 64-bit register) and writes them straight into the mmaped output.
+ * Different from fgets + strtoull, a malformed line (empty, non-digit characters, more than 20 digits or
+ * larger than 2^64-1) is reported with its line number, and no output is kept.
+ * Usage: g++ -std=c++11 -O2 -pthread parse.cpp -o parse
+ *        ./parse [benchmark] [threads]    (threads is optional, all the cores by default)
+ * Output: [benchmark].bin
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+char benchname[100];
+char filename[200], binfilename[200];
+#define MAX_REPORT 10    // malformed lines reported by every thread
+
+struct Chunk
+{
+    const char *begin, *end;
+    unsigned long long lines, first_line;    // the lines of the chunk, the index of its first line
+    unsigned long long errors;
+};
+
+inline bool All_digits(unsigned long long x)    // all the 8 bytes are '0'~'9'
+{
+    return (((x + 0x4646464646464646ULL) | (x - 0x3030303030303030ULL)) & 0x8080808080808080ULL) == 0;
+}
+
+inline unsigned long long Parse8(unsigned long long x)    // 8 ascii digits, the first one in the lowest byte
+{
+    x = ((x & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;                  // pairs of digits
+    x = ((x & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;              // groups of 4 digits
+    return ((x & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;  // 8 digits
+}
+
+// parse [p, end) as a decimal number, false when malformed
+inline bool Parse_line(const char *p, const char *end, unsigned long long &value)
+{
+    if(end > p && end[-1] == '\r')
+        end--;
+    long len = end - p;
+    if(len <= 0 || len > 20)
+        return false;
+    unsigned long long result = 0;
+    if(len == 20)    // may overflow, check the leading 19 digits first
+    {
+        unsigned long long high;
+        if(!Parse_line(p, p+19, high))
+            return false;
+        if(p[19] < '0' || p[19] > '9' || high > (~0ULL - (p[19]-'0')) / 10)
+            return false;
+        value = high*10 + (p[19]-'0');
+        return true;
+    }
+    while(len >= 8)
+    {
+        unsigned long long x;
+        memcpy(&x, p, 8);
+        if(!All_digits(x))
+            return false;
+        result = result*100000000ULL + Parse8(x);
+        p += 8;
+        len -= 8;
+    }
+    while(len > 0)
+    {
+        if(*p < '0' || *p > '9')
+            return false;
+        result = result*10 + (*p - '0');
+        p++;
+        len--;
+    }
+    value = result;
+    return true;
+}
+
+void Count(Chunk *chunk)
+{
+    unsigned long long lines = 0;
+    const char *p = chunk->begin;
+    while(p < chunk->end)
+    {
+        const char *q = (const char *)memchr(p, '\n', chunk->end - p);
+        lines++;
+        if(q == NULL)
+            break;
+        p = q+1;
+    }
+    chunk->lines = lines;
+}
+
+void Parse(Chunk *chunk, unsigned long long *out)
+{
+    unsigned long long *dst = out + chunk->first_line;
+    unsigned long long line_no = chunk->first_line;
+    chunk->errors = 0;
+    const char *p = chunk->begin;
+    while(p < chunk->end)
+    {
+        const char *q = (const char *)memchr(p, '\n', chunk->end - p);
+        const char *e = q == NULL? chunk->end:q;
+        line_no++;
+        if(!Parse_line(p, e, *dst))
+        {
+            if(chunk->errors < MAX_REPORT)
+                printf("line %llu is malformed: \"%.*s\"\n", line_no, (int)(e-p < 40? e-p:40), p);
+            chunk->errors++;
+            *dst = 0;
+        }
+        dst++;
+        if(q == NULL)
+            break;
+        p = q+1;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        printf("Usage: ./parse [benchmark] [threads]\n");
+        exit(1);
+    }
+    strcpy(benchname, argv[1]);
+    sprintf(filename, "%s.out", benchname);
+    sprintf(binfilename, "%s.bin", benchname);
+    int thread_num = argc > 2? atoi(argv[2]):thread::hardware_concurrency();
+    if(thread_num < 1)
+        thread_num = 1;
+
+    auto start = chrono::steady_clock::now();
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0)
+    {
+        printf("cannot open %s\n", filename);
+        exit(1);
+    }
+    size_t size = st.st_size;
+    const char *text = "";
+    if(size > 0)
+    {
+        text = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if(text == MAP_FAILED)
+        {
+            printf("cannot mmap %s\n", filename);
+            exit(1);
+        }
+        madvise((void *)text, size, MADV_SEQUENTIAL);
+    }
+
+    // newline-aligned chunks
+    vector<Chunk> chunks(thread_num);
+    const char *p = text, *end = text + size;
+    for(int t = 0; t<thread_num; t++)
+    {
+        const char *q = t == thread_num-1? end:text + size*(t+1)/thread_num;
+        if(q < p)
+            q = p;
+        if(q < end)
+        {
+            const char *nl = (const char *)memchr(q, '\n', end-q);
+            q = nl == NULL? end:nl+1;
+        }
+        chunks[t].begin = p;
+        chunks[t].end = q;
+        p = q;
+    }
+
+    vector<thread> threads;
+    for(int t = 0; t<thread_num; t++)
+        threads.push_back(thread(Count, &chunks[t]));
+    for(int t = 0; t<thread_num; t++)
+        threads[t].join();
+    unsigned long long lines = 0;
+    for(int t = 0; t<thread_num; t++)
+    {
+        chunks[t].first_line = lines;
+        lines += chunks[t].lines;
+    }
+
+    int binfd = open(binfilename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(binfd < 0 || ftruncate(binfd, lines*sizeof(unsigned long long)) != 0)
+    {
+        printf("cannot open %s\n", binfilename);
+        exit(1);
+    }
+    unsigned long long *out = NULL;
+    if(lines > 0)
+    {
+        out = (unsigned long long *)mmap(NULL, lines*sizeof(unsigned long long), PROT_READ | PROT_WRITE, MAP_SHARED, binfd, 0);
+        if(out == MAP_FAILED)
+        {
+            printf("cannot mmap %s\n", binfilename);
+            exit(1);
+        }
+    }
+
+    threads.clear();
+    for(int t = 0; t<thread_num; t++)
+        threads.push_back(thread(Parse, &chunks[t], out));
+    for(int t = 0; t<thread_num; t++)
+        threads[t].join();
+    unsigned long long errors = 0;
+    for(int t = 0; t<thread_num; t++)
+        errors += chunks[t].errors;
+
+    if(out != NULL)
+        munmap(out, lines*sizeof(unsigned long long));
+    close(binfd);
+    if(size > 0)
+        munmap((void *)text, size);
+    close(fd);
+    if(errors > 0)
+    {
+        printf("%llu malformed lines, %s is removed\n", errors, binfilename);
+        unlink(binfilename);
+        return 1;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%llu addresses parsed with %d threads in %.3fs, %.2f GB/s\n", lines, thread_num, seconds,
+           seconds > 0? size/seconds/1e9:0);
+    return 0;
+}
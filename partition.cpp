@@ -0,0 +1,404 @@
+/*
+ * This program searches the cache allocation (intel CAT masks) of N co-run benchmarks over their miss curves,
+ * instead of running occupancy.cpp for every (end_way1, begin_way2).
+ * Every mask is a contiguous range of ways, as CAT requires. Three methods are supported:
+ *   0: optimal isolation, all the ways are divided into N disjoint masks, every benchmark gets at least one way;
+ *   1: UCP lookahead (Qureshi and Patt, MICRO'06), greedily gives ways to the benchmark with the max marginal utility;
+ *   2: overlapping masks, every benchmark gets an arbitrary contiguous mask as occupancy.cpp supports.
+ * A shared way is assumed to be occupied by its sharers in proportion to their misses (insertions), and the
+ * effective ways of every benchmark are solved as a fixed point, with the curves linearly interpolated.
+ * Objectives: 0: total misses, 1: weighted misses, 2: fairness, i.e. the max of misses(allocation)/misses(all ways).
+ * Precondition: the miss curve of every benchmark, saved as [benchmark]_curve. The file has ways+1 lines, line k
+ *               is the misses with k ways (k = 0~ways). A line has either one number (misses of the whole cache)
+ *               or SETS numbers (misses of every set); with per-set curves the sharing is solved set by set.
+ *               "./shards [benchmark]" writes the whole-cache curve from its sampled MRC, so the pipeline is
+ *               shards.cpp for every benchmark alone, then partition.cpp, then occupancy.cpp for the top-k.
+ * Usage: g++ -std=c++11 -O2 partition.cpp -o partition
+ *        ./partition [benchmark1] [benchmark2] ... [benchmarkN]
+ * Input: follow the hints
+ * Output: the top-k allocations, saved as [benchmark1]_[benchmark2]_..._partition. Every line is
+ *         "rank objective misses1 ... missesN mask1 ... maskN" (masks in hex); for two benchmarks whose masks
+ *         fit occupancy.cpp (benchmark1 begins with way0, benchmark2 ends with way(ways-1)),
+ *         "end_way1 begin_way2" is appended so that the candidate can be verified with occupancy.cpp directly.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <vector>
+#include <queue>
+#include <algorithm>
+using namespace std;
+
+#define MAX_BENCH 8
+#define SETS 2048    // 2^set_bits
+int ways = 11;
+int bench_num, method, objective, top_k;
+int sets = 1;    // 1 for whole-cache curves, SETS for per-set curves
+char outfilename[1000];
+FILE *outfile;
+vector<double> curve[MAX_BENCH];    // curve[i][s*(ways+1)+k]: misses of benchmark i in set s with k ways
+double weight[MAX_BENCH];
+double alone[MAX_BENCH];            // misses with all the ways
+unsigned long long evaluated = 0;
+
+struct Candidate
+{
+    double value;
+    double misses[MAX_BENCH];
+    int begin[MAX_BENCH], end[MAX_BENCH];    // mask = [begin, end]
+    bool operator<(const Candidate &other) const    // max-heap on value keeps the worst candidate on top
+    {
+        return value < other.value;
+    }
+};
+priority_queue<Candidate> best;
+
+void Read_curve(int i, const char *benchname)
+{
+    char filename[200];
+    strcpy(filename, benchname);
+    strcat(filename, "_curve");
+    FILE *file = fopen(filename, "r");
+    if(file == NULL)
+    {
+        printf("cannot open %s\n", filename);
+        exit(1);
+    }
+    vector<vector<double> > lines;
+    char *buf = new char[SETS*24];
+    while(fgets(buf, SETS*24, file) != NULL)
+    {
+        vector<double> values;
+        char *p = buf, *q;
+        while(true)
+        {
+            double v = strtod(p, &q);
+            if(q == p)
+                break;
+            values.push_back(v);
+            p = q;
+        }
+        if(!values.empty())
+            lines.push_back(values);
+    }
+    delete []buf;
+    fclose(file);
+
+    if((int)lines.size() != ways+1)
+    {
+        printf("%s should have %d lines\n", filename, ways+1);
+        exit(1);
+    }
+    int n = lines[0].size();
+    for(int k = 0; k<=ways; k++)
+        if((int)lines[k].size() != n || (n != 1 && n != SETS))
+        {
+            printf("%s: line %d should have 1 or %d numbers\n", filename, k+1, SETS);
+            exit(1);
+        }
+    curve[i].assign(n*(ways+1), 0);
+    for(int s = 0; s<n; s++)
+        for(int k = 0; k<=ways; k++)
+            curve[i][s*(ways+1)+k] = lines[k][s];
+}
+
+double Interpolate(const double *c, double e)    // misses with e (fractional) ways
+{
+    if(e <= 0)
+        return c[0];
+    if(e >= ways)
+        return c[ways];
+    int k = (int)e;
+    return c[k] + (c[k+1]-c[k]) * (e-k);
+}
+
+// misses of every benchmark in one set under the given masks
+void Share(int s, const int *begin, const int *end, double *misses)
+{
+    const double *c[MAX_BENCH];
+    double effective[MAX_BENCH], pressure[MAX_BENCH];
+    for(int i = 0; i<bench_num; i++)
+    {
+        c[i] = &curve[i][s*(ways+1)];
+        pressure[i] = 1;    // begin with an even split of the shared ways
+    }
+
+    for(int iter = 0; iter<16; iter++)
+    {
+        for(int i = 0; i<bench_num; i++)
+            effective[i] = 0;
+        for(int w = 0; w<ways; w++)
+        {
+            double sum = 0;
+            int sharers = 0;
+            for(int i = 0; i<bench_num; i++)
+                if(begin[i] <= w && w <= end[i])
+                {
+                    sum += pressure[i];
+                    sharers++;
+                }
+            for(int i = 0; i<bench_num; i++)
+                if(begin[i] <= w && w <= end[i])
+                    effective[i] += sum > 0? pressure[i]/sum:1.0/sharers;
+        }
+        double change = 0;
+        for(int i = 0; i<bench_num; i++)
+        {
+            misses[i] = Interpolate(c[i], effective[i]);
+            change += fabs(misses[i] - pressure[i]);
+            pressure[i] = misses[i];
+        }
+        if(change < 1e-6)
+            break;
+    }
+}
+
+double Objective(const double *misses)
+{
+    double result = 0;
+    for(int i = 0; i<bench_num; i++)
+    {
+        if(objective == 0)
+            result += misses[i];
+        else if(objective == 1)
+            result += weight[i] * misses[i];
+        else
+        {
+            double slowdown = alone[i] > 0? misses[i]/alone[i]:1;
+            result = slowdown > result? slowdown:result;
+        }
+    }
+    return result;
+}
+
+void Evaluate(const int *begin, const int *end)
+{
+    Candidate cand;
+    for(int i = 0; i<bench_num; i++)
+    {
+        cand.misses[i] = 0;
+        cand.begin[i] = begin[i];
+        cand.end[i] = end[i];
+    }
+    double misses[MAX_BENCH];
+    for(int s = 0; s<sets; s++)
+    {
+        Share(s, begin, end, misses);
+        for(int i = 0; i<bench_num; i++)
+            cand.misses[i] += misses[i];
+    }
+    cand.value = Objective(cand.misses);
+    evaluated++;
+
+    if((int)best.size() < top_k)
+        best.push(cand);
+    else if(cand.value < best.top().value)
+    {
+        best.pop();
+        best.push(cand);
+    }
+}
+
+void Isolation(int i, int first_way, int *begin, int *end)    // enumerate the disjoint masks from benchmark i
+{
+    if(i == bench_num-1)
+    {
+        begin[i] = first_way;
+        end[i] = ways-1;
+        Evaluate(begin, end);
+        return;
+    }
+    for(int e = first_way; e <= ways-1-(bench_num-1-i); e++)
+    {
+        begin[i] = first_way;
+        end[i] = e;
+        Isolation(i+1, e+1, begin, end);
+    }
+}
+
+void Overlap(int i, int *begin, int *end)    // enumerate all the contiguous masks of benchmark i
+{
+    if(i == bench_num)
+    {
+        Evaluate(begin, end);
+        return;
+    }
+    for(int b = 0; b<ways; b++)
+        for(int e = b; e<ways; e++)
+        {
+            begin[i] = b;
+            end[i] = e;
+            Overlap(i+1, begin, end);
+        }
+}
+
+double Alone_misses(int i, int k)    // misses of benchmark i with k private ways, summed over the sets
+{
+    double result = 0;
+    for(int s = 0; s<sets; s++)
+        result += curve[i][s*(ways+1)+k];
+    return result;
+}
+
+void Lookahead(int *begin, int *end)
+{
+    int alloc[MAX_BENCH];
+    for(int i = 0; i<bench_num; i++)
+        alloc[i] = 1;
+    int balance = ways - bench_num;
+    while(balance > 0)
+    {
+        int winner = -1, winner_ways = 0;
+        double max_mu = -1;
+        for(int i = 0; i<bench_num; i++)
+        {
+            double w = objective == 1? weight[i]:1;
+            double now = Alone_misses(i, alloc[i]);
+            if(objective == 2)    // fairness: one way for the benchmark with the max slowdown
+            {
+                double mu = alone[i] > 0? now/alone[i]:0;
+                if(mu > max_mu)
+                {
+                    max_mu = mu;
+                    winner = i;
+                    winner_ways = 1;
+                }
+                continue;
+            }
+            for(int k = 1; k<=balance; k++)
+            {
+                double mu = w * (now - Alone_misses(i, alloc[i]+k)) / k;
+                if(mu > max_mu)
+                {
+                    max_mu = mu;
+                    winner = i;
+                    winner_ways = k;
+                }
+            }
+        }
+        alloc[winner] += winner_ways;
+        balance -= winner_ways;
+    }
+    int way = 0;
+    for(int i = 0; i<bench_num; i++)
+    {
+        begin[i] = way;
+        end[i] = way + alloc[i] - 1;
+        way += alloc[i];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bench_num = argc - 1;
+    if(bench_num < 2 || bench_num > MAX_BENCH || bench_num > ways)
+    {
+        printf("the number of benchmarks should be 2~%d\n", ways < MAX_BENCH? ways:MAX_BENCH);
+        exit(1);
+    }
+    printf("please input the method(0: optimal isolation, 1: UCP lookahead, 2: overlapping masks): ");
+    scanf("%d", &method);
+    printf("please input the objective(0: total misses, 1: weighted misses, 2: fairness): ");
+    scanf("%d", &objective);
+    for(int i = 0; i<bench_num; i++)
+    {
+        weight[i] = 1;
+        if(objective == 1)
+        {
+            printf("please input the weight of %s: ", argv[i+1]);
+            scanf("%lf", &weight[i]);
+        }
+    }
+    printf("please input k of the top-k allocations: ");
+    scanf("%d", &top_k);
+    if(top_k < 1)
+        top_k = 1;
+
+    strcpy(outfilename, argv[1]);
+    for(int i = 0; i<bench_num; i++)
+    {
+        Read_curve(i, argv[i+1]);
+        if(i > 0)
+        {
+            strcat(outfilename, "_");
+            strcat(outfilename, argv[i+1]);
+        }
+    }
+    strcat(outfilename, "_partition");
+
+    // per-set curves are used only when every benchmark has them
+    sets = SETS;
+    for(int i = 0; i<bench_num; i++)
+        if(curve[i].size() == (unsigned long long)(ways+1))
+            sets = 1;
+    if(sets == 1)
+        for(int i = 0; i<bench_num; i++)
+            if(curve[i].size() != (unsigned long long)(ways+1))
+            {
+                vector<double> sum(ways+1, 0);
+                for(int s = 0; s<SETS; s++)
+                    for(int k = 0; k<=ways; k++)
+                        sum[k] += curve[i][s*(ways+1)+k];
+                curve[i] = sum;
+            }
+    for(int i = 0; i<bench_num; i++)
+        alone[i] = Alone_misses(i, ways);
+
+    clock_t start = clock();
+    int begin[MAX_BENCH], end[MAX_BENCH];
+    if(method == 0)
+        Isolation(0, 0, begin, end);
+    else if(method == 1)
+    {
+        Lookahead(begin, end);
+        Evaluate(begin, end);
+    }
+    else
+    {
+        double combos = pow(ways*(ways+1)/2.0, bench_num);
+        if(combos > 5e7)
+            printf("warning: %.0f allocations to evaluate\n", combos);
+        Overlap(0, begin, end);
+    }
+    double seconds = (double)(clock()-start) / CLOCKS_PER_SEC;
+
+    vector<Candidate> result;
+    while(!best.empty())
+    {
+        result.push_back(best.top());
+        best.pop();
+    }
+    reverse(result.begin(), result.end());
+
+    outfile = fopen(outfilename, "w");
+    if(outfile == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    for(unsigned long long r = 0; r<result.size(); r++)
+    {
+        Candidate &cand = result[r];
+        fprintf(outfile, "%llu %.6f", r+1, cand.value);
+        for(int i = 0; i<bench_num; i++)
+            fprintf(outfile, " %.1f", cand.misses[i]);
+        for(int i = 0; i<bench_num; i++)
+        {
+            unsigned long long mask = 0;
+            for(int w = cand.begin[i]; w<=cand.end[i]; w++)
+                mask |= 1ULL<<w;
+            fprintf(outfile, " 0x%llx", mask);
+        }
+        if(bench_num == 2 && cand.begin[0] == 0 && cand.end[1] == ways-1)
+            fprintf(outfile, " %d %d", cand.end[0], cand.begin[1]);
+        fprintf(outfile, "\n");
+    }
+    fclose(outfile);
+
+    printf("%llu allocations evaluated in %.3fs, the best objective: %.6f\n", evaluated, seconds,
+           result.empty()? 0:result[0].value);
+    return 0;
+}
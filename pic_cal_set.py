@@ -1,16 +1,14 @@
 #-*- coding:utf-8 -*-
+import os
 import numpy as np
 import matplotlib.pyplot as plt
 from matplotlib.pyplot import MultipleLocator
 
-file = open("lbm_omnetpp_access", 'r')
-result = []
-while True:
-    line = file.readline()
-    if not line:
-        break
-    line = line.strip('\n')
-    result.append(int(line))
+# [slices][SETS] from the .npy of cal_set_slice.cpp, mmaped without parsing, or the text output of "-T"
+if os.path.exists("lbm_omnetpp_access.npy"):
+    result = np.load("lbm_omnetpp_access.npy", mmap_mode='r').reshape(-1)
+else:
+    result = np.loadtxt("lbm_omnetpp_access", dtype=np.uint64, ndmin=1)
 
 x = range(len(result))
 plt.bar(x, result, color='red', width=1.0)
@@ -1,27 +1,17 @@
 #-*- coding:utf-8 -*-
+import os
 import numpy as np
 import matplotlib.pyplot as plt
 from matplotlib.pyplot import MultipleLocator
 
-file1 = open("lbm_parest_0_0_0_1", 'r')
-file2 = open("lbm_parest_0_0_0_2", 'r')
-
-occupancy1 = []
-occupancy2 = []
-
-while True:
-    line = file1.readline()
-    if not line:
-        break
-    line = line.strip('\n')
-    occupancy1.append(int(line))
-
-while True:
-    line = file2.readline()
-    if not line:
-        break
-    line = line.strip('\n')
-    occupancy2.append(int(line))
+# [steps][2] from the .npy of occupancy.cpp, mmaped without parsing, or the text outputs of "-T"
+if os.path.exists("lbm_parest_0_0_0.npy"):
+    occupancy = np.load("lbm_parest_0_0_0.npy", mmap_mode='r')
+    occupancy1 = occupancy[:, 0]
+    occupancy2 = occupancy[:, 1]
+else:
+    occupancy1 = np.loadtxt("lbm_parest_0_0_0_1", dtype=np.int32, ndmin=1)
+    occupancy2 = np.loadtxt("lbm_parest_0_0_0_2", dtype=np.int32, ndmin=1)
 
 
 x = range(len(occupancy1))
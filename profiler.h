@@ -0,0 +1,158 @@
+/*
+ * The profiler of cal_set_slice.cpp and cal_set_slice_pipeline.cpp ("-P"): the time of every phase of a thread and,
+ * where perf_event_open is permitted, the cycles, instructions, LLC misses and dTLB misses of it, counted as one
+ * group of events. A tool switches the phases of its threads by Profiler::Switch, sums the threads by Add_profile
+ * and prints the accesses/s and the events per access of every phase by Print_profile.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+enum {PHASE_READ, PHASE_HASH, PHASE_UPDATE, PHASE_CHECKPOINT, PHASE_OUTPUT, PHASE_WAIT, PHASES};
+const char *phase_name[PHASES] = {"read/parse", "hash", "lookup/update", "checkpoint", "output", "wait"};
+#define EVENTS 4    // cycles, instructions, LLC misses, dTLB misses
+
+struct Phase_stat
+{
+    double seconds;
+    double value[EVENTS];    // scaled by the time the group was really counted, -1 when not supported
+};
+
+class Profiler    // the time and the hardware counters of the phases of a thread, switched by Profile(phase)
+{
+public:
+    int current;    // the running phase, -1 for none
+    Phase_stat stat[PHASES];
+
+    void Start(int phase);
+    void Switch(int phase);
+    void Stop();
+
+private:
+    int fd[EVENTS], slot[EVENTS], group;    // slot: the place of the event in the group, -1 when not opened
+    double last_time;
+    unsigned long long last[EVENTS+3];
+
+    void Read(double &now, unsigned long long *values);
+};
+
+void Profiler::Start(int phase)
+{
+    group = -1;
+    int opened = 0;
+    for(int e = 0; e<EVENTS; e++)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = e < 3? PERF_TYPE_HARDWARE:PERF_TYPE_HW_CACHE;
+        attr.config = e == 0? PERF_COUNT_HW_CPU_CYCLES:e == 1? PERF_COUNT_HW_INSTRUCTIONS:e == 2? PERF_COUNT_HW_CACHE_MISSES:
+                      (PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        attr.exclude_kernel = 1;    // allowed with perf_event_paranoid 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);    // this thread on any cpu
+        slot[e] = fd[e] >= 0? opened++:-1;
+        if(fd[e] >= 0 && group < 0)
+            group = fd[e];
+    }
+    memset(stat, 0, sizeof(stat));
+    current = -1;
+    Read(last_time, last);
+    current = phase;
+}
+
+void Profiler::Read(double &now, unsigned long long *values)    // values: nr, enabled, running, then the events
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = ts.tv_sec + ts.tv_nsec*1e-9;
+    memset(values, 0, sizeof(unsigned long long)*(EVENTS+3));
+    if(group >= 0 && read(group, values, sizeof(unsigned long long)*(EVENTS+3)) <= 0)
+        memset(values, 0, sizeof(unsigned long long)*(EVENTS+3));
+}
+
+void Profiler::Switch(int phase)    // the time and the events since the last switch go to the running phase
+{
+    double now;
+    unsigned long long values[EVENTS+3];
+    Read(now, values);
+    if(current >= 0)
+    {
+        stat[current].seconds += now - last_time;
+        double enabled = values[1] - last[1], running = values[2] - last[2];
+        for(int e = 0; e<EVENTS; e++)
+        {
+            if(slot[e] < 0)
+                stat[current].value[e] = -1;
+            else if(running > 0)    // multiplexed with other events, scale it up
+                stat[current].value[e] += (values[3+slot[e]] - last[3+slot[e]]) * (enabled/running);
+        }
+    }
+    current = phase;
+    last_time = now;
+    memcpy(last, values, sizeof(last));
+}
+
+void Profiler::Stop()
+{
+    Switch(-1);
+    for(int e = 0; e<EVENTS; e++)
+        if(fd[e] >= 0)
+            close(fd[e]);
+}
+
+void Add_profile(Phase_stat *total, const Phase_stat *stat)    // sum the phases of the threads
+{
+    for(int p = 0; p<PHASES; p++)
+    {
+        total[p].seconds += stat[p].seconds;
+        for(int e = 0; e<EVENTS; e++)
+            total[p].value[e] = total[p].value[e] < 0 || stat[p].value[e] < 0? -1:total[p].value[e] + stat[p].value[e];
+    }
+}
+
+void Print_profile(const Phase_stat *total, unsigned long long accesses)    // the time of all the threads is summed
+{
+    double seconds = 0;
+    for(int p = 0; p<PHASES; p++)
+        seconds += total[p].seconds;
+    printf("profile of %llu accesses, %.3f thread-seconds\n", accesses, seconds);
+    printf("%-14s %9s %6s %10s %10s %6s %10s %10s\n", "phase", "seconds", "share", "M acc/s", "cycles/acc", "IPC",
+           "LLC/acc", "dTLB/acc");
+    bool counted = false;
+    for(int p = 0; p<PHASES; p++)
+    {
+        const Phase_stat &s = total[p];
+        if(s.seconds == 0)
+            continue;
+        printf("%-14s %9.3f %5.1f%%", phase_name[p], s.seconds, seconds > 0? 100*s.seconds/seconds:0);
+        if(p == PHASE_WAIT)    // no accesses pass in it
+            printf(" %10s", "-");
+        else
+            printf(" %10.2f", accesses/s.seconds/1e6);
+        double per_access[4] = {s.value[0]/accesses, s.value[0] > 0? s.value[1]/s.value[0]:0, s.value[2]/accesses,
+                                s.value[3]/accesses};
+        for(int e = 0; e<EVENTS; e++)
+        {
+            bool valid = accesses > 0 && s.value[e] >= 0 && (e != 1 || s.value[0] >= 0);    // IPC needs both
+            if(valid)
+                printf(e == 1? " %6.2f":e == 0? " %10.2f":" %10.4f", per_access[e]);
+            else
+                printf(e == 1? " %6s":" %10s", "-");
+            counted = counted || valid;
+        }
+        printf("\n");
+    }
+    if(!counted)
+        printf("no hardware counters, perf_event_open is not permitted or not supported here\n");
+}
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * This program decodes the series of the per-set accesses and misses saved by "cal_set_slice -i/-I".
+ * Without a set, the totals of every interval are saved; with a slice and a set, the counts of the set in every interval.
+ * The counts of all the intervals of a set add up to its line in the _access and _miss outputs.
+ * Usage: g++ -std=c++11 -O2 series.cpp -o series
+ *        ./series [name] [slice_no] [set_no]    (name: [benchmark1]_[benchmark2] or [merged], as the _series file)
+ *        ./series [name]
+ * Output: [name]_series_[slice_no]_[set_no], every line is "end access miss" of an interval, where end is the
+ *         accesses at the end of the interval;
+ *         or [name]_series_total, every line is "end access miss active sparse", active is the sets accessed
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+using namespace std;
+
+char filename[200], outfilename[200];
+FILE *file, *outfile;
+
+struct Series_header    // see cal_set_slice.cpp
+{
+    char magic[8];    // "SERIES1"
+    unsigned int slices, sets;
+    unsigned long long interval;    // 0: the lengths were given by a file
+};
+
+struct Interval_header
+{
+    unsigned long long end;       // the accesses at the end of the interval
+    unsigned int active;          // the sets accessed in the interval
+    unsigned int sparse;          // 0: every set is in the columns, 1: only the active ones, listed in the index column
+    unsigned long long bytes[3];  // of the index (0 when dense), access and miss columns
+};
+
+unsigned long long Get_varint(const unsigned char *&p, const unsigned char *end)    // LEB128
+{
+    unsigned long long v = 0;
+    for(int shift = 0; p < end; shift += 7)
+    {
+        unsigned char b = *p++;
+        v |= (unsigned long long)(b & 0x7f) << shift;
+        if((b & 0x80) == 0)
+            return v;
+    }
+    printf("the series is broken\n");
+    exit(1);
+}
+
+unsigned long long Unzigzag(unsigned long long z, unsigned long long prev)
+{
+    long long delta = (long long)(z >> 1) ^ -(long long)(z & 1);
+    return prev + delta;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc != 2 && argc != 4)
+    {
+        printf("Usage: ./series [name] [slice_no] [set_no], or ./series [name]\n");
+        exit(1);
+    }
+    int chosen_slice_no = argc == 4? atoi(argv[2]):-1;
+    int chosen_set_no = argc == 4? atoi(argv[3]):-1;
+    sprintf(filename, "%s_series", argv[1]);
+    if(argc == 4)
+        sprintf(outfilename, "%s_series_%d_%d", argv[1], chosen_slice_no, chosen_set_no);
+    else
+        sprintf(outfilename, "%s_series_total", argv[1]);
+    file = fopen(filename, "rb");
+    outfile = fopen(outfilename, "w");
+    if(file == NULL || outfile == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+
+    Series_header header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || strcmp(header.magic, "SERIES1") != 0)
+    {
+        printf("%s is not a series\n", filename);
+        exit(1);
+    }
+    if(argc == 4 && (chosen_slice_no < 0 || chosen_slice_no >= (int)header.slices || chosen_set_no < 0 ||
+                     chosen_set_no >= (int)header.sets))
+    {
+        printf("the slice or the set is out of range\n");
+        exit(1);
+    }
+    unsigned long long total = (unsigned long long)header.slices*header.sets;
+    unsigned long long chosen = (unsigned long long)chosen_slice_no*header.sets + chosen_set_no;
+    vector<unsigned long long> prev[2];    // the counts of the last interval
+    prev[0].assign(total, 0);
+    prev[1].assign(total, 0);
+    vector<unsigned char> columns[3];
+    vector<unsigned long long> index;
+
+    Interval_header interval;
+    unsigned long long intervals = 0;
+    while(fread(&interval, sizeof(interval), 1, file) == 1)
+    {
+        for(int c = 0; c<3; c++)
+        {
+            columns[c].resize(interval.bytes[c]);
+            if(interval.bytes[c] > 0 && fread(columns[c].data(), 1, interval.bytes[c], file) != interval.bytes[c])
+            {
+                printf("the series is broken\n");
+                exit(1);
+            }
+        }
+
+        index.clear();    // the sets in the columns
+        const unsigned char *p = columns[0].data(), *end = p + columns[0].size();
+        if(interval.sparse)
+        {
+            unsigned long long k = ~0ULL;
+            for(unsigned int i = 0; i<interval.active; i++)
+            {
+                k += Get_varint(p, end) + 1;
+                index.push_back(k);
+            }
+        }
+        unsigned long long sum[2] = {0, 0}, value[2] = {0, 0};    // value: of the chosen set
+        for(int c = 0; c<2; c++)
+        {
+            p = columns[1+c].data();
+            end = p + columns[1+c].size();
+            unsigned long long n = interval.sparse? index.size():total;
+            unsigned long long next = 0;    // the next set of the sparse index
+            for(unsigned long long k = 0; k<total; k++)
+            {
+                unsigned long long v = 0;
+                if(!interval.sparse || (next < n && index[next] == k))
+                {
+                    v = Unzigzag(Get_varint(p, end), prev[c][k]);
+                    next++;
+                }
+                prev[c][k] = v;
+                sum[c] += v;
+                if(k == chosen)
+                    value[c] = v;
+            }
+        }
+
+        if(argc == 4)
+            fprintf(outfile, "%llu %llu %llu\n", interval.end, value[0], value[1]);
+        else
+            fprintf(outfile, "%llu %llu %llu %u %u\n", interval.end, sum[0], sum[1], interval.active, interval.sparse);
+        intervals++;
+    }
+
+    printf("%llu intervals decoded\n", intervals);
+    fclose(file);
+    fclose(outfile);
+    return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * The reader of the traces of one set, shared by occupancy.cpp, occupancy_dynamic.cpp and occupancy_mc.cpp:
+ * [benchmark]_[slice_no]_[set_no].out, or the .rle collapsed by collapse.cpp, or else the positions of the set in
+ * the per-set index [benchmark].idx built by index.cpp, gathered from the mmaped [benchmark].bin.
+ * Save and Load keep the position for the snapshots of occupancy.cpp.
+ */
+
+#ifndef SET_READER_H
+#define SET_READER_H
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct Idx_header    // see index.cpp
+{
+    char magic[8];
+    unsigned int slices, sets;
+    unsigned long long accesses;
+};
+
+struct Reader_state
+{
+    unsigned long long kind;                           // 0: .out, 1: .rle, 2: through the .idx
+    unsigned long long offset, run_addr, left, pos;    // offset: in the .out/.rle file, or in the position list
+};
+
+// the traces of the chosen set, from [benchmark]_[slice_no]_[set_no].out (or .rle) or through [benchmark].idx
+class Set_reader
+{
+public:
+    FILE *file;
+    bool rle;
+    unsigned long long run_addr, left;     // the current run of a .rle file
+    const unsigned long long *trace;       // mmaped [benchmark].bin
+    const unsigned char *data, *data_begin, *data_end;  // the position list of the set in the mmaped .idx
+    unsigned long long pos;
+
+    bool Open(const char *filename, const char *benchname, int slices, int sets, int slice_no,
+              unsigned long long set_no);
+    bool Next(unsigned long long &addr);
+    void Close();
+    void Save(Reader_state &state);
+    bool Load(const Reader_state &state);
+
+private:
+    void *map_bin, *map_idx;
+    size_t size_bin, size_idx;
+};
+
+void *Map_file(const char *filename, size_t &size)
+{
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        if(fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    size = st.st_size;
+    void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return p == MAP_FAILED? NULL:p;
+}
+
+// slices and sets: the geometry of the tool, which the .idx must have; slice_no and set_no: the chosen set
+bool Set_reader::Open(const char *filename, const char *benchname, int slices, int sets, int slice_no,
+                      unsigned long long set_no)
+{
+    map_bin = map_idx = NULL;
+    rle = false;
+    left = 0;
+    file = fopen(filename, "r");
+    if(file != NULL)
+        return true;
+
+    char tmp[200];
+    strcpy(tmp, filename);
+    strcpy(tmp+strlen(tmp)-4, ".rle");    // collapsed by collapse.cpp
+    file = fopen(tmp, "r");
+    if(file != NULL)
+    {
+        rle = true;
+        return true;
+    }
+    sprintf(tmp, "%s.bin", benchname);
+    map_bin = Map_file(tmp, size_bin);
+    sprintf(tmp, "%s.idx", benchname);
+    map_idx = Map_file(tmp, size_idx);
+    if(map_bin == NULL || map_idx == NULL)
+        return false;
+    const Idx_header *header = (const Idx_header *)map_idx;
+    if(strcmp(header->magic, "SETIDX1") != 0 || (int)header->slices != slices || (int)header->sets != sets ||
+       header->accesses != size_bin/sizeof(unsigned long long))
+    {
+        printf("%s does not match %s.bin\n", tmp, benchname);
+        return false;
+    }
+    if(slice_no < 0 || slice_no >= (int)header->slices || set_no >= header->sets)
+    {
+        printf("slice %d set %llu is not in %s (%u slices of %u sets)\n", slice_no, set_no, tmp,
+               header->slices, header->sets);
+        return false;
+    }
+    const unsigned long long *offset = (const unsigned long long *)(header+1);
+    const unsigned char *base = (const unsigned char *)(offset + 2*slices*sets+1);
+    int k = slice_no*sets + set_no;
+    data = data_begin = base + offset[k];
+    data_end = base + offset[k+1];
+    trace = (const unsigned long long *)map_bin;
+    pos = 0;
+    madvise(map_bin, size_bin, MADV_RANDOM);
+    return true;
+}
+
+bool Set_reader::Next(unsigned long long &addr)
+{
+    if(file != NULL && rle)
+    {
+        if(left == 0)
+        {
+            char tmp[100], *p;
+            if(fgets(tmp, 99, file) == NULL)
+                return false;
+            run_addr = strtoull(tmp, &p, 10);
+            left = strtoull(p, NULL, 10);
+            if(left == 0)
+                left = 1;
+        }
+        addr = run_addr;
+        left--;
+        return true;
+    }
+    if(file != NULL)
+    {
+        char tmp[100];
+        if(fgets(tmp, 99, file) == NULL)
+            return false;
+        addr = strtoull(tmp, NULL, 10);
+        return true;
+    }
+    if(data == data_end)
+        return false;
+    unsigned long long delta = 0;
+    int shift = 0;
+    while(*data & 0x80)
+    {
+        delta |= (unsigned long long)(*data++ & 0x7f) << shift;
+        shift += 7;
+    }
+    delta |= (unsigned long long)(*data++) << shift;
+    pos += delta;
+    addr = trace[pos];
+    return true;
+}
+
+void Set_reader::Close()
+{
+    if(file != NULL)
+        fclose(file);
+    if(map_bin != NULL)
+        munmap(map_bin, size_bin);
+    if(map_idx != NULL)
+        munmap(map_idx, size_idx);
+}
+
+void Set_reader::Save(Reader_state &state)
+{
+    state.kind = file == NULL? 2:rle;
+    state.offset = file != NULL? ftell(file):data - data_begin;
+    state.run_addr = run_addr;
+    state.left = left;
+    state.pos = pos;
+}
+
+bool Set_reader::Load(const Reader_state &state)    // false when the snapshot was saved from another kind of trace
+{
+    if(state.kind != (file == NULL? 2:(unsigned long long)rle)
+       || (file == NULL && state.offset > (unsigned long long)(data_end - data_begin)))
+        return false;
+    if(file != NULL)
+        fseek(file, state.offset, SEEK_SET);
+    else
+        data = data_begin + state.offset;
+    run_addr = state.run_addr;
+    left = state.left;
+    pos = state.pos;
+    return true;
+}
+
+#endif
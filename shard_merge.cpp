@@ -0,0 +1,261 @@
+/*
+ * This program merges the partial counters of the shards of "cal_set_slice -k [shards] -j [shard]" into the usual
+ * [name]_access and [name]_miss, which are the same as those of one cal_set_slice process. The sets are dealt to the
+ * shards by (slice_no*SETS+set_no) mod shards, so every set must be found in exactly one shard, and all the shards
+ * must have the same geometry and accesses.
+ * Launcher: "-l [shards]" runs cal_set_slice on this machine with 1, 2, 4, ... shards up to [shards] processes, every
+ * shard writing its stdout to [name]_shard_[shard]_of_[shards].log, merges every run and prints its wall time and
+ * the speedup over one process. The ratio is asked once and given to every shard. With "-L [name]", every shard
+ * publishes its own live page [name]_shard_[shard]_of_[shards].
+ * Precondition: ./cal_set_slice in the current directory for "-l".
+ * Usage: g++ -std=c++11 -O2 shard_merge.cpp -o shard_merge
+ *        ./shard_merge [name] [shards] [-T]    (name: [benchmark1]_[benchmark2] or [merged])
+ *        ./shard_merge -l [shards] [benchmark1] [benchmark2] (or [merged]) [options of cal_set_slice but -k and -j]
+ * Output: [name]_access.npy and [name]_miss.npy, or [name]_access and [name]_miss with "-T", as cal_set_slice.cpp
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+using namespace std;
+
+char filename[200], outfilename1[200], outfilename2[200];
+FILE *file, *outfile1, *outfile2;
+bool text = false;    // "-T", the outputs as text instead of .npy, as cal_set_slice.cpp
+
+// the header of a .npy file (format version 1.0) of little-endian [descr] values, 128 bytes (see cal_set_slice.cpp)
+void Write_npy_header(FILE *file, const char *descr, unsigned long long rows, int columns)
+{
+    char header[128];
+    memset(header, ' ', sizeof(header));
+    memcpy(header, "\x93NUMPY\x01\x00\x76\x00", 10);    // 118 bytes of the dict
+    int len = columns > 0? sprintf(header+10, "{'descr': '%s', 'fortran_order': False, 'shape': (%llu, %d), }", descr, rows, columns):
+                           sprintf(header+10, "{'descr': '%s', 'fortran_order': False, 'shape': (%llu,), }", descr, rows);
+    header[10+len] = ' ';
+    header[127] = '\n';
+    fwrite(header, 1, sizeof(header), file);
+}
+
+void Merge(const char *name, int shards)
+{
+    int slices = 0, sets = 0;
+    unsigned long long accesses = 0;
+    vector<unsigned long long> count, miss_count;
+    vector<char> found;
+    for(int j = 0; j<shards; j++)
+    {
+        sprintf(filename, "%s_shard_%d_of_%d", name, j, shards);
+        file = fopen(filename, "r");
+        if(file == NULL)
+        {
+            printf("cannot open files\n");
+            exit(1);
+        }
+        int shard, k, s, n;
+        unsigned long long a;
+        if(fscanf(file, "shard %d %d %d %d %llu", &shard, &k, &s, &n, &a) != 5 || shard != j || k != shards)
+        {
+            printf("%s is not the shard %d of %d\n", filename, j, shards);
+            exit(1);
+        }
+        if(j == 0)
+        {
+            slices = s;
+            sets = n;
+            accesses = a;
+            count.assign((size_t)slices*sets, 0);
+            miss_count.assign((size_t)slices*sets, 0);
+            found.assign((size_t)slices*sets, 0);
+        }
+        else if(s != slices || n != sets || a != accesses)
+        {
+            printf("%s differs from the shard 0: %d slices, %d sets, %llu accesses\n", filename, s, n, a);
+            exit(1);
+        }
+
+        int slice_no, set_no;
+        unsigned long long access, miss;
+        while(fscanf(file, "%d %d %llu %llu", &slice_no, &set_no, &access, &miss) == 4)
+        {
+            if(slice_no < 0 || slice_no >= slices || set_no < 0 || set_no >= sets ||
+               (slice_no*sets + set_no) % shards != j || found[slice_no*sets + set_no])
+            {
+                printf("%s: the set %d of the slice %d is not of the shard\n", filename, set_no, slice_no);
+                exit(1);
+            }
+            found[slice_no*sets + set_no] = 1;
+            count[slice_no*sets + set_no] = access;
+            miss_count[slice_no*sets + set_no] = miss;
+        }
+        fclose(file);
+    }
+    for(size_t i = 0; i<found.size(); i++)
+        if(!found[i])
+        {
+            printf("the set %d of the slice %d is missing\n", (int)(i % sets), (int)(i / sets));
+            exit(1);
+        }
+
+    sprintf(outfilename1, text? "%s_access":"%s_access.npy", name);
+    sprintf(outfilename2, text? "%s_miss":"%s_miss.npy", name);
+    outfile1 = fopen(outfilename1, "w");
+    outfile2 = fopen(outfilename2, "w");
+    if(outfile1 == NULL || outfile2 == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    if(text)
+    for(size_t i = 0; i<count.size(); i++)
+    {
+        fprintf(outfile1, "%llu\n", count[i]);
+        fprintf(outfile2, "%llu\n", miss_count[i]);
+    }
+    else    // [slices][sets]
+    {
+        Write_npy_header(outfile1, "<u8", slices, sets);
+        Write_npy_header(outfile2, "<u8", slices, sets);
+        fwrite(count.data(), sizeof(unsigned long long), count.size(), outfile1);
+        fwrite(miss_count.data(), sizeof(unsigned long long), miss_count.size(), outfile2);
+    }
+    fclose(outfile1);
+    fclose(outfile2);
+    printf("%d shards merged: %d slices, %d sets, %llu accesses\n", shards, slices, sets, accesses);
+}
+
+double Launch(const char *name, int shards, int ratio, int argc, char *argv[])    // the wall time of the run
+{
+    auto start = chrono::steady_clock::now();
+    vector<pid_t> pids;
+    for(int j = 0; j<shards; j++)
+    {
+        int fd[2];
+        if(pipe(fd) != 0)
+        {
+            printf("cannot create pipes\n");
+            exit(1);
+        }
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            char k[16], shard[16];
+            sprintf(k, "%d", shards);
+            sprintf(shard, "%d", j);
+            sprintf(filename, "%s_shard_%d_of_%d.log", name, j, shards);
+            int log = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if(log < 0)
+                _exit(1);
+            dup2(fd[0], 0);
+            dup2(log, 1);
+            close(fd[0]);
+            close(fd[1]);
+            close(log);
+            vector<char *> args;
+            args.push_back((char *)"./cal_set_slice");
+            for(int i = 0; i<argc; i++)
+                args.push_back(argv[i]);
+            args.push_back((char *)"-k");
+            args.push_back(k);
+            args.push_back((char *)"-j");
+            args.push_back(shard);
+            args.push_back(NULL);
+            execv(args[0], args.data());
+            _exit(127);
+        }
+        close(fd[0]);
+        if(ratio > 0)    // the answer to "please input ratio"
+        {
+            char line[16];
+            int len = sprintf(line, "%d\n", ratio);
+            if(write(fd[1], line, len) != len)
+                printf("cannot give the ratio to the shard %d\n", j);
+        }
+        close(fd[1]);
+        pids.push_back(pid);
+    }
+    for(int j = 0; j<shards; j++)
+    {
+        int status;
+        waitpid(pids[j], &status, 0);
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            printf("the shard %d of %d failed, see %s_shard_%d_of_%d.log\n", j, shards, name, j, shards);
+            exit(1);
+        }
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc >= 4 && strcmp(argv[1], "-l") == 0)
+    {
+        int max_shards = atoi(argv[2]);
+        const char *names[2];
+        int name_num = 0;
+        for(int i = 3; i<argc; i++)
+        {
+            if(argv[i][0] == '-')
+            {
+                if(strcmp(argv[i], "-T") == 0)    // the shards of one process write text
+                    text = true;
+                if(strcmp(argv[i], "-k") == 0 || strcmp(argv[i], "-j") == 0)
+                {
+                    printf("-k and -j are given to every shard by the launcher\n");
+                    exit(1);
+                }
+                if(argv[i][1] != 0 && strchr("crfwdspiImCL", argv[i][1]) != NULL && argv[i][2] == 0)    // the options with a value
+                    i++;
+            }
+            else if(name_num < 2)
+                names[name_num++] = argv[i];
+        }
+        if(max_shards < 1 || name_num == 0)
+        {
+            printf("Usage: ./shard_merge -l [shards] [benchmark1] [benchmark2] (or [merged]) [options]\n");
+            exit(1);
+        }
+        char name[200];
+        int ratio = 0;
+        if(name_num == 1)
+            strcpy(name, names[0]);
+        else
+        {
+            sprintf(name, "%s_%s", names[0], names[1]);
+            printf("please input ratio: ");
+            scanf("%d", &ratio);
+        }
+
+        double base = 0;
+        for(int shards = 1; shards <= max_shards; shards = shards < max_shards && shards*2 > max_shards? max_shards:shards*2)
+        {
+            double seconds = Launch(name, shards, ratio, argc-3, argv+3);
+            if(shards == 1)
+            {
+                base = seconds;    // one process writes the usual outputs
+                printf("1 shard: %.3f s\n", seconds);
+            }
+            else
+            {
+                Merge(name, shards);
+                printf("%d shards: %.3f s, speedup %.2f\n", shards, seconds, base/seconds);
+            }
+        }
+        return 0;
+    }
+
+    if(argc == 4 && strcmp(argv[3], "-T") == 0)
+        text = true;
+    if((argc != 3 && !text) || atoi(argv[2]) < 1)
+    {
+        printf("Usage: ./shard_merge [name] [shards] [-T], or ./shard_merge -l [shards] [benchmark1] [benchmark2] (or [merged]) [options]\n");
+        exit(1);
+    }
+    Merge(argv[1], atoi(argv[2]));
+    return 0;
+}
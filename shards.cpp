@@ -0,0 +1,483 @@
+/*
+ * This program estimates the miss-ratio curves (MRC) of a LRU-based last level cache with SHARDS,
+ * i.e. spatially hashed sampling of cache lines, based on cal_set_slice.cpp.
+ * The target is to get the MRCs of the whole cache and of every slice much faster than exact simulation.
+ * A line is sampled iff hash(line) mod P < T, so every access of a sampled line is kept and the reuse
+ * distances of the sampled lines are scaled by 1/R (R = T/P).
+ * Two modes are supported:
+ *   fixed-rate: R is constant, the memory grows with the sampled footprint;
+ *   fixed-size: at most s_max lines are tracked (derived from the memory budget), half of them by the whole cache
+ *               and half by the slices, T is lowered adaptively by evicting the lines with the largest hash values
+ *               (SHARDS_adj correction is applied).
+ * The cache size of the curve is measured in ways: k ways means k*SETS*slices lines for the whole cache
+ * and k*SETS lines for a slice, i.e. the sets are assumed to be used uniformly (see occupancy.cpp).
+ * So the curves model a fully associative LRU cache of that many lines, not the sets of cal_set_slice.cpp: the
+ * exact curves are the same model with every line sampled, which measures the sampling error only. The error
+ * of the model itself is measured against the set-associative engine: when [benchmark1]_[benchmark2]_access(.npy)
+ * and _miss(.npy) of "cal_set_slice [benchmark1] [benchmark2]" with the same ratio are found, the miss ratios of
+ * the whole cache and of every slice there, with its `ways` ways, are printed beside the curves at `ways` ways.
+ * The time of a pass includes reading and parsing the text traces, the same for every rate, which bounds the
+ * speedup of a low rate over the exact pass (see the speedup printed with the comparison).
+ * Precondition: same as cal_set_slice.cpp.
+ * A benchmark alone gives the curve that partition.cpp reads: "./shards [benchmark]", then "./partition" over the
+ * [benchmark]_curve of every co-run benchmark.
+ * Usage: g++ -std=c++11 -O2 shards.cpp -o shards
+ *        ./shards [benchmark1] [benchmark2]
+ *        ./shards [benchmark]    (alone, the ratio is not asked)
+ * Input: follow the hints
+ * Output: the miss ratios of 1~max_ways ways, saved as [benchmark1]_[benchmark2]_mrc ([benchmark]_mrc), every line is
+ *         "ways whole slice0 slice1 ... slice(slices-1)";
+ *         the misses of the whole cache with 0~ways ways (the accesses, then the miss ratio of k ways times the
+ *         accesses), one a line, saved as [benchmark1]_[benchmark2]_curve ([benchmark]_curve) for partition.cpp.
+ *         When compared with the exact engine, the exact curves are saved as [benchmark1]_[benchmark2]_mrc_exact
+ *         and the errors and the speedup are printed, and the miss ratios of cal_set_slice.cpp when found.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <unordered_map>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include "slice_map.h"
+using namespace std;
+
+char benchname1[20], benchname2[20], runname[50];    // runname: [benchmark1]_[benchmark2], or [benchmark] alone
+char filename1[30], filename2[30], outfilename[100], exactfilename[100], curvefilename[100];
+FILE *file1, *file2, *outfile, *exactfile, *curvefile;
+int slices = 8, set_bits = 11, block_bits = 6, ways = 11;
+int max_ways = 22;    // the largest cache size of the curves, in ways
+int ratio;    // benchmark1:benchmark2
+#define SETS 2048    // 2^set_bits
+#define MODULUS (1ULL<<24)    // P of SHARDS
+
+class Shards
+{
+public:
+    unsigned long long threshold;     // T, a line is sampled iff hash%P < T
+    unsigned long long s_max;         // the max number of tracked lines, 0 means fixed-rate
+    unsigned long long lines_per_way; // the lines of one way in the modelled cache
+    unordered_map<unsigned long long, unsigned long long> last_time;   // line -> timestamp of its last access
+    set<pair<unsigned long long, unsigned long long> > by_hash;         // (hash, line), only for fixed-size
+    vector<int> tree;                 // Fenwick tree, marks the last access of every tracked line
+    unsigned long long now;           // the next timestamp
+    vector<double> hist;              // hist[b]: the scaled references whose distance is in [b, b+1) ways, hist[max_ways]: farther or cold
+    double sampled, total;            // the number of sampled references, the number of all references
+
+    Shards(unsigned long long t, unsigned long long s, unsigned long long lpw);
+    void Access(unsigned long long line, unsigned long long hash);
+    void Curve(double *result);
+
+private:
+    void Add(unsigned long long pos, int val);
+    long long Sum(unsigned long long pos);     // sum of [0, pos)
+    void Compact();
+    void Evict();
+};
+
+Shards::Shards(unsigned long long t, unsigned long long s, unsigned long long lpw)
+{
+    threshold = t;
+    s_max = s;
+    lines_per_way = lpw;
+    now = 0;
+    sampled = 0;
+    total = 0;
+    unsigned long long cap = 1<<16;
+    while(s_max != 0 && cap < 2*s_max)
+        cap <<= 1;
+    tree.assign(cap+1, 0);
+    hist.assign(max_ways+1, 0);
+}
+
+void Shards::Add(unsigned long long pos, int val)
+{
+    for(pos++; pos<tree.size(); pos += pos&(-pos))
+        tree[pos] += val;
+}
+
+long long Shards::Sum(unsigned long long pos)
+{
+    long long result = 0;
+    for(; pos>0; pos -= pos&(-pos))
+        result += tree[pos];
+    return result;
+}
+
+void Shards::Compact()    // renumber the timestamps of the tracked lines, keeping their order
+{
+    vector<pair<unsigned long long, unsigned long long> > order;    // (timestamp, line)
+    order.reserve(last_time.size());
+    for(auto it = last_time.begin(); it != last_time.end(); it++)
+        order.push_back(make_pair(it->second, it->first));
+    sort(order.begin(), order.end());
+
+    unsigned long long cap = tree.size()-1;
+    while(cap < 2*order.size())
+        cap <<= 1;
+    tree.assign(cap+1, 0);
+    for(unsigned long long i = 0; i<order.size(); i++)
+    {
+        last_time[order[i].second] = i;
+        Add(i, 1);
+    }
+    now = order.size();
+}
+
+void Shards::Evict()    // lower the threshold until at most s_max lines are tracked
+{
+    while(last_time.size() > s_max)
+    {
+        unsigned long long hash = by_hash.rbegin()->first;
+        threshold = hash;
+        while(!by_hash.empty() && by_hash.rbegin()->first >= hash)
+        {
+            unsigned long long line = by_hash.rbegin()->second;
+            Add(last_time[line], -1);
+            last_time.erase(line);
+            by_hash.erase(--by_hash.end());
+        }
+    }
+}
+
+void Shards::Access(unsigned long long line, unsigned long long hash)
+{
+    total++;
+    if(hash >= threshold)    // not sampled
+        return;
+
+    double weight = (double)MODULUS / threshold;    // 1/R
+    sampled++;
+    if(now+1 >= tree.size())
+        Compact();
+
+    auto found = last_time.find(line);
+    if(found != last_time.end())
+    {
+        unsigned long long distance = Sum(now) - Sum(found->second+1);   // distinct lines since the last access
+        double scaled = distance * weight / lines_per_way;
+        int bucket = scaled >= max_ways? max_ways:(int)scaled;
+        hist[bucket] += weight;
+        Add(found->second, -1);
+        found->second = now;
+    }
+    else
+    {
+        hist[max_ways] += weight;    // cold miss
+        last_time[line] = now;
+        if(s_max != 0)
+            by_hash.insert(make_pair(hash, line));
+    }
+    Add(now, 1);
+    now++;
+
+    if(s_max != 0 && last_time.size() > s_max)
+        Evict();
+}
+
+void Shards::Curve(double *result)    // result[k-1]: the miss ratio with k ways
+{
+    vector<double> h = hist;
+    double sum = 0;
+    for(int i = 0; i<=max_ways; i++)
+        sum += h[i];
+    if(s_max != 0 && sum > 0)    // SHARDS_adj: move the sampling error into the smallest distance
+    {
+        h[0] += total - sum;    // the weighted references should sum up to all the references
+        sum = total;
+    }
+    for(int k = 1; k<=max_ways; k++)
+    {
+        double miss = 0;
+        for(int i = k; i<=max_ways; i++)
+            miss += h[i];
+        result[k-1] = sum > 0? miss/sum:0;
+    }
+}
+
+unsigned long long Hash(unsigned long long x)    // splitmix64 finalizer
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+Shards *whole, **slice_shards;
+
+void Access(unsigned long long addr)
+{
+    unsigned long long line = addr >> block_bits;
+    unsigned long long hash = Hash(line) & (MODULUS-1);
+    whole->Access(line, hash);
+    if(whole->s_max == 0 && hash >= whole->threshold)    // fixed-rate: skip Cal_slice for unsampled lines
+        return;
+    slice_shards[Cal_slice(addr)]->Access(line, hash);
+}
+
+double Run(unsigned long long threshold, unsigned long long s_max)    // one pass over the traces, returns the seconds used
+{
+    file1 = fopen(filename1, "r");
+    file2 = benchname2[0] != 0? fopen(filename2, "r"):NULL;
+    if(file1 == NULL || (benchname2[0] != 0 && file2 == NULL))
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+    whole = new Shards(threshold, s_max/2, (unsigned long long)SETS*slices);    // the budget is split in half
+    slice_shards = new Shards*[slices];
+    for(int i = 0; i<slices; i++)
+        slice_shards[i] = new Shards(threshold, s_max/2/slices, SETS);
+
+    clock_t begin = clock();
+    char tmp1[100], tmp2[100];
+    if(benchname2[0] == 0)    // alone
+        while(fgets(tmp1, 99, file1) != NULL)
+            Access(strtoull(tmp1, NULL, 10));
+    else
+    while(fgets(tmp1, 99, file1) != NULL && fgets(tmp2, 99, file2) != NULL)   // end with either file finished
+    {
+        unsigned long long addr1 = strtoull(tmp1, NULL, 10);
+        unsigned long long addr2 = strtoull(tmp2, NULL, 10);
+        addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
+        Access(addr1);
+
+        int counter = ratio - 1;
+        while(counter--)
+        {
+            if(fgets(tmp1, 99, file1) != NULL)
+            {
+                addr1 = strtoull(tmp1, NULL, 10);
+                addr1 = addr1 + ((unsigned long long)1<<53);  // distinguish different benchmark
+                Access(addr1);
+            }
+            else
+                break;
+        }
+
+        Access(addr2);
+    }
+    double seconds = (double)(clock()-begin) / CLOCKS_PER_SEC;
+
+    fclose(file1);
+    if(file2 != NULL)
+        fclose(file2);
+    return seconds;
+}
+
+// the miss ratios of the whole cache and of every slice ([0] and [i+1]) from the outputs of cal_set_slice.cpp,
+// .npy or text (-T); false when there are none
+bool Load_set_associative(double *miss_ratio)
+{
+    vector<unsigned long long> count[2];
+    const char *kind[2] = {"access", "miss"};
+    for(int k = 0; k<2; k++)
+    {
+        char filename[200];
+        sprintf(filename, "%s_%s.npy", runname, kind[k]);
+        FILE *file = fopen(filename, "rb");
+        if(file != NULL)    // uint64 [slices][SETS] after the header
+        {
+            unsigned char pre[10];
+            count[k].resize((size_t)slices*SETS);
+            if(fread(pre, 1, 10, file) != 10 || memcmp(pre, "\x93NUMPY", 6) != 0 || fseek(file, 10 + pre[8] + pre[9]*256, SEEK_SET) != 0 ||
+               fread(count[k].data(), sizeof(unsigned long long), count[k].size(), file) != count[k].size())
+            {
+                printf("%s is not the output of cal_set_slice\n", filename);
+                exit(1);
+            }
+        }
+        else
+        {
+            sprintf(filename, "%s_%s", runname, kind[k]);
+            file = fopen(filename, "r");
+            if(file == NULL)
+                return false;
+            unsigned long long c;
+            while(fscanf(file, "%llu", &c) == 1)
+                count[k].push_back(c);
+            if(count[k].size() != (size_t)slices*SETS)
+            {
+                printf("%s is not the output of cal_set_slice\n", filename);
+                exit(1);
+            }
+        }
+        fclose(file);
+    }
+    double access = 0, miss = 0;
+    for(int i = 0; i<slices; i++)
+    {
+        double slice_access = 0, slice_miss = 0;
+        for(int j = 0; j<SETS; j++)
+        {
+            slice_access += count[0][(size_t)i*SETS+j];
+            slice_miss += count[1][(size_t)i*SETS+j];
+        }
+        miss_ratio[i+1] = slice_access > 0? slice_miss/slice_access:0;
+        access += slice_access;
+        miss += slice_miss;
+    }
+    miss_ratio[0] = access > 0? miss/access:0;
+    return true;
+}
+
+void Save(FILE *file, double curves[][64])    // curves[0]: whole, curves[i+1]: slice i
+{
+    for(int k = 1; k<=max_ways; k++)
+    {
+        fprintf(file, "%d", k);
+        for(int i = 0; i<=slices; i++)
+            fprintf(file, " %.6f", curves[i][k-1]);
+        fprintf(file, "\n");
+    }
+}
+
+void Collect(double curves[][64])
+{
+    whole->Curve(curves[0]);
+    for(int i = 0; i<slices; i++)
+        slice_shards[i]->Curve(curves[i+1]);
+    delete whole;
+    for(int i = 0; i<slices; i++)
+        delete slice_shards[i];
+    delete []slice_shards;
+}
+
+int main(int argc, char *argv[])
+{
+    int mode, compare;
+    double rate = 0.01, budget = 0;
+    unsigned long long s_max = 0;
+    if(argc < 2)
+    {
+        printf("Usage: ./shards [benchmark1] [benchmark2], or ./shards [benchmark]\n");
+        exit(1);
+    }
+
+    if(argc > 2)
+    {
+        printf("please input ratio: ");
+        scanf("%d", &ratio);
+    }
+    printf("please input the mode(0: fixed-rate, 1: fixed-size): ");
+    scanf("%d", &mode);
+    if(mode == 0)
+    {
+        printf("please input the sampling rate(e.g. 0.01): ");
+        scanf("%lf", &rate);
+    }
+    else
+    {
+        printf("please input the memory budget(MB): ");
+        scanf("%lf", &budget);
+        s_max = (unsigned long long)(budget*1024*1024 / 128);    // about 128 bytes for a tracked line in the two maps and the tree
+        if(s_max < (unsigned long long)slices*128)    // at least 64 lines for every slice
+            s_max = slices*128;
+        rate = 1;
+    }
+    printf("compare with the exact engine(0/1): ");
+    scanf("%d", &compare);
+    if(max_ways > 64 || ways > max_ways || rate <= 0 || rate > 1)
+    {
+        printf("wrong parameters\n");
+        exit(1);
+    }
+    strcpy(benchname1, argv[1]);
+    strcpy(benchname2, argc > 2? argv[2]:"");
+    strcpy(filename1, benchname1);
+    strcpy(filename2, benchname2);
+    strcat(filename1, ".out");
+    strcat(filename2, ".out");
+    strcpy(runname, benchname1);
+    if(argc > 2)
+    {
+        strcat(runname, "_");
+        strcat(runname, benchname2);
+    }
+    strcpy(outfilename, runname);
+    strcat(outfilename, "_mrc");
+    strcpy(curvefilename, runname);
+    strcat(curvefilename, "_curve");
+    strcpy(exactfilename, outfilename);
+    strcat(exactfilename, "_exact");
+
+    outfile = fopen(outfilename, "w");
+    curvefile = fopen(curvefilename, "w");
+    if(outfile == NULL || curvefile == NULL)
+    {
+        printf("cannot open files\n");
+        exit(1);
+    }
+
+    static double sampled_curves[65][64], exact_curves[65][64];
+    unsigned long long threshold = (unsigned long long)(rate * MODULUS);
+    if(threshold == 0)
+        threshold = 1;
+    double sampled_seconds = Run(threshold, s_max);
+    double final_rate = (double)whole->threshold / MODULUS;
+    double accesses = whole->total;
+    Collect(sampled_curves);
+    Save(outfile, sampled_curves);
+    fclose(outfile);
+    fprintf(curvefile, "%.0f\n", accesses);    // all miss with 0 ways
+    for(int k = 1; k<=ways; k++)
+        fprintf(curvefile, "%.0f\n", sampled_curves[0][k-1]*accesses);
+    fclose(curvefile);
+    printf("sampled: %.3fs, final sampling rate: %.6f\n", sampled_seconds, final_rate);
+
+    if(compare)
+    {
+        exactfile = fopen(exactfilename, "w");
+        if(exactfile == NULL)
+        {
+            printf("cannot open files\n");
+            exit(1);
+        }
+        double exact_seconds = Run(MODULUS, 0);
+        Collect(exact_curves);
+        Save(exactfile, exact_curves);
+        fclose(exactfile);
+
+        // mean absolute error of the miss ratios over all the cache sizes
+        for(int i = 0; i<=slices; i++)
+        {
+            double error = 0, max_error = 0;
+            for(int k = 0; k<max_ways; k++)
+            {
+                double e = fabs(sampled_curves[i][k] - exact_curves[i][k]);
+                error += e;
+                max_error = e > max_error? e:max_error;
+            }
+            if(i == 0)
+                printf("whole:   MAE %.6f, max error %.6f\n", error/max_ways, max_error);
+            else
+                printf("slice %d: MAE %.6f, max error %.6f\n", i-1, error/max_ways, max_error);
+        }
+        printf("exact: %.3fs, speedup: %.1fx\n", exact_seconds, exact_seconds/sampled_seconds);
+
+        double set_associative[65];
+        if(ways <= max_ways && Load_set_associative(set_associative))
+        {
+            printf("at %d ways, set-associative (cal_set_slice) / exact fully associative / sampled:\n", ways);
+            for(int i = 0; i<=slices; i++)
+            {
+                if(i == 0)
+                    printf("whole:  ");
+                else
+                    printf("slice %d:", i-1);
+                printf(" %.6f / %.6f / %.6f, error of the model %+.6f, of the sampled curve %+.6f\n", set_associative[i],
+                       exact_curves[i][ways-1], sampled_curves[i][ways-1], exact_curves[i][ways-1] - set_associative[i],
+                       sampled_curves[i][ways-1] - set_associative[i]);
+            }
+        }
+        else
+            printf("no outputs of cal_set_slice for %s, the set-associative engine is not compared\n", runname);
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * This program checks a slice map of cal_set_slice.cpp and filter.cpp (see Load_slice_map of slice_map.h, which all
+ * three include) before a long run:
+ *   the table: every slice must be reachable, and the indexes of every slice are counted;
+ *   uniformity: the slices of 4M random line addresses below 2^46, the largest deviation from the mean and chi-square
+ *               (about slices-1 for a uniform hash);
+ *   samples:    with "-s [samples]", every line "address slice" (decimal or 0x hex), e.g. measured on the machine
+ *               with the uncore counters, must be mapped to the same slice, the first mismatches are printed;
+ *   trace:      with "-t [benchmark]", the accesses of [benchmark].out on every slice;
+ *   speed:      ns for the slice of an address.
+ * "builtin" is the 8 slices of Cal_slice, whose XOR form is also checked against Cal_slice; "-d" prints that form
+ * as a slice map, a template for new ones.
+ * Usage: g++ -std=c++11 -O2 slice_map.cpp -o slice_map
+ *        ./slice_map [slice_map] [-s samples] [-t benchmark]    (slice_map: a file, or builtin)
+ *        ./slice_map -d
+ * Output: the checks are printed, and the exit code is 1 when a slice is unreachable or a sample is mismatched
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include "slice_map.h"
+using namespace std;
+
+int slices = 8, set_bits = 11, block_bits = 6;
+#define RANDOM_LINES (1<<22)
+#define PHYSICAL_BITS 46
+
+unsigned long long Random()    // 62 random bits, rand() gives at least 31
+{
+    return ((unsigned long long)rand() << 31) | rand();
+}
+
+void Builtin_masks(unsigned long long *mask)    // the XOR form of Cal_slice, bit i of the slice from every address bit
+{
+    for(int i = 0; i<3; i++)
+    {
+        mask[i] = 0;
+        for(int b = 0; b<64; b++)
+            if((Cal_slice(1ULL << b) >> i) & 1)
+                mask[i] |= 1ULL << b;
+    }
+}
+
+void Print_counts(const char *what, const vector<unsigned long long> &n)
+{
+    unsigned long long total = 0, max_n = 0, min_n = ~0ULL;
+    for(int s = 0; s<slices; s++)
+    {
+        total += n[s];
+        max_n = n[s] > max_n? n[s]:max_n;
+        min_n = n[s] < min_n? n[s]:min_n;
+    }
+    double mean = (double)total/slices, chi = 0;
+    for(int s = 0; s<slices; s++)
+        chi += (n[s]-mean)*(n[s]-mean)/(mean > 0? mean:1);
+    printf("%s: %llu on %d slices, min %llu, max %llu, the largest deviation from the mean %.2f%%, chi-square %.1f\n",
+           what, total, slices, min_n, max_n, mean > 0? 100*(max_n-mean > mean-min_n? max_n-mean:mean-min_n)/mean:0, chi);
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc >= 2 && strcmp(argv[1], "-d") == 0)
+    {
+        unsigned long long mask[3];
+        Builtin_masks(mask);
+        printf("# the 8 slices of Cal_slice\nslices 8\n");
+        for(int i = 0; i<3; i++)
+            printf("xor 0x%llx\n", mask[i]);
+        return 0;
+    }
+    if(argc < 2)
+    {
+        printf("Usage: ./slice_map [slice_map] [-s samples] [-t benchmark], or ./slice_map -d\n");
+        exit(1);
+    }
+    char *samples_filename = NULL, *benchname = NULL;
+    for(int i = 2; i+1<argc; i += 2)
+    {
+        if(strcmp(argv[i], "-s") == 0)
+            samples_filename = argv[i+1];
+        else if(strcmp(argv[i], "-t") == 0)
+            benchname = argv[i+1];
+    }
+    bool builtin = strcmp(argv[1], "builtin") == 0, ok = true;
+    if(!builtin)
+        slices = Load_slice_map(argv[1]);
+    printf("%d slices, %s\n", slices, builtin? "Cal_slice":slice_table != NULL? "XOR index and table":"XOR index");
+
+    if(builtin)    // the XOR form must be the same as Cal_slice
+    {
+        Builtin_masks(hash_mask);
+        srand(1);
+        unsigned long long wrong = 0;
+        for(int k = 0; k<RANDOM_LINES; k++)
+        {
+            unsigned long long addr = Random();
+            hash_bits = 3;
+            int s = Map_slice(addr);
+            hash_bits = 0;
+            wrong += s != Map_slice(addr);
+        }
+        printf("the XOR form of Cal_slice %s\n", wrong == 0? "agrees with it":"DISAGREES with it");
+        ok = ok && wrong == 0;
+    }
+
+    if(slice_table != NULL)
+    {
+        vector<unsigned long long> n(slices, 0);
+        for(int i = 0; i<(1 << hash_bits); i++)
+            n[slice_table[i]]++;
+        for(int s = 0; s<slices; s++)
+            if(n[s] == 0)
+            {
+                printf("slice %d is not in the table\n", s);
+                ok = false;
+            }
+        Print_counts("the indexes of the table", n);
+    }
+
+    vector<unsigned long long> addrs(RANDOM_LINES);
+    srand(2);
+    for(int k = 0; k<RANDOM_LINES; k++)
+        addrs[k] = (Random() & ((1ULL << PHYSICAL_BITS) - 1)) & ~((1ULL << block_bits) - 1);
+    vector<unsigned long long> n(slices, 0);
+    timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(int k = 0; k<RANDOM_LINES; k++)
+        n[Map_slice(addrs[k])]++;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    Print_counts("random lines", n);
+    printf("%.2f ns for the slice of an address\n", ((t1.tv_sec - t0.tv_sec)*1e9 + (t1.tv_nsec - t0.tv_nsec))/RANDOM_LINES);
+
+    if(samples_filename != NULL)
+    {
+        FILE *file = fopen(samples_filename, "r");
+        if(file == NULL)
+        {
+            printf("cannot open files\n");
+            exit(1);
+        }
+        char tmp[200], *p;
+        unsigned long long samples = 0, wrong = 0;
+        while(fgets(tmp, 199, file) != NULL)
+        {
+            if(tmp[0] == '#' || tmp[0] == '\n')
+                continue;
+            unsigned long long addr = strtoull(tmp, &p, 0);
+            int measured = strtol(p, NULL, 0), s = Map_slice(addr);
+            samples++;
+            if(s != measured && wrong++ < 10)
+                printf("address 0x%llx: slice %d measured, %d mapped\n", addr, measured, s);
+        }
+        fclose(file);
+        printf("%llu of %llu samples mapped to the slices measured\n", samples-wrong, samples);
+        ok = ok && wrong == 0;
+    }
+
+    if(benchname != NULL)
+    {
+        char filename[200], tmp[100];
+        sprintf(filename, "%s.out", benchname);
+        FILE *file = fopen(filename, "r");
+        if(file == NULL)
+        {
+            printf("cannot open files\n");
+            exit(1);
+        }
+        vector<unsigned long long> n(slices, 0);
+        while(fgets(tmp, 99, file) != NULL)
+            n[Map_slice(strtoull(tmp, NULL, 10))]++;
+        fclose(file);
+        Print_counts("the accesses of the trace", n);
+    }
+
+    return ok? 0:1;
+}
@@ -0,0 +1,104 @@
+/*
+ * The slice hash of the sliced LLC, shared by every tool that splits a trace into slices, so that they all split it
+ * into the same sets and the checks of slice_map.cpp are those of the map the simulator reads: Cal_slice, the 8
+ * slices by default, and the slice map of a file given by "-m" (see Load_slice_map; cal_set_slice.cpp, the pipeline,
+ * filter.cpp and index.cpp), a linear XOR hash of the address bits to an index, and a table from the index to the
+ * slice for a number of slices not a power of 2.
+ */
+
+#ifndef SLICE_MAP_H
+#define SLICE_MAP_H
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+int Cal_slice(unsigned long long addr)
+{
+    unsigned long long result = 0;
+    result += ((addr>>37)&1) ^ ((addr>>36)&1) ^ ((addr>>35)&1) ^ ((addr>>34)&1) ^ ((addr>>31)&1) ^ ((addr>>30)&1)
+              ^ ((addr>>27)&1) ^ ((addr>>26)&1) ^ ((addr>>23)&1) ^ ((addr>>22)&1) ^ ((addr>>19)&1) ^ ((addr>>16)&1)
+              ^ ((addr>>13)&1) ^ ((addr>>12)&1) ^ ((addr>>8)&1);
+    result = result << 1;
+    result += ((addr>>37)&1) ^ ((addr>>35)&1) ^ ((addr>>34)&1) ^ ((addr>>33)&1) ^ ((addr>>31)&1) ^ ((addr>>29)&1)
+              ^ ((addr>>28)&1) ^ ((addr>>26)&1) ^ ((addr>>24)&1) ^ ((addr>>23)&1) ^ ((addr>>22)&1) ^ ((addr>>21)&1)
+              ^ ((addr>>20)&1) ^ ((addr>>19)&1) ^ ((addr>>17)&1) ^ ((addr>>15)&1) ^ ((addr>>13)&1) ^ ((addr>>11)&1)
+              ^ ((addr>>7)&1);
+    result = result << 1;
+    result += ((addr>>36)&1) ^ ((addr>>35)&1) ^ ((addr>>33)&1) ^ ((addr>>32)&1) ^ ((addr>>30)&1) ^ ((addr>>28)&1)
+              ^ ((addr>>27)&1) ^ ((addr>>26)&1) ^ ((addr>>25)&1) ^ ((addr>>24)&1) ^ ((addr>>22)&1) ^ ((addr>>20)&1)
+              ^ ((addr>>18)&1) ^ ((addr>>17)&1) ^ ((addr>>16)&1) ^ ((addr>>14)&1) ^ ((addr>>12)&1) ^ ((addr>>10)&1)
+              ^ ((addr>>6)&1);
+    return result;
+}
+
+#define MAX_HASH_BITS 16
+int hash_bits = 0;                              // 0: Cal_slice, the XOR hash of 8 slices
+unsigned long long hash_mask[MAX_HASH_BITS];    // bit i of the index is the parity of the address bits in hash_mask[i]
+unsigned short *slice_table;                    // the slice of every index, NULL when the index is the slice
+
+// the slice map of a file, e.g. for 24 slices:
+//   slices 24
+//   xor 0x1b5f575440    (bit 0 of the index, one line for every bit)
+//   ...
+//   table 0 1 2 ...     (2^bits slices, optional when slices is 2^bits)
+// '#' begins a comment
+int Load_slice_map(const char *filename)    // the slices of the map
+{
+    FILE *file = fopen(filename, "r");
+    if(file == NULL)
+    {
+        printf("cannot open %s\n", filename);
+        exit(1);
+    }
+    int map_slices = 0, table_len = 0;
+    char word[100];
+    while(fscanf(file, "%99s", word) == 1)
+    {
+        if(word[0] == '#')
+        {
+            int c;
+            while((c = fgetc(file)) != '\n' && c != EOF)
+                ;
+        }
+        else if(strcmp(word, "slices") == 0 && fscanf(file, "%d", &map_slices) == 1)
+            ;
+        else if(strcmp(word, "xor") == 0 && hash_bits < MAX_HASH_BITS && fscanf(file, "%llx", &hash_mask[hash_bits]) == 1)
+            hash_bits++;
+        else if(strcmp(word, "table") == 0 && hash_bits > 0 && slice_table == NULL)
+        {
+            table_len = 1 << hash_bits;
+            slice_table = new unsigned short[table_len];
+            for(int i = 0; i<table_len; i++)
+                if(fscanf(file, "%hu", &slice_table[i]) != 1 || slice_table[i] >= map_slices)
+                {
+                    printf("%s: the table needs %d slices of 0~%d\n", filename, table_len, map_slices-1);
+                    exit(1);
+                }
+        }
+        else
+        {
+            printf("%s: cannot read \"%s\", the xor lines go before the table\n", filename, word);
+            exit(1);
+        }
+    }
+    fclose(file);
+    if(map_slices <= 0 || hash_bits == 0 || (slice_table == NULL && map_slices != 1 << hash_bits))
+    {
+        printf("%s: a slice map needs slices, the xor masks, and a table unless slices is 2^(xor masks)\n", filename);
+        exit(1);
+    }
+    return map_slices;
+}
+
+int Map_slice(unsigned long long addr)
+{
+    if(hash_bits == 0)
+        return Cal_slice(addr);
+    unsigned int index = 0;
+    for(int i = 0; i<hash_bits; i++)
+        index |= __builtin_parityll(addr & hash_mask[i]) << i;
+    return slice_table != NULL? slice_table[index]:index;
+}
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * The set of occupancy_dynamic.cpp, which oracle.cpp checks against the reference: the state is indexed by way, so
+ * the allocation can change at any time as intel CAT does when the masks are rewritten. The lines stay where they
+ * are and a benchmark hits in any way; a miss fills the victim of the mask begin~end of the benchmark: the first
+ * empty way from the beginning of the mask for benchmark1 or from its end for benchmark2, or else the LRU way of the
+ * mask, by the time of the last access. A repeat of the line of the last access (last_way) skips the lookup.
+ */
+
+#ifndef WAY_SET_H
+#define WAY_SET_H
+
+#define MAX_SET_WAYS 32
+
+class Way_set
+{
+public:
+    int ways;
+    unsigned long long tag[MAX_SET_WAYS];
+    int owner[MAX_SET_WAYS];                  // 0: empty, 1: benchmark1, 2: benchmark2
+    unsigned long long stamp[MAX_SET_WAYS];   // the time of the last access, the smallest one is the LRU
+    int occupancy[3];                         // the empty ways, and those of benchmark1 and benchmark2
+    int last_way;                             // the way of the last access, i.e. the MRU line of the set
+
+    void Init(int w);
+    bool Access(int bench, unsigned long long t, unsigned long long now, int begin, int end);
+};
+
+void Way_set::Init(int w)
+{
+    ways = w;
+    for(int i = 0; i<ways; i++)
+    {
+        owner[i] = 0;
+        stamp[i] = 0;
+    }
+    occupancy[0] = ways;
+    occupancy[1] = occupancy[2] = 0;
+    last_way = 0;
+}
+
+// an access of benchmark bench (1 or 2) to tag t at the time now, filling a way of begin~end when missed; true when hit
+bool Way_set::Access(int bench, unsigned long long t, unsigned long long now, int begin, int end)
+{
+    if(owner[last_way] == bench && tag[last_way] == t)    // a hit on the MRU line
+    {
+        stamp[last_way] = now;
+        return true;
+    }
+    for(int w = 0; w<ways; w++)
+        if(owner[w] == bench && tag[w] == t)    // found, hits in any way
+        {
+            stamp[w] = now;
+            last_way = w;
+            return true;
+        }
+
+    int victim = -1;
+    if(bench == 1)    // fill the empty ways from the beginning of the mask
+    {
+        for(int w = begin; w<=end && victim < 0; w++)
+            if(owner[w] == 0)
+                victim = w;
+    }
+    else              // fill the empty ways from the end of the mask
+    {
+        for(int w = end; w>=begin && victim < 0; w--)
+            if(owner[w] == 0)
+                victim = w;
+    }
+    if(victim < 0)    // full, replace the LRU way of the mask
+    {
+        victim = begin;
+        for(int w = begin+1; w<=end; w++)
+            if(stamp[w] < stamp[victim])
+                victim = w;
+    }
+    occupancy[owner[victim]]--;
+    occupancy[bench]++;
+    owner[victim] = bench;
+    tag[victim] = t;
+    stamp[victim] = now;
+    last_way = victim;
+    return false;
+}
+
+#endif